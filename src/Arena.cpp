@@ -0,0 +1,84 @@
+/*
+ * Arena.cpp
+ *
+ * Copyright (C) 2020 Taishi Ueda <taishi.ueda@gmail.com>
+ *
+ * Distributed under terms of the MIT license.
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#include "Arena.hpp"
+#include <algorithm>
+
+namespace sf{
+
+    //##############################################################
+    // Arena
+    //---------------------------------------------------------
+    Arena::Arena(const size_t& chunk_size)
+	:chunk_size_(chunk_size){}
+
+    //---------------------------------------------------------
+    Arena::~Arena(){
+	for(auto i_chunk = chunks_.begin(); i_chunk != chunks_.end(); ++i_chunk){
+	    delete[] i_chunk->data;
+	}
+    }
+
+    //---------------------------------------------------------
+    void* Arena::allocate(const size_t& size, const size_t& align){
+	if(!chunks_.empty()){
+	    Chunk_t& chunk = chunks_.back();
+	    uintptr_t head = reinterpret_cast<uintptr_t>(chunk.data) + offset_;
+	    size_t pad = (align - (head & (align - 1u))) & (align - 1u);
+	    if(offset_ + pad + size <= chunk.size){
+		offset_ += pad + size;
+		used_ += size;
+		return chunk.data + offset_ - size;
+	    }
+	}
+
+	//new chunk. new[] is aligned enough for fundamental types.
+	size_t new_size = std::max(chunk_size_, size + align);
+	Chunk_t chunk{new uint8_t[new_size], new_size};
+	chunks_.push_back(chunk);
+	uintptr_t head = reinterpret_cast<uintptr_t>(chunk.data);
+	size_t pad = (align - (head & (align - 1u))) & (align - 1u);
+	offset_ = pad + size;
+	used_ += size;
+	return chunk.data + pad;
+    }
+
+    //---------------------------------------------------------
+    void Arena::release(){
+	if(chunks_.empty()){
+	    return;
+	}
+	auto i_largest = std::max_element(chunks_.begin(), chunks_.end(),
+		[](const Chunk_t& a, const Chunk_t& b){ return a.size < b.size;});
+	Chunk_t largest = *i_largest;
+	for(auto i_chunk = chunks_.begin(); i_chunk != chunks_.end(); ++i_chunk){
+	    if(i_chunk != i_largest){
+		delete[] i_chunk->data;
+	    }
+	}
+	chunks_.clear();
+	chunks_.push_back(largest);
+	offset_ = 0u;
+	used_ = 0u;
+    }
+
+    //---------------------------------------------------------
+    size_t Arena::used() const{
+	return used_;
+    }
+
+    //---------------------------------------------------------
+    size_t Arena::reserved() const{
+	size_t ret = 0u;
+	for(auto i_chunk = chunks_.begin(); i_chunk != chunks_.end(); ++i_chunk){
+	    ret += i_chunk->size;
+	}
+	return ret;
+    }
+}
@@ -0,0 +1,120 @@
+/*
+ * Arena.hpp
+ *
+ * Copyright (C) 2020 Taishi Ueda <taishi.ueda@gmail.com>
+ *
+ * Distributed under terms of the MIT license.
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#ifndef SF_ARENA_HPP
+#define SF_ARENA_HPP
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//! SqliteFetcher name space
+namespace sf{
+
+    //! Monotonic memory arena.
+    /*!
+     * Memory is taken from large chunks and is never freed one by one.
+     * All of the memory is released in one shot by release() or the destructor.
+     * An arena can be reused for several results, e.g. in a scope of a request;
+     *
+     * ```cpp
+     * Arena arena;
+     * for(...){
+     *     ArenaColumnList res(arena);
+     *     fetcher.fetchColumn("SELECT * FROM user", res, err_msg);
+     *     ...
+     *     arena.release(); // the largest chunk is kept for the next request.
+     * }
+     * ```
+     */
+    class Arena{
+	public:
+	    //! Constructor. No memory is taken until the first allocation.
+	    /*!
+	     * \param[in] chunk_size Minimum size of chunks in bytes.
+	     */
+	    explicit Arena(const size_t& chunk_size=64u*1024u);
+
+	    ~Arena();
+
+	    Arena(const Arena&) = delete;
+	    Arena& operator=(const Arena&) = delete;
+
+	    //! Allocate memory.
+	    /*!
+	     * \param[in] size size in bytes.
+	     * \param[in] align alignment in bytes. This must be a power of 2.
+	     * \retval pointer to the allocated memory.
+	     */
+	    void* allocate(const size_t& size, const size_t& align=alignof(std::max_align_t));
+
+	    //! Release all of the allocated memory.
+	    /*!
+	     * The largest chunk is kept to be reused by following allocations.
+	     */
+	    void release();
+
+	    //! Bytes given by allocate() since the last release.
+	    size_t used() const;
+
+	    //! Bytes of chunks held by this arena.
+	    size_t reserved() const;
+
+	private:
+	    struct Chunk_t{
+		uint8_t* data;
+		size_t size;
+	    };
+	    std::vector<Chunk_t> chunks_;
+	    size_t chunk_size_;
+	    size_t offset_{0u};
+	    size_t used_{0u};
+    };
+
+    //! STL allocator taking memory from an Arena.
+    /*!
+     * deallocate() does nothing. The memory is released with the arena.
+     * ```cpp
+     * std::vector<double, ArenaAllocator<double>> values(ArenaAllocator<double>(arena));
+     * ```
+     */
+    template<typename T>
+	class ArenaAllocator{
+	    public:
+		using value_type = T;
+
+		explicit ArenaAllocator(Arena& arena): arena_(&arena){}
+
+		template<typename U>
+		    ArenaAllocator(const ArenaAllocator<U>& other): arena_(other.arena()){}
+
+		T* allocate(const size_t n){
+		    return static_cast<T*>(arena_->allocate(n*sizeof(T), alignof(T)));
+		}
+
+		void deallocate(T*, const size_t){}
+
+		Arena* arena() const{
+		    return arena_;
+		}
+
+	    private:
+		Arena* arena_;
+	};
+
+    template<typename T, typename U>
+	inline bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b){
+	    return a.arena() == b.arena();
+	}
+
+    template<typename T, typename U>
+	inline bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b){
+	    return a.arena() != b.arena();
+	}
+}
+#endif
@@ -0,0 +1,71 @@
+/*
+ * Codec.cpp
+ *
+ * Copyright (C) 2020 Taishi Ueda <taishi.ueda@gmail.com>
+ *
+ * Distributed under terms of the MIT license.
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#include "Codec.hpp"
+#include <zlib.h>
+
+namespace sf{
+    namespace codec{
+
+	static const uint8_t MAGIC[4] = {0x00, 'S', 'F', 'Z'};
+	//deflate can't expand more than about 1032 times.
+	static const uint64_t MAX_RATIO = 1032u;
+
+	//-------------------------------------------------------------------
+	bool isCompressed(const uint8_t* bytes, const size_t& size){
+	    return size >= HEADER_BYTES && bytes[0] == MAGIC[0] && bytes[1] == MAGIC[1]
+		&& bytes[2] == MAGIC[2] && bytes[3] == MAGIC[3];
+	}
+
+	//-------------------------------------------------------------------
+	bool compress(const uint8_t* bytes, const size_t& size, Binary_t& out){
+	    if(size > UINT32_MAX){
+		return false;
+	    }
+	    uLongf n_bound = compressBound(static_cast<uLong>(size));
+	    out.resize(HEADER_BYTES + n_bound);
+	    for(size_t k=0u; k<4u; ++k){
+		out[k] = MAGIC[k];
+		out[4u + k] = static_cast<uint8_t>(size >> (8u*k));
+	    }
+	    int ret = compress2(out.data() + HEADER_BYTES, &n_bound,
+		    bytes, static_cast<uLong>(size), Z_DEFAULT_COMPRESSION);
+	    if(ret != Z_OK || HEADER_BYTES + n_bound >= size){
+		out.clear();
+		return false;
+	    }
+	    out.resize(HEADER_BYTES + n_bound);
+	    return true;
+	}
+
+	//-------------------------------------------------------------------
+	bool decompress(const uint8_t* bytes, const size_t& size, Binary_t& out){
+	    if(!isCompressed(bytes, size)){
+		return false;
+	    }
+	    uLongf n_raw = 0u;
+	    for(size_t k=0u; k<4u; ++k){
+		n_raw |= static_cast<uLongf>(bytes[4u + k]) << (8u*k);
+	    }
+	    //the header is not trusted to allocate
+	    if(static_cast<uint64_t>(n_raw) > static_cast<uint64_t>(size - HEADER_BYTES)*MAX_RATIO){
+		return false;
+	    }
+	    out.resize(n_raw);
+	    uLongf n_out = n_raw;
+	    int ret = uncompress(out.data(), &n_out, bytes + HEADER_BYTES,
+		    static_cast<uLong>(size - HEADER_BYTES));
+	    if(ret != Z_OK || n_out != n_raw){
+		out.clear();
+		return false;
+	    }
+	    return true;
+	}
+    }
+}
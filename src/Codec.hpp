@@ -0,0 +1,51 @@
+/*
+ * Codec.hpp
+ *
+ * Copyright (C) 2020 Taishi Ueda <taishi.ueda@gmail.com>
+ *
+ * Distributed under terms of the MIT license.
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#ifndef SF_CODEC_HPP
+#define SF_CODEC_HPP
+#include <cstddef>
+#include <cstdint>
+#include "SqliteFetcher.hpp"
+
+//! SqliteFetcher name space
+namespace sf{
+
+    //! Compression of values of COMPRESSED columns by zlib.
+    /*!
+     * A compressed value is a BLOB of a magic number "\0SFZ", the size of the raw value
+     * in 4 bytes of little endian and a zlib stream.
+     */
+    namespace codec{
+
+	//! Size of the header of a compressed value.
+	const size_t HEADER_BYTES = 8u;
+
+	//! true if bytes begin with the header of a compressed value.
+	bool isCompressed(const uint8_t* bytes, const size_t& size);
+
+	//! Compress bytes.
+	/*!
+	 * \param[in] bytes raw value.
+	 * \param[in] size size of the raw value.
+	 * \param[out] out compressed value with the header.
+	 * \retval true success
+	 * \retval false the value is too large or doesn't get smaller.
+	 */
+	bool compress(const uint8_t* bytes, const size_t& size, Binary_t& out);
+
+	//! Decompress bytes made by compress().
+	/*!
+	 * A raw size in the header larger than zlib can expand the bytes to is refused.
+	 * \retval true success
+	 * \retval false the bytes are not a valid compressed value.
+	 */
+	bool decompress(const uint8_t* bytes, const size_t& size, Binary_t& out);
+    }
+}
+#endif
@@ -0,0 +1,278 @@
+/*
+ * IngestPipeline.cpp
+ *
+ * Copyright (C) 2020 Taishi Ueda <taishi.ueda@gmail.com>
+ *
+ * Distributed under terms of the MIT license.
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#include "IngestPipeline.hpp"
+#include "LockFreeQueue.hpp"
+#include "Transaction.hpp"
+#include <chrono>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+namespace sf{
+
+    //##############################################################
+    // RowBatch
+    //---------------------------------------------------------
+    RowBatch::RowBatch(const std::vector<std::string>& names, const size_t& capacity)
+	: names_(names), capacity_(std::max<size_t>(1u, capacity)){
+	cells_.resize(capacity_ * names_.size());
+    }
+
+    //---------------------------------------------------------
+    size_t RowBatch::size() const{
+	return size_;
+    }
+
+    //---------------------------------------------------------
+    size_t RowBatch::capacity() const{
+	return capacity_;
+    }
+
+    //---------------------------------------------------------
+    bool RowBatch::full() const{
+	return size_ >= capacity_;
+    }
+
+    //---------------------------------------------------------
+    size_t RowBatch::columns() const{
+	return names_.size();
+    }
+
+    //---------------------------------------------------------
+    Data* RowBatch::addRow(){
+	size_t n_col = names_.size();
+	if((size_ + 1u) * n_col > cells_.size()){
+	    cells_.resize((size_ + 1u) * n_col);
+	}
+	Data* row = cells_.data() + size_ * n_col;
+	//cells may have values of a recycled batch
+	for(size_t k=0u; k<n_col; ++k){
+	    row[k] = Data();
+	}
+	++size_;
+	return row;
+    }
+
+    //---------------------------------------------------------
+    void RowBatch::addRow(const Column_t& col){
+	Data* row = addRow();
+	for(size_t k=0u; k<names_.size(); ++k){
+	    auto i_data = col.find(names_[k]);
+	    if(i_data != col.end()){
+		row[k] = i_data->second;
+	    }
+	}
+    }
+
+    //---------------------------------------------------------
+    void RowBatch::clear(){
+	size_ = 0u;
+    }
+
+    //##############################################################
+    // IngestPipeline
+    //---------------------------------------------------------
+    // Yield for a while, then sleep, while waiting for other threads.
+    static void backoff(size_t& n_spins){
+	if(n_spins < 64u){
+	    std::this_thread::yield();
+	}
+	else{
+	    std::this_thread::sleep_for(std::chrono::microseconds(50));
+	}
+	++n_spins;
+    }
+
+    //---------------------------------------------------------
+    static double secondsSince(const std::chrono::steady_clock::time_point& start){
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    //---------------------------------------------------------
+    IngestPipeline::IngestPipeline(Fetcher& fetcher, const std::string& table_name,
+	    const std::vector<std::string>& columns, const IngestOption_t& option)
+	: fetcher_(fetcher), table_name_(table_name), columns_(columns), option_(option){
+	if(option_.n_producers == 0u){
+	    unsigned n_cores = std::thread::hardware_concurrency();
+	    option_.n_producers = (n_cores > 2u) ? n_cores - 1u : 1u;
+	}
+	option_.batch_rows = std::max<size_t>(1u, option_.batch_rows);
+	option_.queue_batches = std::max<size_t>(1u, option_.queue_batches);
+    }
+
+    //---------------------------------------------------------
+    const IngestStats_t& IngestPipeline::stats() const{
+	return stats_;
+    }
+
+    //---------------------------------------------------------
+    size_t IngestPipeline::producers() const{
+	return option_.n_producers;
+    }
+
+    //---------------------------------------------------------
+    int32_t IngestPipeline::run(const IngestProducer_t& producer, std::string& err_msg){
+	err_msg.clear();
+	stats_ = IngestStats_t();
+	auto start = std::chrono::steady_clock::now();
+
+	using Batch_t = std::unique_ptr<RowBatch>;
+	LockFreeQueue<Batch_t> queue(option_.queue_batches);
+	//written batches are given back to producers to reuse their cells
+	LockFreeQueue<Batch_t> free_batches(queue.capacity() + option_.n_producers);
+	std::atomic<bool> is_aborted{false};
+	std::atomic<size_t> n_finished{0u};
+	std::atomic<uint64_t> producer_waits{0u};
+	std::mutex err_mtx;
+	std::string producer_err;
+
+	std::vector<std::thread> threads;
+	for(size_t p=0u; p<option_.n_producers; ++p){
+	    threads.emplace_back([&, p](){
+		    size_t n_spins = 0u;
+		    bool has_more = true;
+		    while(has_more && !is_aborted.load(std::memory_order_relaxed)){
+			Batch_t batch;
+			if(!free_batches.pop(batch)){
+			    batch.reset(new RowBatch(columns_, option_.batch_rows));
+			}
+			batch->clear();
+			try{
+			    has_more = producer(p, *batch);
+			}
+			catch(const std::exception& e){
+			    std::lock_guard<std::mutex> lock(err_mtx);
+			    producer_err = std::string("A producer failed: ") + e.what();
+			    is_aborted.store(true);
+			    break;
+			}
+			if(batch->size() == 0u){
+			    continue;
+			}
+			n_spins = 0u;
+			while(!queue.push(std::move(batch))){
+			    if(is_aborted.load(std::memory_order_relaxed)){
+				break;
+			    }
+			    producer_waits.fetch_add(1u, std::memory_order_relaxed);
+			    backoff(n_spins);
+			}
+		    }
+		    n_finished.fetch_add(1u, std::memory_order_release);
+		});
+	}
+
+	//the calling thread is the writer
+	bool own_transaction = !fetcher_.inTransaction();
+	std::unique_ptr<Transaction> tx;
+	size_t tx_rows = 0u;
+	double depth_sum = 0.0;
+	int32_t ret = SQLITE_OK;
+	//In a transaction of the caller, rows of this run are undone by a savepoint on failure.
+	std::unique_ptr<Savepoint> savepoint;
+	if(!own_transaction){
+	    savepoint.reset(new Savepoint(fetcher_, "sf_ingest"));
+	    if(!savepoint->isActive()){
+		err_msg = savepoint->errMsg();
+		ret = SQLITE_ERROR;
+		is_aborted.store(true);
+	    }
+	}
+	size_t n_spins = 0u;
+	while(!is_aborted.load(std::memory_order_relaxed)){
+	    //all rows are in the queue if producers have finished before pop
+	    bool is_done = n_finished.load(std::memory_order_acquire) == option_.n_producers;
+	    Batch_t batch;
+	    if(!queue.pop(batch)){
+		if(is_done){
+		    break;
+		}
+		++stats_.writer_waits;
+		backoff(n_spins);
+		continue;
+	    }
+	    n_spins = 0u;
+	    size_t depth = queue.size() + 1u;
+	    stats_.max_queue_depth = std::max(stats_.max_queue_depth, depth);
+	    depth_sum += static_cast<double>(depth);
+
+	    auto write_start = std::chrono::steady_clock::now();
+	    if(own_transaction && !tx){
+		tx.reset(new Transaction(fetcher_, TX_IMMEDIATE));
+		if(!tx->isActive()){
+		    err_msg = tx->errMsg();
+		    ret = SQLITE_ERROR;
+		    tx.reset();
+		    break;
+		}
+	    }
+	    ret = fetcher_.insertRows(table_name_, columns_, batch->cells_.data(), batch->size(), err_msg);
+	    if(ret != SQLITE_OK){
+		break;
+	    }
+	    stats_.rows += batch->size();
+	    ++stats_.batches;
+	    tx_rows += batch->size();
+	    if(tx && tx_rows >= option_.transaction_rows){
+		ret = tx->commit(err_msg);
+		tx.reset();
+		if(ret != SQLITE_OK){
+		    break;
+		}
+		++stats_.transactions;
+		tx_rows = 0u;
+	    }
+	    stats_.write_sec += secondsSince(write_start);
+	    free_batches.push(std::move(batch));
+	}
+	if(ret != SQLITE_OK){
+	    is_aborted.store(true);
+	}
+	for(auto i_th = threads.begin(); i_th != threads.end(); ++i_th){
+	    i_th->join();
+	}
+	if(ret == SQLITE_OK && !producer_err.empty()){
+	    err_msg = producer_err;
+	    ret = SQLITE_ABORT;
+	}
+
+	if(tx){
+	    auto write_start = std::chrono::steady_clock::now();
+	    std::string tx_err;
+	    if(ret == SQLITE_OK){
+		ret = tx->commit(err_msg);
+		if(ret == SQLITE_OK){
+		    ++stats_.transactions;
+		}
+	    }
+	    else{
+		tx->rollback(tx_err);
+	    }
+	    stats_.write_sec += secondsSince(write_start);
+	}
+	if(savepoint && savepoint->isActive()){
+	    std::string sp_err;
+	    if(ret == SQLITE_OK){
+		ret = savepoint->release(err_msg);
+	    }
+	    else{
+		savepoint->rollback(sp_err);
+	    }
+	}
+
+	stats_.producer_waits = producer_waits.load();
+	stats_.mean_queue_depth = (stats_.batches == 0u) ? 0.0
+	    : depth_sum / static_cast<double>(stats_.batches);
+	stats_.elapsed_sec = secondsSince(start);
+	stats_.rows_per_sec = (stats_.elapsed_sec > 0.0)
+	    ? static_cast<double>(stats_.rows) / stats_.elapsed_sec : 0.0;
+	return ret;
+    }
+}
@@ -0,0 +1,175 @@
+/*
+ * IngestPipeline.hpp
+ *
+ * Copyright (C) 2020 Taishi Ueda <taishi.ueda@gmail.com>
+ *
+ * Distributed under terms of the MIT license.
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#ifndef SF_INGEST_PIPELINE_HPP
+#define SF_INGEST_PIPELINE_HPP
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "SqliteFetcher.hpp"
+
+//! SqliteFetcher name space
+namespace sf{
+
+    //! Options of IngestPipeline.
+    struct IngestOption_t{
+	size_t n_producers{0u};//!< number of producer threads. 0 means the number of cores minus 1, at least 1.
+	size_t batch_rows{1024u};//!< maximum number of rows in a batch.
+	size_t queue_batches{64u};//!< capacity of the queue in batches. Producers wait while it is full.
+	size_t transaction_rows{100000u};//!< number of rows committed in a transaction.
+    };
+
+    //! Statistics of a run of IngestPipeline.
+    struct IngestStats_t{
+	uint64_t rows{0u};//!< rows written.
+	uint64_t batches{0u};//!< batches written.
+	uint64_t transactions{0u};//!< transactions committed.
+	uint64_t producer_waits{0u};//!< times producers found the queue full.
+	uint64_t writer_waits{0u};//!< times the writer found the queue empty.
+	size_t max_queue_depth{0u};//!< maximum number of batches in the queue seen by the writer.
+	double mean_queue_depth{0.0};//!< mean number of batches in the queue seen by the writer.
+	double elapsed_sec{0.0};//!< time of the run.
+	double write_sec{0.0};//!< time the writer spent in inserting and committing.
+	double rows_per_sec{0.0};//!< throughput of the run.
+    };
+
+    //! Rows made by a producer. Cells are kept in the order of columns of the pipeline.
+    class RowBatch{
+	public:
+	    //! Number of rows.
+	    size_t size() const;
+
+	    //! Maximum number of rows. See IngestOption_t::batch_rows.
+	    size_t capacity() const;
+
+	    //! true if the batch has capacity() rows.
+	    bool full() const;
+
+	    //! Number of columns.
+	    size_t columns() const;
+
+	    //! Add a row.
+	    /*!
+	     * \retval pointer to columns() cells of the row. They are NULL until they are set.
+	     */
+	    Data* addRow();
+
+	    //! Add a row from a column. Columns not in it are NULL.
+	    void addRow(const Column_t& col);
+
+	    //! Remove all rows. Memory of cells is kept for the next rows.
+	    void clear();
+
+	private:
+	    friend class IngestPipeline;
+	    RowBatch(const std::vector<std::string>& names, const size_t& capacity);
+	    const std::vector<std::string>& names_;
+	    size_t capacity_{0u};
+	    size_t size_{0u};
+	    std::vector<Data> cells_;
+    };
+
+    //! Function of a producer.
+    /*!
+     * It is called repeatedly on a producer thread with its index and an empty batch,
+     * and adds rows up to the capacity of the batch. It returns false when the producer has no more rows.
+     */
+    using IngestProducer_t = std::function<bool(const size_t& producer, RowBatch& batch)>;
+
+    //! Pipeline which converts records on many threads and writes them on one connection.
+    /*!
+     * Producer threads convert records into batches of cells and push them to a bounded LockFreeQueue.
+     * The calling thread is the only writer. It binds the cells to a prepared INSERT statement
+     * and commits every IngestOption_t::transaction_rows rows,
+     * so conversion runs in parallel while SQLite has one writer.
+     * Producers wait while the queue is full, so memory is bounded even if the disk is slow.
+     * ```cpp
+     * IngestPipeline pipeline(fetcher, "user", {"ID", "name", "age"});
+     * pipeline.run(lines, [](const std::string& line, Data* row){
+     *     std::vector<std::string> fields = split(line, ',');
+     *     row[0].set(static_cast<int64_t>(std::stoll(fields[0])));
+     *     row[1].set(fields[1]);
+     *     row[2].set(static_cast<int64_t>(std::stoll(fields[2])));
+     * }, err_msg);
+     * std::cout << pipeline.stats().rows_per_sec << std::endl;
+     * ```
+     */
+    class IngestPipeline{
+	public:
+	    //! Constructor.
+	    /*!
+	     * \param[in] fetcher connection to be written. It must not be used by other threads while running.
+	     * \param[in] table_name name of the table.
+	     * \param[in] columns names of columns to be inserted.
+	     * \param[in] option options.
+	     */
+	    IngestPipeline(Fetcher& fetcher, const std::string& table_name,
+		    const std::vector<std::string>& columns, const IngestOption_t& option=IngestOption_t());
+
+	    IngestPipeline(const IngestPipeline&) = delete;
+	    IngestPipeline& operator=(const IngestPipeline&) = delete;
+
+	    //! Run producers until all of them finish, and write their rows.
+	    /*!
+	     * If writing fails, producers are stopped and the open transaction is rolled back.
+	     * Transactions committed before stay in the database.
+	     * In a transaction of the caller, rows are written in a savepoint instead,
+	     * and only the rows of this run are rolled back on failure.
+	     * An exception thrown by a producer stops the run in the same way.
+	     * \param[in] producer function of producers.
+	     * \param[out] err_msg error message.
+	     * \retval SQLITE_OK success.
+	     * \retval others Some errors occured. See [here](https://www.sqlite.org/rescode.html)
+	     */
+	    int32_t run(const IngestProducer_t& producer, std::string& err_msg);
+
+	    //! Convert and write records of a vector.
+	    /*!
+	     * Producers take batches of records in turn, so rows are not inserted in the order of records.
+	     * \param[in] records records to be converted.
+	     * \param[in] convert function to convert a record into cells, like void(const T& record, Data* row).
+	     * \param[out] err_msg error message.
+	     */
+	    template<typename T, typename F>
+		int32_t run(const std::vector<T>& records, F convert, std::string& err_msg){
+		    std::atomic<size_t> next{0u};
+		    size_t n_batch = option_.batch_rows;
+		    return run([&](const size_t&, RowBatch& batch){
+			    size_t begin = next.fetch_add(n_batch);
+			    if(begin >= records.size()){
+				return false;
+			    }
+			    size_t end = std::min(records.size(), begin + n_batch);
+			    for(size_t k=begin; k<end; ++k){
+				convert(records[k], batch.addRow());
+			    }
+			    return true;
+			}, err_msg);
+		}
+
+	    //! Statistics of the last run.
+	    const IngestStats_t& stats() const;
+
+	    //! Number of producer threads.
+	    size_t producers() const;
+
+	private:
+	    Fetcher& fetcher_;
+	    std::string table_name_;
+	    std::vector<std::string> columns_;
+	    IngestOption_t option_;
+	    IngestStats_t stats_;
+    };
+}
+#endif
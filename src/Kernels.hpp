@@ -0,0 +1,304 @@
+/*
+ * Kernels.hpp
+ *
+ * Copyright (C) 2020 Taishi Ueda <taishi.ueda@gmail.com>
+ *
+ * Distributed under terms of the MIT license.
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#ifndef SF_KERNELS_HPP
+#define SF_KERNELS_HPP
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "SqliteFetcher.hpp"
+
+//! SqliteFetcher name space
+namespace sf{
+
+    //! Aggregation kernels over contiguous column buffers.
+    /*!
+     * Each kernel takes a buffer of values, a bitmap telling valid rows and the number of rows.
+     * Bit (k % 64) of word (k / 64) of the bitmap is 1 if row k is valid.
+     * A bitmap can be ColumnVector::validity() or a mask made by filter(),
+     * and nullptr means all rows are valid.
+     * Rows are processed in blocks of 64. Blocks without invalid rows run in branchless loops
+     * with several accumulators, so that compilers vectorize them.
+     * ```cpp
+     * const ColumnVector& age = res.column("age");
+     * kernel::Mask_t adult;
+     * kernel::filter(age.ints(), age.validity(), age.size(),
+     *     [](const int64_t& v){ return v >= 20; }, adult);
+     * const ColumnVector& height = res.column("height_cm");
+     * double mean_height = kernel::mean(height.reals(), adult.data(), height.size());
+     * ```
+     */
+    namespace kernel{
+
+	//! Bitmap of rows.
+	using Mask_t = std::vector<uint64_t>;
+
+	//! Bits of a block of rows. All bits are set if validity is nullptr.
+	inline uint64_t blockBits(const uint64_t* validity, const size_t& block){
+	    return (validity == nullptr) ? ~uint64_t(0) : validity[block];
+	}
+
+	//! Number of valid rows.
+	inline size_t count(const uint64_t* validity, const size_t& n){
+	    if(validity == nullptr){
+		return n;
+	    }
+	    size_t ret = 0u;
+	    for(size_t w=0u; w<n/64u; ++w){
+		ret += static_cast<size_t>(__builtin_popcountll(validity[w]));
+	    }
+	    if(n % 64u != 0u){
+		uint64_t tail = validity[n/64u] & ((uint64_t(1) << (n % 64u)) - 1u);
+		ret += static_cast<size_t>(__builtin_popcountll(tail));
+	    }
+	    return ret;
+	}
+
+	//! Sum of valid values.
+	template<typename T>
+	    inline T sum(const T* values, const uint64_t* validity, const size_t& n){
+		T acc[8] = {};
+		size_t n_block = n / 64u;
+		for(size_t w=0u; w<n_block; ++w){
+		    const T* v = values + 64u*w;
+		    uint64_t bits = blockBits(validity, w);
+		    if(bits == ~uint64_t(0)){
+			for(size_t j=0u; j<64u; j+=8u){
+			    for(size_t l=0u; l<8u; ++l){
+				acc[l] += v[j+l];
+			    }
+			}
+		    }
+		    else if(bits != 0u){
+			for(size_t j=0u; j<64u; ++j){
+			    acc[j & 7u] += (((bits >> j) & 1u) != 0u) ? v[j] : T(0);
+			}
+		    }
+		}
+		for(size_t k=64u*n_block; k<n; ++k){
+		    if(((blockBits(validity, n_block) >> (k & 63u)) & 1u) != 0u){
+			acc[0] += values[k];
+		    }
+		}
+		T ret = T(0);
+		for(size_t l=0u; l<8u; ++l){
+		    ret += acc[l];
+		}
+		return ret;
+	    }
+
+	//! Mean of valid values. 0 if there are no valid values.
+	template<typename T>
+	    inline double mean(const T* values, const uint64_t* validity, const size_t& n){
+		size_t n_valid = count(validity, n);
+		return (n_valid == 0u) ? 0.0
+		    : static_cast<double>(sum(values, validity, n)) / static_cast<double>(n_valid);
+	    }
+
+	//! Minimum and maximum of valid values.
+	/*!
+	 * \retval true success
+	 * \retval false there are no valid values.
+	 */
+	template<typename T>
+	    inline bool minMax(const T* values, const uint64_t* validity, const size_t& n,
+		    T& min_value, T& max_value){
+		bool found = false;
+		T lo = T(0);
+		T hi = T(0);
+		for(size_t w=0u; w*64u<n; ++w){
+		    const T* v = values + 64u*w;
+		    size_t n_row = std::min<size_t>(64u, n - 64u*w);
+		    uint64_t bits = blockBits(validity, w);
+		    if(n_row < 64u){
+			bits &= (uint64_t(1) << n_row) - 1u;
+		    }
+		    if(bits == 0u){
+			continue;
+		    }
+		    if(!found){
+			lo = hi = v[__builtin_ctzll(bits)];
+			found = true;
+		    }
+		    if(bits == ~uint64_t(0)){
+			T block_lo = v[0];
+			T block_hi = v[0];
+			for(size_t j=1u; j<64u; ++j){
+			    block_lo = std::min(block_lo, v[j]);
+			    block_hi = std::max(block_hi, v[j]);
+			}
+			lo = std::min(lo, block_lo);
+			hi = std::max(hi, block_hi);
+		    }
+		    else{
+			while(bits != 0u){
+			    const T& a = v[__builtin_ctzll(bits)];
+			    lo = std::min(lo, a);
+			    hi = std::max(hi, a);
+			    bits &= bits - 1u;
+			}
+		    }
+		}
+		if(found){
+		    min_value = lo;
+		    max_value = hi;
+		}
+		return found;
+	    }
+
+	//! Make a mask of valid rows satisfying a predicate.
+	/*!
+	 * \param[in] values buffer of values.
+	 * \param[in] validity bitmap of valid rows. nullptr means all rows are valid.
+	 * \param[in] n number of rows.
+	 * \param[in] pred predicate called with a value, e.g. [](const int64_t& v){ return v > 0; }
+	 * \param[out] mask bitmap of rows satisfying the predicate.
+	 */
+	template<typename T, typename F>
+	    inline void filter(const T* values, const uint64_t* validity, const size_t& n,
+		    F pred, Mask_t& mask){
+		mask.assign((n + 63u) / 64u, 0u);
+		for(size_t w=0u; w<mask.size(); ++w){
+		    const T* v = values + 64u*w;
+		    size_t n_row = std::min<size_t>(64u, n - 64u*w);
+		    uint64_t bits = 0u;
+		    for(size_t j=0u; j<n_row; ++j){
+			bits |= static_cast<uint64_t>(pred(v[j]) ? 1u : 0u) << j;
+		    }
+		    mask[w] = bits & blockBits(validity, w);
+		}
+	    }
+
+	//! Number of valid rows satisfying a predicate.
+	template<typename T, typename F>
+	    inline size_t countIf(const T* values, const uint64_t* validity, const size_t& n, F pred){
+		Mask_t mask;
+		filter(values, validity, n, pred, mask);
+		return count(mask.data(), n);
+	    }
+
+	//! Gather values of rows set in a mask.
+	/*!
+	 * \param[in] values buffer of values.
+	 * \param[in] mask bitmap of rows to be selected.
+	 * \param[in] n number of rows.
+	 * \param[out] out selected values in the order of rows.
+	 */
+	template<typename T>
+	    inline void maskedSelect(const T* values, const uint64_t* mask, const size_t& n,
+		    std::vector<T>& out){
+		out.clear();
+		out.reserve(count(mask, n));
+		for(size_t w=0u; w*64u<n; ++w){
+		    size_t n_row = std::min<size_t>(64u, n - 64u*w);
+		    uint64_t bits = blockBits(mask, w);
+		    if(n_row < 64u){
+			bits &= (uint64_t(1) << n_row) - 1u;
+		    }
+		    if(bits == ~uint64_t(0)){
+			out.insert(out.end(), values + 64u*w, values + 64u*w + 64u);
+			continue;
+		    }
+		    while(bits != 0u){
+			out.push_back(values[64u*w + __builtin_ctzll(bits)]);
+			bits &= bits - 1u;
+		    }
+		}
+	    }
+
+	//! Count valid values in bins of the same width.
+	/*!
+	 * Values out of [lo, hi] are not counted. hi is counted in the last bin.
+	 * \param[in] values buffer of values.
+	 * \param[in] validity bitmap of valid rows. nullptr means all rows are valid.
+	 * \param[in] n number of rows.
+	 * \param[in] lo lower bound of the first bin.
+	 * \param[in] hi upper bound of the last bin.
+	 * \param[in] n_bins number of bins.
+	 * \param[out] counts counts of the bins.
+	 */
+	template<typename T>
+	    inline void histogram(const T* values, const uint64_t* validity, const size_t& n,
+		    const double& lo, const double& hi, const size_t& n_bins,
+		    std::vector<int64_t>& counts){
+		counts.assign(n_bins, 0);
+		if(n_bins == 0u || !(hi > lo)){
+		    return;
+		}
+		double scale = static_cast<double>(n_bins) / (hi - lo);
+		int64_t last = static_cast<int64_t>(n_bins) - 1;
+		for(size_t w=0u; w*64u<n; ++w){
+		    const T* v = values + 64u*w;
+		    size_t n_row = std::min<size_t>(64u, n - 64u*w);
+		    uint64_t bits = blockBits(validity, w);
+		    for(size_t j=0u; j<n_row; ++j){
+			double x = static_cast<double>(v[j]);
+			if((((bits >> j) & 1u) != 0u) && x >= lo && x <= hi){
+			    ++counts[std::min(static_cast<int64_t>((x - lo) * scale), last)];
+			}
+		    }
+		}
+	    }
+
+	//! Sum of a column of INT64 or DOUBLE. 0 for other types.
+	inline double sum(const ColumnVector& col){
+	    if(col.ints() != nullptr){
+		return static_cast<double>(sum(col.ints(), col.validity(), col.size()));
+	    }
+	    if(col.reals() != nullptr){
+		return sum(col.reals(), col.validity(), col.size());
+	    }
+	    return 0.0;
+	}
+
+	//! Mean of a column of INT64 or DOUBLE. 0 for other types.
+	inline double mean(const ColumnVector& col){
+	    size_t n_valid = col.size() - col.nullCount();
+	    return (n_valid == 0u) ? 0.0 : sum(col) / static_cast<double>(n_valid);
+	}
+
+	//! Minimum and maximum of a column of INT64 or DOUBLE.
+	/*!
+	 * \retval true success
+	 * \retval false there are no valid values or the type is not numeric.
+	 */
+	inline bool minMax(const ColumnVector& col, double& min_value, double& max_value){
+	    if(col.ints() != nullptr){
+		int64_t lo = 0;
+		int64_t hi = 0;
+		if(!minMax(col.ints(), col.validity(), col.size(), lo, hi)){
+		    return false;
+		}
+		min_value = static_cast<double>(lo);
+		max_value = static_cast<double>(hi);
+		return true;
+	    }
+	    if(col.reals() != nullptr){
+		return minMax(col.reals(), col.validity(), col.size(), min_value, max_value);
+	    }
+	    return false;
+	}
+
+	//! Histogram of a column of INT64 or DOUBLE. See histogram() of buffers.
+	inline void histogram(const ColumnVector& col, const double& lo, const double& hi,
+		const size_t& n_bins, std::vector<int64_t>& counts){
+	    if(col.ints() != nullptr){
+		histogram(col.ints(), col.validity(), col.size(), lo, hi, n_bins, counts);
+	    }
+	    else if(col.reals() != nullptr){
+		histogram(col.reals(), col.validity(), col.size(), lo, hi, n_bins, counts);
+	    }
+	    else{
+		counts.assign(n_bins, 0);
+	    }
+	}
+    }
+}
+#endif
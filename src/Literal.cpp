@@ -0,0 +1,190 @@
+/*
+ * Literal.cpp
+ *
+ * Copyright (C) 2020 Taishi Ueda <taishi.ueda@gmail.com>
+ *
+ * Distributed under terms of the MIT license.
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#include "Literal.hpp"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace sf{
+    namespace literal{
+
+	//---------------------------------------------------------
+	// Table of hex values of characters, -1 for non hex digits.
+	struct HexTable_t{
+	    int8_t value[256];
+	    HexTable_t(){
+		for(size_t k=0u; k<256u; ++k){
+		    value[k] = -1;
+		}
+		for(int8_t k=0; k<10; ++k){
+		    value['0' + k] = k;
+		}
+		for(int8_t k=0; k<6; ++k){
+		    value['a' + k] = static_cast<int8_t>(10 + k);
+		    value['A' + k] = static_cast<int8_t>(10 + k);
+		}
+	    }
+	};
+
+	static const char HEX_DIGITS[] = "0123456789abcdef";
+
+	//---------------------------------------------------------
+	void appendUint(std::string& out, const uint64_t& value){
+	    char buff[20];
+	    char* tail = buff + sizeof(buff);
+	    char* head = tail;
+	    uint64_t rest = value;
+	    do{
+		*--head = static_cast<char>('0' + rest % 10u);
+		rest /= 10u;
+	    }while(rest != 0u);
+	    out.append(head, tail);
+	}
+
+	//---------------------------------------------------------
+	void appendInt(std::string& out, const int64_t& value){
+	    if(value < 0){
+		out.push_back('-');
+		// Negate in unsigned not to overflow at the minimum value.
+		appendUint(out, 0u - static_cast<uint64_t>(value));
+	    }
+	    else{
+		appendUint(out, static_cast<uint64_t>(value));
+	    }
+	}
+
+	//---------------------------------------------------------
+	// Append digits written by printf keeping the literal REAL.
+	static void appendReal(std::string& out, const char* buff, const int& len){
+	    out.append(buff, static_cast<size_t>(len));
+	    if(std::strpbrk(buff, ".en") == nullptr){
+		out += ".0";
+	    }
+	}
+
+	//---------------------------------------------------------
+	void appendDouble(std::string& out, const double& value){
+	    if(std::isnan(value)){
+		out += "NULL";
+		return;
+	    }
+	    if(std::isinf(value)){
+		out += (value < 0.0) ? "-9e999" : "9e999";
+		return;
+	    }
+	    char buff[32];
+	    int len = 0;
+	    for(int prec=15; prec<=17; ++prec){
+		len = std::snprintf(buff, sizeof(buff), "%.*g", prec, value);
+		if(prec == 17 || std::strtod(buff, nullptr) == value){
+		    break;
+		}
+	    }
+	    appendReal(out, buff, len);
+	}
+
+	//---------------------------------------------------------
+	void appendFloat(std::string& out, const float& value){
+	    if(std::isnan(value)){
+		out += "NULL";
+		return;
+	    }
+	    if(std::isinf(value)){
+		out += (value < 0.0f) ? "-9e999" : "9e999";
+		return;
+	    }
+	    char buff[32];
+	    int len = 0;
+	    for(int prec=6; prec<=9; ++prec){
+		len = std::snprintf(buff, sizeof(buff), "%.*g", prec, static_cast<double>(value));
+		if(prec == 9 || std::strtof(buff, nullptr) == value){
+		    break;
+		}
+	    }
+	    appendReal(out, buff, len);
+	}
+
+	//---------------------------------------------------------
+	void appendName(std::string& out, const std::string& name){
+	    out.reserve(out.size() + name.size() + 2u);
+	    out.push_back('"');
+	    for(auto i_c = name.begin(); i_c != name.end(); ++i_c){
+		out.push_back(*i_c);
+		if(*i_c == '"'){
+		    out.push_back('"');
+		}
+	    }
+	    out.push_back('"');
+	}
+
+	//---------------------------------------------------------
+	void appendText(std::string& out, const char* value, const size_t& size){
+	    out.reserve(out.size() + size + 2u);
+	    out.push_back('\'');
+	    const char* head = value;
+	    const char* tail = value + size;
+	    // memchr skips runs without quotes with wide loads.
+	    while(head < tail){
+		const char* quote = static_cast<const char*>(
+			std::memchr(head, '\'', static_cast<size_t>(tail - head)));
+		if(quote == nullptr){
+		    out.append(head, tail);
+		    break;
+		}
+		out.append(head, quote + 1);
+		out.push_back('\'');
+		head = quote + 1;
+	    }
+	    out.push_back('\'');
+	}
+
+	//---------------------------------------------------------
+	void appendBlob(std::string& out, const uint8_t* value, const size_t& size){
+	    size_t pos = out.size();
+	    out.resize(pos + 2u*size + 3u);
+	    char* dst = &out[pos];
+	    *dst++ = 'X';
+	    *dst++ = '\'';
+	    for(size_t k=0u; k<size; ++k){
+		*dst++ = HEX_DIGITS[value[k] >> 4];
+		*dst++ = HEX_DIGITS[value[k] & 0x0f];
+	    }
+	    *dst = '\'';
+	}
+
+	//---------------------------------------------------------
+	bool decodeHex(const std::string& hex, std::vector<uint8_t>& value){
+	    static const HexTable_t table;
+	    size_t head = 0u;
+	    size_t tail = hex.size();
+	    if(tail >= 3u && (hex[0] == 'X' || hex[0] == 'x')
+		    && hex[1] == '\'' && hex[tail-1u] == '\''){
+		head = 2u;
+		tail -= 1u;
+	    }
+	    value.clear();
+	    if((tail - head) % 2u != 0u){
+		return false;
+	    }
+	    value.resize((tail - head) / 2u);
+	    for(size_t k=0u; k<value.size(); ++k){
+		int8_t hi = table.value[static_cast<uint8_t>(hex[head + 2u*k])];
+		int8_t lo = table.value[static_cast<uint8_t>(hex[head + 2u*k + 1u])];
+		if(hi < 0 || lo < 0){
+		    value.clear();
+		    return false;
+		}
+		value[k] = static_cast<uint8_t>((hi << 4) | lo);
+	    }
+	    return true;
+	}
+    }
+}
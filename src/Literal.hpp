@@ -0,0 +1,62 @@
+/*
+ * Literal.hpp
+ *
+ * Copyright (C) 2020 Taishi Ueda <taishi.ueda@gmail.com>
+ *
+ * Distributed under terms of the MIT license.
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#ifndef SF_LITERAL_HPP
+#define SF_LITERAL_HPP
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//! SqliteFetcher name space
+namespace sf{
+
+    //! Encoders of SQL literals.
+    /*!
+     * Every function appends to a buffer given by the caller,
+     * so a buffer can be reused for many queries without reallocation.
+     */
+    namespace literal{
+
+	//! Append an integer.
+	void appendInt(std::string& out, const int64_t& value);
+
+	//! Append an unsigned integer.
+	void appendUint(std::string& out, const uint64_t& value);
+
+	//! Append a double with the shortest digits read back to the same value.
+	/*!
+	 * NaN is written as NULL and infinity as 9e999, which SQLite reads as infinity.
+	 * A decimal point is always written, so the literal is read as REAL.
+	 */
+	void appendDouble(std::string& out, const double& value);
+
+	//! Append a float with the shortest digits read back to the same value.
+	void appendFloat(std::string& out, const float& value);
+
+	//! Append a quoted TEXT literal. Single quotes are escaped.
+	void appendText(std::string& out, const char* value, const size_t& size);
+
+	//! Append a BLOB literal in X'...' style.
+	void appendBlob(std::string& out, const uint8_t* value, const size_t& size);
+
+	//! Append a quoted identifier like "name". Double quotes are escaped.
+	void appendName(std::string& out, const std::string& name);
+
+	//! Decode hex digits.
+	/*!
+	 * \param[in] hex hex digits. X'...' style is also accepted.
+	 * \param[out] value decoded bytes.
+	 * \retval true success
+	 * \retval false hex contains a non hex digit or odd number of digits.
+	 */
+	bool decodeHex(const std::string& hex, std::vector<uint8_t>& value);
+    }
+}
+#endif
@@ -0,0 +1,143 @@
+/*
+ * LockFreeQueue.hpp
+ *
+ * Copyright (C) 2020 Taishi Ueda <taishi.ueda@gmail.com>
+ *
+ * Distributed under terms of the MIT license.
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#ifndef SF_LOCK_FREE_QUEUE_HPP
+#define SF_LOCK_FREE_QUEUE_HPP
+#include <atomic>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+
+//! SqliteFetcher name space
+namespace sf{
+
+    //! Bounded lock-free queue for multiple producers and consumers.
+    /*!
+     * Each cell has a sequence number telling whether it is ready to be written or read,
+     * so producers and consumers only race on their own position counters.
+     * ```cpp
+     * LockFreeQueue<int> queue(1024u);
+     * queue.push(1);
+     * int value;
+     * if(queue.pop(value)){ ... }
+     * ```
+     */
+    template<typename T>
+	class LockFreeQueue{
+	    public:
+		//! Constructor.
+		/*!
+		 * \param[in] capacity maximum number of elements. This is rounded up to a power of 2.
+		 */
+		explicit LockFreeQueue(const size_t& capacity){
+		    size_t n = 2u;
+		    while(n < capacity){
+			n <<= 1u;
+		    }
+		    mask_ = n - 1u;
+		    cells_.reset(new Cell_t[n]);
+		    for(size_t k=0u; k<n; ++k){
+			cells_[k].sequence.store(k, std::memory_order_relaxed);
+		    }
+		}
+
+		LockFreeQueue(const LockFreeQueue&) = delete;
+		LockFreeQueue& operator=(const LockFreeQueue&) = delete;
+
+		//! Push an element.
+		/*!
+		 * \param[in] value element moved into the queue if it succeeds.
+		 * \retval true success
+		 * \retval false the queue is full.
+		 */
+		bool push(T&& value){
+		    Cell_t* cell = nullptr;
+		    size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+		    while(true){
+			cell = &cells_[pos & mask_];
+			size_t seq = cell->sequence.load(std::memory_order_acquire);
+			intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+			if(diff == 0){
+			    if(enqueue_pos_.compare_exchange_weak(pos, pos + 1u,
+					std::memory_order_relaxed)){
+				break;
+			    }
+			}
+			else if(diff < 0){
+			    return false;
+			}
+			else{
+			    pos = enqueue_pos_.load(std::memory_order_relaxed);
+			}
+		    }
+		    cell->data = std::move(value);
+		    cell->sequence.store(pos + 1u, std::memory_order_release);
+		    return true;
+		}
+
+		//! Pop an element.
+		/*!
+		 * \param[out] value element moved out of the queue.
+		 * \retval true success
+		 * \retval false the queue is empty.
+		 */
+		bool pop(T& value){
+		    Cell_t* cell = nullptr;
+		    size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+		    while(true){
+			cell = &cells_[pos & mask_];
+			size_t seq = cell->sequence.load(std::memory_order_acquire);
+			intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1u);
+			if(diff == 0){
+			    if(dequeue_pos_.compare_exchange_weak(pos, pos + 1u,
+					std::memory_order_relaxed)){
+				break;
+			    }
+			}
+			else if(diff < 0){
+			    return false;
+			}
+			else{
+			    pos = dequeue_pos_.load(std::memory_order_relaxed);
+			}
+		    }
+		    value = std::move(cell->data);
+		    cell->data = T();
+		    cell->sequence.store(pos + mask_ + 1u, std::memory_order_release);
+		    return true;
+		}
+
+		//! Number of elements. This is approximate while other threads push or pop.
+		size_t size() const{
+		    size_t in = enqueue_pos_.load(std::memory_order_relaxed);
+		    size_t out = dequeue_pos_.load(std::memory_order_relaxed);
+		    return (in > out) ? in - out : 0u;
+		}
+
+		//! Maximum number of elements.
+		size_t capacity() const{
+		    return mask_ + 1u;
+		}
+
+	    private:
+		struct Cell_t{
+		    std::atomic<size_t> sequence;
+		    T data;
+		};
+		std::unique_ptr<Cell_t[]> cells_;
+		size_t mask_{0u};
+		//positions are kept on separated cache lines.
+		char pad0_[64];
+		std::atomic<size_t> enqueue_pos_{0u};
+		char pad1_[64];
+		std::atomic<size_t> dequeue_pos_{0u};
+		char pad2_[64];
+	};
+}
+#endif
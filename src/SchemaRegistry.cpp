@@ -0,0 +1,70 @@
+/*
+ * SchemaRegistry.cpp
+ *
+ * Copyright (C) 2020 Taishi Ueda <taishi.ueda@gmail.com>
+ *
+ * Distributed under terms of the MIT license.
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#include "SchemaRegistry.hpp"
+
+namespace sf{
+
+    //##############################################################
+    // SchemaSlot
+    //-------------------------------------------------------------------
+    SchemaPtr_t SchemaSlot::load() const{
+	return std::atomic_load(&snapshot_);
+    }
+
+    //-------------------------------------------------------------------
+    SchemaPtr_t SchemaSlot::acquire(const int64_t& schema_version, const uint64_t& fingerprint,
+	    const std::function<TableInfo_t(std::string&)>& loader, std::string& err_msg){
+	err_msg.clear();
+	SchemaPtr_t snapshot = load();
+	if(snapshot && snapshot->schema_version == schema_version && snapshot->fingerprint == fingerprint){
+	    return snapshot;
+	}
+
+	//only one connection reads the schema, and the others wait for it
+	std::lock_guard<std::mutex> lock(build_mtx_);
+	snapshot = load();
+	if(snapshot && snapshot->schema_version == schema_version && snapshot->fingerprint == fingerprint){
+	    return snapshot;
+	}
+	std::shared_ptr<SchemaSnapshot_t> new_snapshot = std::make_shared<SchemaSnapshot_t>();
+	new_snapshot->schema_version = schema_version;
+	new_snapshot->fingerprint = fingerprint;
+	new_snapshot->tables = loader(err_msg);
+	if(!err_msg.empty()){
+	    return nullptr;
+	}
+	std::atomic_store(&snapshot_, SchemaPtr_t(new_snapshot));
+	return new_snapshot;
+    }
+
+    //##############################################################
+    // SchemaRegistry
+    //-------------------------------------------------------------------
+    SchemaRegistry& SchemaRegistry::instance(){
+	static SchemaRegistry registry;
+	return registry;
+    }
+
+    //-------------------------------------------------------------------
+    SchemaSlot* SchemaRegistry::slot(const std::string& path){
+	std::lock_guard<std::mutex> lock(mtx_);
+	std::unique_ptr<SchemaSlot>& a_slot = slots_[path];
+	if(!a_slot){
+	    a_slot.reset(new SchemaSlot());
+	}
+	return a_slot.get();
+    }
+
+    //-------------------------------------------------------------------
+    size_t SchemaRegistry::size(){
+	std::lock_guard<std::mutex> lock(mtx_);
+	return slots_.size();
+    }
+}
@@ -0,0 +1,85 @@
+/*
+ * SchemaRegistry.hpp
+ *
+ * Copyright (C) 2020 Taishi Ueda <taishi.ueda@gmail.com>
+ *
+ * Distributed under terms of the MIT license.
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#ifndef SF_SCHEMA_REGISTRY_HPP
+#define SF_SCHEMA_REGISTRY_HPP
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include "SqliteFetcher.hpp"
+
+//! SqliteFetcher name space
+namespace sf{
+
+    //! Schema of the main database of a file at a schema version. This is never changed once made.
+    struct SchemaSnapshot_t{
+	int64_t schema_version{-1};//!< "PRAGMA schema_version" the snapshot was made at.
+	uint64_t fingerprint{0u};//!< hash of SQL in sqlite_master. This tells a new file at the same path.
+	TableInfo_t tables;//!< tables of the main database.
+    };
+
+    //! Snapshot shared by connections.
+    using SchemaPtr_t = std::shared_ptr<const SchemaSnapshot_t>;
+
+    //! The latest snapshot of a database file.
+    /*!
+     * Readers take the snapshot by an atomic load without locks.
+     * A new snapshot is made by one connection and replaces the old one by an atomic store,
+     * and connections holding the old one keep it until they see the new schema version.
+     */
+    class SchemaSlot{
+	public:
+	    //! The latest snapshot. nullptr if no snapshot is made yet.
+	    SchemaPtr_t load() const;
+
+	    //! Get the snapshot of a schema. It is made by the loader if it is not stored.
+	    /*!
+	     * \param[in] schema_version schema version seen by the caller.
+	     * \param[in] fingerprint hash of SQL in sqlite_master seen by the caller.
+	     * \param[in] loader function to read tables of the main database.
+	     * \param[out] err_msg error message of the loader.
+	     * \retval snapshot, or nullptr if the loader failed.
+	     */
+	    SchemaPtr_t acquire(const int64_t& schema_version, const uint64_t& fingerprint,
+		    const std::function<TableInfo_t(std::string&)>& loader, std::string& err_msg);
+
+	private:
+	    SchemaPtr_t snapshot_;
+	    std::mutex build_mtx_;
+    };
+
+    //! Process-wide schema snapshots keyed by paths of database files.
+    /*!
+     * Fetchers opening the same file share one snapshot instead of scanning the schema each.
+     * In-memory and temporary databases are not shared.
+     */
+    class SchemaRegistry{
+	public:
+	    //! The registry of the process.
+	    static SchemaRegistry& instance();
+
+	    //! Slot of a database file. It is made at the first time and lives as long as the process.
+	    /*!
+	     * \param[in] path full path of the file, given by sqlite3_db_filename().
+	     */
+	    SchemaSlot* slot(const std::string& path);
+
+	    //! Number of files in the registry.
+	    size_t size();
+
+	private:
+	    SchemaRegistry() = default;
+	    std::mutex mtx_;
+	    std::map<std::string, std::unique_ptr<SchemaSlot>> slots_;
+    };
+}
+#endif
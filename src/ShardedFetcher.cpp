@@ -0,0 +1,219 @@
+/*
+ * ShardedFetcher.cpp
+ *
+ * Copyright (C) 2020 Taishi Ueda <taishi.ueda@gmail.com>
+ *
+ * Distributed under terms of the MIT license.
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#include "ShardedFetcher.hpp"
+#include <algorithm>
+
+namespace sf{
+
+    //---------------------------------------------------------
+    // Value of a numeric Data as long double.
+    static bool numericValue(const Data& data, long double& value){
+	switch(data.type()){
+	    case INT8:{ int8_t v = 0; data.get(v); value = v; return true;}
+	    case INT16:{ int16_t v = 0; data.get(v); value = v; return true;}
+	    case INT32:{ int32_t v = 0; data.get(v); value = v; return true;}
+	    case INT64:{ int64_t v = 0; data.get(v); value = v; return true;}
+	    case UINT64:{ uint64_t v = 0u; data.get(v); value = v; return true;}
+	    case FLOAT:{ float v = 0.0f; data.get(v); value = v; return true;}
+	    case DOUBLE:{ double v = 0.0; data.get(v); value = v; return true;}
+	    case BOOL:{ bool v = false; data.get(v); value = v; return true;}
+	    default:
+		return false;
+	}
+    }
+
+    //---------------------------------------------------------
+    // Compare values in the order of SQLite; NULL, numbers, TEXT and BLOB.
+    static int32_t compareData(const Data& a, const Data& b){
+	long double a_num = 0.0, b_num = 0.0;
+	bool a_is_num = numericValue(a, a_num);
+	bool b_is_num = numericValue(b, b_num);
+	if(a_is_num && b_is_num){
+	    return (a_num < b_num) ? -1 : ((b_num < a_num) ? 1 : 0);
+	}
+	auto rank = [](const Data& d, const bool& is_num){
+	    return (d.type() == NONE) ? 0 : (is_num ? 1 : ((d.type() == TEXT) ? 2 : 3));
+	};
+	int32_t a_rank = rank(a, a_is_num);
+	int32_t b_rank = rank(b, b_is_num);
+	if(a_rank != b_rank){
+	    return (a_rank < b_rank) ? -1 : 1;
+	}
+	if(a.type() == TEXT){
+	    std::string a_str, b_str;
+	    a.get(a_str);
+	    b.get(b_str);
+	    return a_str.compare(b_str);
+	}
+	if(a.type() == BLOB){
+	    Binary_t a_bin, b_bin;
+	    a.get(a_bin);
+	    b.get(b_bin);
+	    return (a_bin < b_bin) ? -1 : ((b_bin < a_bin) ? 1 : 0);
+	}
+	return 0;
+    }
+
+    //---------------------------------------------------------
+    // Add LIMIT to a query. The query is wrapped, since it may have LIMIT or a compound SELECT.
+    static std::string pushLimit(const std::string& query, const int64_t& limit){
+	if(limit < 0){
+	    return query;
+	}
+	size_t i_last = query.find_last_not_of(" \t\n;");
+	std::string ret = (i_last == std::string::npos) ? "" : query.substr(0u, i_last + 1u);
+	return "SELECT * FROM (" + ret + ") LIMIT " + std::to_string(limit);
+    }
+
+    //##############################################################
+    // ShardedFetcher
+    //---------------------------------------------------------
+    ShardedFetcher::ShardedFetcher(){}
+
+    //---------------------------------------------------------
+    ShardedFetcher::ShardedFetcher(const std::vector<std::string>& db_names,
+	    const size_t& n_threads){
+	std::string err_msg;
+	open(db_names, err_msg, n_threads);
+    }
+
+    //---------------------------------------------------------
+    int32_t ShardedFetcher::open(const std::vector<std::string>& db_names,
+	    std::string& err_msg, const size_t& n_threads){
+	err_msg.clear();
+	int32_t ret = SQLITE_OK;
+	shards_.clear();
+	for(auto i_name = db_names.begin(); i_name != db_names.end(); ++i_name){
+	    std::unique_ptr<Fetcher> a_shard(new Fetcher());
+	    std::string a_err;
+	    int32_t retval = a_shard->open(*i_name, a_err);
+	    if(retval != SQLITE_OK){
+		ret = retval;
+		err_msg += (err_msg.empty() ? "" : "; ") + *i_name + ": " + a_err;
+	    }
+	    shards_.push_back(std::move(a_shard));
+	}
+
+	size_t n = n_threads;
+	if(n == 0u){
+	    n = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()),
+		    std::max<size_t>(1u, shards_.size()));
+	}
+	pool_.reset(new ThreadPool(n));
+	return ret;
+    }
+
+    //---------------------------------------------------------
+    size_t ShardedFetcher::size() const{
+	return shards_.size();
+    }
+
+    //---------------------------------------------------------
+    Fetcher& ShardedFetcher::shard(const size_t& k){
+	return *shards_.at(k);
+    }
+
+    //---------------------------------------------------------
+    ExecResult_t ShardedFetcher::exec(const std::string& query, std::string& err_msg){
+	err_msg.clear();
+	std::vector<ExecResult_t> results(shards_.size());
+	std::vector<std::string> errors(shards_.size());
+	std::vector<std::future<void>> futures;
+	for(size_t k=0u; k<shards_.size(); ++k){
+	    futures.push_back(pool_->submit([this, k, &query, &results, &errors](){
+			shards_[k]->exec(query, results[k], errors[k]);
+			}));
+	}
+
+	ExecResult_t ret;
+	ret.in_sql = query;
+	for(size_t k=0u; k<shards_.size(); ++k){
+	    futures[k].get();
+	    if(!errors[k].empty()){
+		err_msg += (err_msg.empty() ? "shard " : "; shard ")
+		    + std::to_string(k) + ": " + errors[k];
+	    }
+	    std::move(results[k].result.begin(), results[k].result.end(),
+		    std::back_inserter(ret.result));
+	}
+	return ret;
+    }
+
+    //---------------------------------------------------------
+    ColumnList_t ShardedFetcher::fetchColumn(const std::string& query, std::string& err_msg,
+	    const MergeOption_t& option){
+	err_msg.clear();
+	std::string shard_query = pushLimit(query, option.limit);
+	std::vector<ColumnList_t> results(shards_.size());
+	std::vector<std::string> errors(shards_.size());
+	std::vector<std::future<void>> futures;
+	for(size_t k=0u; k<shards_.size(); ++k){
+	    futures.push_back(pool_->submit([this, k, &shard_query, &results, &errors](){
+			shards_[k]->fetchColumn(shard_query, results[k], errors[k]);
+			}));
+	}
+	size_t n_rows = 0u;
+	for(size_t k=0u; k<shards_.size(); ++k){
+	    futures[k].get();
+	    if(!errors[k].empty()){
+		err_msg += (err_msg.empty() ? "shard " : "; shard ")
+		    + std::to_string(k) + ": " + errors[k];
+	    }
+	    n_rows += results[k].size();
+	}
+	if(option.limit >= 0){
+	    n_rows = std::min<size_t>(n_rows, static_cast<size_t>(option.limit));
+	}
+
+	ColumnList_t ret;
+	ret.reserve(n_rows);
+	if(option.order_by.empty()){
+	    for(size_t k=0u; k<results.size() && ret.size() < n_rows; ++k){
+		size_t n = std::min(results[k].size(), n_rows - ret.size());
+		std::move(results[k].begin(), results[k].begin() + n, std::back_inserter(ret));
+	    }
+	    return ret;
+	}
+
+	//k-way merge of sorted results
+	std::vector<size_t> heads(results.size(), 0u);
+	const std::string& key = option.order_by;
+	while(ret.size() < n_rows){
+	    size_t i_best = results.size();
+	    for(size_t k=0u; k<results.size(); ++k){
+		if(heads[k] >= results[k].size()){
+		    continue;
+		}
+		if(i_best == results.size()){
+		    i_best = k;
+		    continue;
+		}
+		const Column_t& cand = results[k][heads[k]];
+		const Column_t& best = results[i_best][heads[i_best]];
+		auto i_cand = cand.find(key);
+		auto i_best_key = best.find(key);
+		if(i_cand == cand.end() || i_best_key == best.end()){
+		    err_msg = "Coudn't find " + key + " in results";
+		    return ret;
+		}
+		int32_t cmp = compareData(i_cand->second, i_best_key->second);
+		if(option.descending ? (cmp > 0) : (cmp < 0)){
+		    i_best = k;
+		}
+	    }
+	    if(i_best == results.size()){
+		break;
+	    }
+	    ret.push_back(std::move(results[i_best][heads[i_best]]));
+	    ++heads[i_best];
+	}
+	return ret;
+    }
+}
@@ -0,0 +1,99 @@
+/*
+ * ShardedFetcher.hpp
+ *
+ * Copyright (C) 2020 Taishi Ueda <taishi.ueda@gmail.com>
+ *
+ * Distributed under terms of the MIT license.
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#ifndef SF_SHARDED_FETCHER_HPP
+#define SF_SHARDED_FETCHER_HPP
+#include "SqliteFetcher.hpp"
+#include "ThreadPool.hpp"
+#include <memory>
+
+//! SqliteFetcher name space
+namespace sf{
+
+    //! Options to merge results from shards.
+    struct MergeOption_t{
+	//! Column name to merge results in order.
+	/*! 
+	 * If this is empty, results are concatenated in the order of shards.
+	 * Otherwise the query must sort rows by this column in the same direction,
+	 * and sorted results are merged into one sorted result.
+	 */
+	std::string order_by;
+	bool descending{false};//!< true if rows are sorted in descending order.
+	//! Maximum number of rows. This is added to the query of each shard as LIMIT. Negative means no limit.
+	int64_t limit{-1};
+    };
+
+    //! Fetcher for sharded databases.
+    /*!
+     * ShardedFetcher holds a Fetcher per shard file whose schema is identical to the others.
+     * A query is run on all shards in parallel and results are merged.
+     *
+     * ```cpp
+     * ShardedFetcher shards({"user_0.db", "user_1.db", "user_2.db"});
+     * MergeOption_t opt;
+     * opt.order_by = "height_cm";
+     * opt.descending = true;
+     * opt.limit = 10;
+     * ColumnList_t tallest = shards.fetchColumn(
+     *     "SELECT name, height_cm FROM user ORDER BY height_cm DESC", err_msg, opt);
+     * ```
+     */
+    class ShardedFetcher{
+	public:
+	    ShardedFetcher();
+
+	    //! Constructor. Open databases.
+	    /*!
+	     * \param[in] db_names names of shard databases.
+	     * \param[in] n_threads number of threads. If it is 0, the smaller of the number of cores and that of shards is used.
+	     */
+	    ShardedFetcher(const std::vector<std::string>& db_names, const size_t& n_threads=0u);
+
+	    //! Open databases.
+	    /*!
+	     * \param[in] db_names names of shard databases.
+	     * \param[out] err_msg error message.
+	     * \param[in] n_threads number of threads. If it is 0, the smaller of the number of cores and that of shards is used.
+	     * \retval SQLITE_OK Successfully open all databases.
+	     * \retval others Some errors occured. See [here](https://www.sqlite.org/rescode.html)
+	     */
+	    int32_t open(const std::vector<std::string>& db_names, std::string& err_msg,
+		    const size_t& n_threads=0u);
+
+	    //! Number of shards.
+	    size_t size() const;
+
+	    //! Fetcher of a shard.
+	    Fetcher& shard(const size_t& k);
+
+	    //! Execute SQLite query on all shards.
+	    /*!
+	     * \param[in] query SQLite query to be executed
+	     * \param[out] err_msg error message. Messages from shards are joined.
+	     * \retval result results of all shards concatenated in the order of shards.
+	     */
+	    ExecResult_t exec(const std::string& query, std::string& err_msg);
+
+	    //! Fetch column list from all shards.
+	    /*!
+	     * \param[in] query SQL query to select values.
+	     * \param[out] err_msg Error message. Messages from shards are joined.
+	     * \param[in] option How to merge results.
+	     * \retval list of columns selected from all shards.
+	     */
+	    ColumnList_t fetchColumn(const std::string& query, std::string& err_msg,
+		    const MergeOption_t& option=MergeOption_t());
+
+	private:
+	    std::vector<std::unique_ptr<Fetcher>> shards_;
+	    std::unique_ptr<ThreadPool> pool_;
+    };
+}
+#endif
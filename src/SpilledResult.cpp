@@ -0,0 +1,329 @@
+/*
+ * SpilledResult.cpp
+ *
+ * Copyright (C) 2020 Taishi Ueda <taishi.ueda@gmail.com>
+ *
+ * Distributed under terms of the MIT license.
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#include "SpilledResult.hpp"
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace sf{
+
+    //-------------------------------------------------------------------
+    // A row is a sequence of cells in the order of names.
+    // A cell is a byte of Type_t, the size of the value in LEB128 and bytes of the value.
+    // Offsets of every ROW_STRIDE-th row are kept for random access.
+    static const size_t ROW_STRIDE = 64u;
+    static const size_t BUFFER_BYTES = 1u << 20;
+
+    //-------------------------------------------------------------------
+    static void putSize(std::string& buff, size_t size){
+	while(size >= 0x80u){
+	    buff.push_back(static_cast<char>((size & 0x7Fu) | 0x80u));
+	    size >>= 7;
+	}
+	buff.push_back(static_cast<char>(size));
+    }
+
+    //-------------------------------------------------------------------
+    static size_t getSize(const uint8_t* map, size_t& offset){
+	size_t ret = 0u;
+	for(uint32_t shift=0u; ; shift+=7u){
+	    uint8_t b = map[offset++];
+	    ret |= static_cast<size_t>(b & 0x7Fu) << shift;
+	    if((b & 0x80u) == 0u){
+		return ret;
+	    }
+	}
+    }
+
+    //-------------------------------------------------------------------
+    SpilledResult::SpilledResult(const std::string& temp_dir) : temp_dir_(temp_dir){
+	if(temp_dir_.empty()){
+	    const char* env = std::getenv("TMPDIR");
+	    temp_dir_ = (env != nullptr && env[0] != '\0') ? env : "/tmp";
+	}
+    }
+
+    //-------------------------------------------------------------------
+    SpilledResult::~SpilledResult(){
+	clear();
+    }
+
+    //-------------------------------------------------------------------
+    size_t SpilledResult::size() const{
+	return size_;
+    }
+
+    //-------------------------------------------------------------------
+    bool SpilledResult::isSpilled() const{
+	return fd_ >= 0;
+    }
+
+    //-------------------------------------------------------------------
+    size_t SpilledResult::fileBytes() const{
+	return file_bytes_;
+    }
+
+    //-------------------------------------------------------------------
+    const std::vector<std::string>& SpilledResult::names() const{
+	return names_;
+    }
+
+    //-------------------------------------------------------------------
+    Column_t SpilledResult::row(const size_t& k) const{
+	if(k >= size_){
+	    throw std::out_of_range("SpilledResult::row: " + std::to_string(k));
+	}
+	if(!isSpilled()){
+	    return rows_[k];
+	}
+	size_t offset = checkpoints_[k / ROW_STRIDE];
+	for(size_t j=0u; j<k % ROW_STRIDE; ++j){
+	    offset = skipRow(offset);
+	}
+	Column_t ret;
+	decodeRow(offset, ret);
+	return ret;
+    }
+
+    //-------------------------------------------------------------------
+    SpilledResult::const_iterator SpilledResult::begin() const{
+	return const_iterator(this, 0u);
+    }
+
+    //-------------------------------------------------------------------
+    SpilledResult::const_iterator SpilledResult::end() const{
+	return const_iterator(this, size_);
+    }
+
+    //-------------------------------------------------------------------
+    void SpilledResult::clear(){
+	if(map_ != nullptr){
+	    munmap(const_cast<uint8_t*>(map_), file_bytes_);
+	    map_ = nullptr;
+	}
+	if(fd_ >= 0){
+	    ::close(fd_);
+	    fd_ = -1;
+	}
+	names_.clear();
+	rows_.clear();
+	buffer_.clear();
+	buffer_.shrink_to_fit();
+	checkpoints_.clear();
+	n_written_ = 0u;
+	budget_ = 0u;
+	bytes_ = 0u;
+	size_ = 0u;
+	file_bytes_ = 0u;
+    }
+
+    //-------------------------------------------------------------------
+    int32_t SpilledResult::start(const std::vector<std::string>& names, const size_t& budget,
+	    std::string& err_msg){
+	err_msg.clear();
+	clear();
+	names_ = names;
+	budget_ = budget;
+	return SQLITE_OK;
+    }
+
+    //-------------------------------------------------------------------
+    // The row is moved while rows are in memory, and reused by the caller after that.
+    int32_t SpilledResult::append(Column_t& a_row, const size_t& bytes, std::string& err_msg){
+	if(!isSpilled()){
+	    bytes_ += bytes;
+	    rows_.push_back(std::move(a_row));
+	    a_row.clear();
+	    ++size_;
+	    if(budget_ == 0u || bytes_ <= budget_){
+		return SQLITE_OK;
+	    }
+	    return spill(err_msg);
+	}
+	int32_t ret = write(a_row, err_msg);
+	if(ret == SQLITE_OK){
+	    ++size_;
+	}
+	return ret;
+    }
+
+    //-------------------------------------------------------------------
+    int32_t SpilledResult::finish(std::string& err_msg){
+	if(!isSpilled()){
+	    return SQLITE_OK;
+	}
+	int32_t ret = flushBuffer(err_msg);
+	buffer_.clear();
+	buffer_.shrink_to_fit();
+	if(ret != SQLITE_OK || file_bytes_ == 0u){
+	    return ret;
+	}
+	void* map = mmap(nullptr, file_bytes_, PROT_READ, MAP_SHARED, fd_, 0);
+	if(map == MAP_FAILED){
+	    err_msg = std::string("Failed to map a temporary file: ") + std::strerror(errno);
+	    return SQLITE_IOERR;
+	}
+	madvise(map, file_bytes_, MADV_SEQUENTIAL);
+	map_ = static_cast<const uint8_t*>(map);
+	return SQLITE_OK;
+    }
+
+    //-------------------------------------------------------------------
+    // Move rows in memory to a new temporary file.
+    int32_t SpilledResult::spill(std::string& err_msg){
+	std::string path = temp_dir_ + "/sqlite_fetcher_XXXXXX";
+	std::vector<char> templ(path.begin(), path.end());
+	templ.push_back('\0');
+	fd_ = mkstemp(templ.data());
+	if(fd_ < 0){
+	    err_msg = "Failed to create a temporary file in " + temp_dir_ + ": " + std::strerror(errno);
+	    return SQLITE_CANTOPEN;
+	}
+	//the file is removed when it is closed
+	unlink(templ.data());
+	buffer_.reserve(BUFFER_BYTES + 4096u);
+	for(auto i_row = rows_.begin(); i_row != rows_.end(); ++i_row){
+	    int32_t ret = write(*i_row, err_msg);
+	    if(ret != SQLITE_OK){
+		return ret;
+	    }
+	}
+	rows_.clear();
+	rows_.shrink_to_fit();
+	bytes_ = 0u;
+	return SQLITE_OK;
+    }
+
+    //-------------------------------------------------------------------
+    int32_t SpilledResult::write(const Column_t& a_row, std::string& err_msg){
+	if(n_written_ % ROW_STRIDE == 0u){
+	    checkpoints_.push_back(file_bytes_ + buffer_.size());
+	}
+	for(auto i_name = names_.begin(); i_name != names_.end(); ++i_name){
+	    auto i_data = a_row.find(*i_name);
+	    if(i_data == a_row.end()){
+		buffer_.push_back(static_cast<char>(NONE));
+		putSize(buffer_, 0u);
+		continue;
+	    }
+	    const Data& value = i_data->second;
+	    buffer_.push_back(static_cast<char>(value.type()));
+	    putSize(buffer_, value.size());
+	    if(value.size() > 0u){
+		buffer_.append(reinterpret_cast<const char*>(value.bytes()), value.size());
+	    }
+	}
+	++n_written_;
+	return (buffer_.size() >= BUFFER_BYTES) ? flushBuffer(err_msg) : SQLITE_OK;
+    }
+
+    //-------------------------------------------------------------------
+    int32_t SpilledResult::flushBuffer(std::string& err_msg){
+	size_t pos = 0u;
+	while(pos < buffer_.size()){
+	    ssize_t n = ::write(fd_, buffer_.data() + pos, buffer_.size() - pos);
+	    if(n < 0){
+		if(errno == EINTR){
+		    continue;
+		}
+		err_msg = std::string("Failed to write a temporary file: ") + std::strerror(errno);
+		return SQLITE_IOERR;
+	    }
+	    pos += static_cast<size_t>(n);
+	}
+	file_bytes_ += buffer_.size();
+	buffer_.clear();
+	return SQLITE_OK;
+    }
+
+    //-------------------------------------------------------------------
+    size_t SpilledResult::skipRow(size_t offset) const{
+	for(size_t k=0u; k<names_.size(); ++k){
+	    ++offset;
+	    size_t n_bytes = getSize(map_, offset);
+	    offset += n_bytes;
+	}
+	return offset;
+    }
+
+    //-------------------------------------------------------------------
+    size_t SpilledResult::decodeRow(size_t offset, Column_t& a_row) const{
+	for(size_t k=0u; k<names_.size(); ++k){
+	    Type_t type = static_cast<Type_t>(map_[offset++]);
+	    size_t n_bytes = getSize(map_, offset);
+	    Data& value = a_row[names_[k]];
+	    value = Data(type);
+	    if(n_bytes > 0u){
+		value.set(const_cast<uint8_t*>(map_ + offset), type, static_cast<uint32_t>(n_bytes));
+	    }
+	    offset += n_bytes;
+	}
+	return offset;
+    }
+
+    //-------------------------------------------------------------------
+    SpilledResult::const_iterator::const_iterator(const SpilledResult* res, const size_t& pos)
+	: res_(res), pos_(pos){
+	if(res_->isSpilled() && pos_ < res_->size_){
+	    offset_ = res_->checkpoints_[pos_ / ROW_STRIDE];
+	    for(size_t j=0u; j<pos_ % ROW_STRIDE; ++j){
+		offset_ = res_->skipRow(offset_);
+	    }
+	}
+    }
+
+    //-------------------------------------------------------------------
+    SpilledResult::const_iterator::reference SpilledResult::const_iterator::operator*() const{
+	if(!res_->isSpilled()){
+	    return res_->rows_[pos_];
+	}
+	if(!is_loaded_){
+	    next_offset_ = res_->decodeRow(offset_, row_);
+	    is_loaded_ = true;
+	}
+	return row_;
+    }
+
+    //-------------------------------------------------------------------
+    SpilledResult::const_iterator::pointer SpilledResult::const_iterator::operator->() const{
+	return &(**this);
+    }
+
+    //-------------------------------------------------------------------
+    SpilledResult::const_iterator& SpilledResult::const_iterator::operator++(){
+	if(res_->isSpilled()){
+	    offset_ = is_loaded_ ? next_offset_ : res_->skipRow(offset_);
+	    is_loaded_ = false;
+	}
+	++pos_;
+	return *this;
+    }
+
+    //-------------------------------------------------------------------
+    SpilledResult::const_iterator SpilledResult::const_iterator::operator++(int){
+	const_iterator ret = *this;
+	++(*this);
+	return ret;
+    }
+
+    //-------------------------------------------------------------------
+    bool SpilledResult::const_iterator::operator==(const const_iterator& other) const{
+	return res_ == other.res_ && pos_ == other.pos_;
+    }
+
+    //-------------------------------------------------------------------
+    bool SpilledResult::const_iterator::operator!=(const const_iterator& other) const{
+	return !(*this == other);
+    }
+}
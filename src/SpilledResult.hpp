@@ -0,0 +1,127 @@
+/*
+ * SpilledResult.hpp
+ *
+ * Copyright (C) 2020 Taishi Ueda <taishi.ueda@gmail.com>
+ *
+ * Distributed under terms of the MIT license.
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#ifndef SF_SPILLED_RESULT_HPP
+#define SF_SPILLED_RESULT_HPP
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <string>
+#include <vector>
+#include "SqliteFetcher.hpp"
+
+//! SqliteFetcher name space
+namespace sf{
+
+    //! Result of a query which moves to a temporary file when it grows beyond a memory budget.
+    /*!
+     * Rows are held as ColumnList_t until their estimated memory exceeds the budget.
+     * After that, all rows are written to an unlinked temporary file in a compact binary format,
+     * which is mapped into memory by mmap when the fetch ends.
+     * Rows are read in the same way in both cases.
+     * ```cpp
+     * SpilledResult res;
+     * fetcher.fetchColumn("SELECT * FROM log", res, err_msg, 256u << 20);
+     * for(const Column_t& a_row : res){
+     *     ...
+     * }
+     * Column_t last = res.row(res.size() - 1u);
+     * ```
+     */
+    class SpilledResult{
+	public:
+	    //! Iterator over rows. A spilled row is decoded when it is visited.
+	    class const_iterator{
+		public:
+		    using iterator_category = std::forward_iterator_tag;
+		    using value_type = Column_t;
+		    using difference_type = std::ptrdiff_t;
+		    using pointer = const Column_t*;
+		    using reference = const Column_t&;
+
+		    const_iterator() = default;
+		    reference operator*() const;
+		    pointer operator->() const;
+		    const_iterator& operator++();
+		    const_iterator operator++(int);
+		    bool operator==(const const_iterator& other) const;
+		    bool operator!=(const const_iterator& other) const;
+
+		private:
+		    friend class SpilledResult;
+		    const_iterator(const SpilledResult* res, const size_t& pos);
+		    const SpilledResult* res_{nullptr};
+		    size_t pos_{0u};
+		    size_t offset_{0u};
+		    mutable size_t next_offset_{0u};
+		    mutable Column_t row_;
+		    mutable bool is_loaded_{false};
+	    };
+
+	    //! Constructor.
+	    /*!
+	     * \param[in] temp_dir directory of the temporary file. If it is empty, TMPDIR or /tmp is used.
+	     */
+	    explicit SpilledResult(const std::string& temp_dir="");
+	    ~SpilledResult();
+
+	    SpilledResult(const SpilledResult&) = delete;
+	    SpilledResult& operator=(const SpilledResult&) = delete;
+
+	    //! Number of rows.
+	    size_t size() const;
+
+	    //! true if rows are in the temporary file.
+	    bool isSpilled() const;
+
+	    //! Size of the temporary file in bytes. 0 if rows are in memory.
+	    size_t fileBytes() const;
+
+	    //! Names of columns.
+	    const std::vector<std::string>& names() const;
+
+	    //! Get a row by the index.
+	    /*!
+	     * \exception std::out_of_range the index is not less than size().
+	     */
+	    Column_t row(const size_t& k) const;
+
+	    const_iterator begin() const;
+	    const_iterator end() const;
+
+	    //! Remove all rows and the temporary file.
+	    void clear();
+
+	private:
+	    friend class Fetcher;
+	    int32_t start(const std::vector<std::string>& names, const size_t& budget, std::string& err_msg);
+	    int32_t append(Column_t& a_row, const size_t& bytes, std::string& err_msg);
+	    int32_t finish(std::string& err_msg);
+	    int32_t spill(std::string& err_msg);
+	    int32_t write(const Column_t& a_row, std::string& err_msg);
+	    int32_t flushBuffer(std::string& err_msg);
+	    size_t skipRow(size_t offset) const;
+	    size_t decodeRow(size_t offset, Column_t& a_row) const;
+
+	    std::string temp_dir_;
+	    std::vector<std::string> names_;
+	    size_t budget_{0u};
+	    size_t bytes_{0u};
+	    size_t size_{0u};
+	    ColumnList_t rows_;
+
+	    int fd_{-1};
+	    std::string buffer_;
+	    size_t file_bytes_{0u};
+	    size_t n_written_{0u};
+	    std::vector<uint64_t> checkpoints_;
+	    const uint8_t* map_{nullptr};
+    };
+}
+#endif
@@ -0,0 +1,60 @@
+/*
+ * SqlFunction.cpp
+ *
+ * Copyright (C) 2020 Taishi Ueda <taishi.ueda@gmail.com>
+ *
+ * Distributed under terms of the MIT license.
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#include "SqlFunction.hpp"
+
+namespace sf{
+    namespace function{
+
+	//---------------------------------------------------------
+	Data SqlValue<Data>::get(sqlite3_value* value){
+	    Data ret;
+	    switch(sqlite3_value_type(value)){
+		case SQLITE_INTEGER:
+		    ret.set(static_cast<int64_t>(sqlite3_value_int64(value)));
+		    break;
+		case SQLITE_FLOAT:
+		    ret.set(sqlite3_value_double(value));
+		    break;
+		case SQLITE_TEXT:
+		    ret.set(SqlValue<std::string>::get(value));
+		    break;
+		case SQLITE_BLOB:
+		    ret.set(SqlValue<Binary_t>::get(value));
+		    break;
+		default:
+		    break;
+	    }
+	    return ret;
+	}
+
+	//---------------------------------------------------------
+	void SqlValue<Data>::result(sqlite3_context* ctx, const Data& value){
+	    if(value.size() == 0u && value.type() != TEXT && value.type() != BLOB){
+		sqlite3_result_null(ctx);
+		return;
+	    }
+	    switch(value.type()){
+		case NONE:
+		    sqlite3_result_null(ctx);
+		    break;
+		case INT8:{ int8_t v = 0; value.get(v); SqlValue<int8_t>::result(ctx, v); break;}
+		case INT16:{ int16_t v = 0; value.get(v); SqlValue<int16_t>::result(ctx, v); break;}
+		case INT32:{ int32_t v = 0; value.get(v); SqlValue<int32_t>::result(ctx, v); break;}
+		case INT64:{ int64_t v = 0; value.get(v); SqlValue<int64_t>::result(ctx, v); break;}
+		case UINT64:{ uint64_t v = 0u; value.get(v); SqlValue<uint64_t>::result(ctx, v); break;}
+		case FLOAT:{ float v = 0.0f; value.get(v); SqlValue<float>::result(ctx, v); break;}
+		case DOUBLE:{ double v = 0.0; value.get(v); SqlValue<double>::result(ctx, v); break;}
+		case BOOL:{ bool v = false; value.get(v); SqlValue<bool>::result(ctx, v); break;}
+		case TEXT:{ std::string v; value.get(v); SqlValue<std::string>::result(ctx, v); break;}
+		case BLOB:{ Binary_t v; value.get(v); SqlValue<Binary_t>::result(ctx, v); break;}
+	    }
+	}
+    }
+}
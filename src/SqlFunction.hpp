@@ -0,0 +1,271 @@
+/*
+ * SqlFunction.hpp
+ *
+ * Copyright (C) 2020 Taishi Ueda <taishi.ueda@gmail.com>
+ *
+ * Distributed under terms of the MIT license.
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#ifndef SF_SQL_FUNCTION_HPP
+#define SF_SQL_FUNCTION_HPP
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include "SqliteFetcher.hpp"
+
+//! SqliteFetcher name space
+namespace sf{
+
+    //! Helpers to call C++ callables from SQL.
+    namespace function{
+
+	//! Sequence of indexes of arguments.
+	template<size_t... Is>
+	    struct IndexSequence{};
+
+	//! Make IndexSequence<0, 1, ..., N-1>.
+	template<size_t N, size_t... Is>
+	    struct MakeIndexSequence : MakeIndexSequence<N - 1u, N - 1u, Is...>{};
+
+	template<size_t... Is>
+	    struct MakeIndexSequence<0u, Is...>{
+		using type = IndexSequence<Is...>;
+	    };
+
+	//! Result and argument types of a callable.
+	template<typename F>
+	    struct FunctionTraits : FunctionTraits<decltype(&F::operator())>{};
+
+	template<typename R, typename... Args>
+	    struct FunctionTraits<R(*)(Args...)>{
+		using result_type = typename std::decay<R>::type;
+		template<size_t K>
+		    using arg_type = typename std::decay<
+		    typename std::tuple_element<K, std::tuple<Args...>>::type>::type;
+		static const size_t arity = sizeof...(Args);
+	    };
+
+	template<typename R, typename... Args>
+	    struct FunctionTraits<R(Args...)> : FunctionTraits<R(*)(Args...)>{};
+
+	template<typename C, typename R, typename... Args>
+	    struct FunctionTraits<R(C::*)(Args...) const> : FunctionTraits<R(*)(Args...)>{};
+
+	template<typename C, typename R, typename... Args>
+	    struct FunctionTraits<R(C::*)(Args...)> : FunctionTraits<R(*)(Args...)>{};
+
+	//! Conversion between SQL values and C++ types.
+	/*!
+	 * Arguments are converted by SQLite like sqlite3_value_int64(), so NULL becomes 0 or empty.
+	 * Take Data to tell NULL, whose type is NONE for NULL.
+	 */
+	template<typename T>
+	    struct SqlValue;
+
+	template<>
+	    struct SqlValue<bool>{
+		static bool get(sqlite3_value* value){
+		    return sqlite3_value_int64(value) != 0;
+		}
+		static void result(sqlite3_context* ctx, const bool& value){
+		    sqlite3_result_int(ctx, value ? 1 : 0);
+		}
+	    };
+
+	//! Integers are passed as 64 bits values.
+	template<typename T>
+	    struct SqlInteger{
+		static T get(sqlite3_value* value){
+		    return static_cast<T>(sqlite3_value_int64(value));
+		}
+		static void result(sqlite3_context* ctx, const T& value){
+		    sqlite3_result_int64(ctx, static_cast<sqlite3_int64>(value));
+		}
+	    };
+	template<> struct SqlValue<int8_t> : SqlInteger<int8_t>{};
+	template<> struct SqlValue<int16_t> : SqlInteger<int16_t>{};
+	template<> struct SqlValue<int32_t> : SqlInteger<int32_t>{};
+	template<> struct SqlValue<int64_t> : SqlInteger<int64_t>{};
+	template<> struct SqlValue<uint64_t> : SqlInteger<uint64_t>{};
+
+	//! Real numbers are passed as double.
+	template<typename T>
+	    struct SqlReal{
+		static T get(sqlite3_value* value){
+		    return static_cast<T>(sqlite3_value_double(value));
+		}
+		static void result(sqlite3_context* ctx, const T& value){
+		    sqlite3_result_double(ctx, static_cast<double>(value));
+		}
+	    };
+	template<> struct SqlValue<float> : SqlReal<float>{};
+	template<> struct SqlValue<double> : SqlReal<double>{};
+
+	template<>
+	    struct SqlValue<std::string>{
+		static std::string get(sqlite3_value* value){
+		    const unsigned char* text = sqlite3_value_text(value);
+		    return (text == nullptr) ? std::string()
+			: std::string(reinterpret_cast<const char*>(text), sqlite3_value_bytes(value));
+		}
+		static void result(sqlite3_context* ctx, const std::string& value){
+		    sqlite3_result_text64(ctx, value.data(), value.size(), SQLITE_TRANSIENT, SQLITE_UTF8);
+		}
+	    };
+
+	template<>
+	    struct SqlValue<Binary_t>{
+		static Binary_t get(sqlite3_value* value){
+		    const uint8_t* head = static_cast<const uint8_t*>(sqlite3_value_blob(value));
+		    return (head == nullptr) ? Binary_t()
+			: Binary_t(head, head + sqlite3_value_bytes(value));
+		}
+		static void result(sqlite3_context* ctx, const Binary_t& value){
+		    sqlite3_result_blob64(ctx, value.data(), value.size(), SQLITE_TRANSIENT);
+		}
+	    };
+
+	//! Data keeps the storage class of an argument. NULL is Data of NONE.
+	template<>
+	    struct SqlValue<Data>{
+		static Data get(sqlite3_value* value);
+		static void result(sqlite3_context* ctx, const Data& value);
+	    };
+
+	//---------------------------------------------------------
+	template<typename F, size_t... Is>
+	    inline void invoke(F& func, sqlite3_context* ctx, sqlite3_value** argv, IndexSequence<Is...>){
+		using Traits = FunctionTraits<F>;
+		SqlValue<typename Traits::result_type>::result(ctx,
+			func(SqlValue<typename Traits::template arg_type<Is>>::get(argv[Is])...));
+	    }
+
+	//! Entry of a scalar function called by SQLite.
+	template<typename F>
+	    void callFunction(sqlite3_context* ctx, int, sqlite3_value** argv){
+		F* func = static_cast<F*>(sqlite3_user_data(ctx));
+		try{
+		    invoke(*func, ctx, argv,
+			    typename MakeIndexSequence<FunctionTraits<F>::arity>::type());
+		}
+		catch(const std::exception& e){
+		    sqlite3_result_error(ctx, e.what(), -1);
+		}
+		catch(...){
+		    sqlite3_result_error(ctx, "unknown exception", -1);
+		}
+	    }
+
+	//! Callables of an aggregate function.
+	template<typename T_STATE, typename F_STEP, typename F_FINAL>
+	    struct Aggregate{
+		F_STEP step;
+		F_FINAL final_func;
+	    };
+
+	//---------------------------------------------------------
+	// The first argument of step is the state.
+	template<typename F, typename T_STATE, size_t... Is>
+	    inline void invokeStep(F& step, T_STATE& state, sqlite3_value** argv, IndexSequence<Is...>){
+		using Traits = FunctionTraits<F>;
+		step(state, SqlValue<typename Traits::template arg_type<Is + 1u>>::get(argv[Is])...);
+	    }
+
+	//! Entry of a step of an aggregate function called by SQLite.
+	template<typename T_AGGREGATE, typename T_STATE>
+	    void callStep(sqlite3_context* ctx, int, sqlite3_value** argv){
+		T_AGGREGATE* aggregate = static_cast<T_AGGREGATE*>(sqlite3_user_data(ctx));
+		T_STATE** state = static_cast<T_STATE**>(sqlite3_aggregate_context(ctx, sizeof(T_STATE*)));
+		if(state == nullptr){
+		    sqlite3_result_error_nomem(ctx);
+		    return;
+		}
+		try{
+		    if(*state == nullptr){
+			*state = new T_STATE();
+		    }
+		    invokeStep(aggregate->step, **state, argv, typename MakeIndexSequence<
+			    FunctionTraits<decltype(aggregate->step)>::arity - 1u>::type());
+		}
+		catch(const std::exception& e){
+		    sqlite3_result_error(ctx, e.what(), -1);
+		}
+		catch(...){
+		    sqlite3_result_error(ctx, "unknown exception", -1);
+		}
+	    }
+
+	//! Entry of the end of an aggregate function called by SQLite. The state is deleted.
+	template<typename T_AGGREGATE, typename T_STATE>
+	    void callFinal(sqlite3_context* ctx){
+		T_AGGREGATE* aggregate = static_cast<T_AGGREGATE*>(sqlite3_user_data(ctx));
+		//there is no state if no rows are aggregated
+		T_STATE** state = static_cast<T_STATE**>(sqlite3_aggregate_context(ctx, 0));
+		T_STATE* a_state = (state == nullptr) ? nullptr : *state;
+		try{
+		    using R = typename FunctionTraits<decltype(aggregate->final_func)>::result_type;
+		    if(a_state == nullptr){
+			T_STATE empty_state;
+			SqlValue<R>::result(ctx, aggregate->final_func(empty_state));
+		    }
+		    else{
+			SqlValue<R>::result(ctx, aggregate->final_func(*a_state));
+		    }
+		}
+		catch(const std::exception& e){
+		    sqlite3_result_error(ctx, e.what(), -1);
+		}
+		catch(...){
+		    sqlite3_result_error(ctx, "unknown exception", -1);
+		}
+		delete a_state;
+	    }
+
+	//! Delete user data of a function.
+	template<typename T>
+	    void destroy(void* ptr){
+		delete static_cast<T*>(ptr);
+	    }
+    }
+
+    //-------------------------------------------------------------------
+    template<typename F>
+	int32_t Fetcher::registerFunction(const std::string& name, F func,
+		std::string& err_msg, const bool& deterministic){
+	    err_msg.clear();
+	    int32_t flags = SQLITE_UTF8 | (deterministic ? SQLITE_DETERMINISTIC : 0);
+	    F* user_data = new F(std::move(func));
+	    //user_data is deleted by SQLite even if this fails
+	    int32_t ret = sqlite3_create_function_v2(db_ptr_, name.c_str(),
+		    static_cast<int>(function::FunctionTraits<F>::arity), flags, user_data,
+		    &function::callFunction<F>, nullptr, nullptr, &function::destroy<F>);
+	    if(ret != SQLITE_OK){
+		err_msg = sqlite3_errmsg(db_ptr_);
+	    }
+	    return ret;
+	}
+
+    //-------------------------------------------------------------------
+    template<typename T_STATE, typename F_STEP, typename F_FINAL>
+	int32_t Fetcher::registerAggregate(const std::string& name, F_STEP step, F_FINAL final_func,
+		std::string& err_msg, const bool& deterministic){
+	    err_msg.clear();
+	    using Aggregate_t = function::Aggregate<T_STATE, F_STEP, F_FINAL>;
+	    int32_t flags = SQLITE_UTF8 | (deterministic ? SQLITE_DETERMINISTIC : 0);
+	    Aggregate_t* user_data = new Aggregate_t{std::move(step), std::move(final_func)};
+	    int32_t ret = sqlite3_create_function_v2(db_ptr_, name.c_str(),
+		    static_cast<int>(function::FunctionTraits<F_STEP>::arity) - 1, flags, user_data,
+		    nullptr, &function::callStep<Aggregate_t, T_STATE>,
+		    &function::callFinal<Aggregate_t, T_STATE>, &function::destroy<Aggregate_t>);
+	    if(ret != SQLITE_OK){
+		err_msg = sqlite3_errmsg(db_ptr_);
+	    }
+	    return ret;
+	}
+}
+#endif
@@ -8,11 +8,63 @@
  */
 
 #include "SqliteFetcher.hpp"
+#include "ThreadPool.hpp"
+#include "Literal.hpp"
+#include "VirtualTable.hpp"
+#include "SchemaRegistry.hpp"
+#include "SpilledResult.hpp"
+#include "Codec.hpp"
 #include <sstream>
 #include <algorithm>
+#include <iostream>
+#include <cctype>
+#include <cstring>
+#include <iterator>
+#include <cmath>
+#include <stdexcept>
 
 namespace sf{
 
+    //---------------------------------------------------------
+    // Convert a declared type of SQL into Type_t.
+    static Type_t declToType(const sql_types::TypeStr_t& type){
+	//separate by white space
+	std::istringstream iss(type);
+	std::string a_word;
+	iss >> a_word;
+
+	//delete cascade from type
+	size_t cpos = a_word.find('(');
+	if(cpos != std::string::npos){
+	    a_word = a_word.substr(0u,cpos);
+	}
+
+	auto i_def = TypeDef.find(a_word);
+	if(i_def != TypeDef.end()){
+	    return i_def->second;
+	}
+	else{
+	    return BLOB;
+	}
+    }
+
+    //-------------------------------------------------------------------
+    // Type of a value decided by its storage class.
+    static Type_t storageType(sqlite3_stmt* stmt, const int32_t& k){
+	switch(sqlite3_column_type(stmt, k)){
+	    case SQLITE_INTEGER:
+		return INT64;
+	    case SQLITE_FLOAT:
+		return DOUBLE;
+	    case SQLITE_TEXT:
+		return TEXT;
+	    case SQLITE_BLOB:
+		return BLOB;
+	    default:
+		return NONE;
+	}
+    }
+
     //##############################################################
     // Data
     //---------------------------------------------------------
@@ -47,24 +99,7 @@ namespace sf{
 	    return;
 	}
         
-	//separate by white space
-	std::istringstream iss(type);
-	std::vector<std::string> words;
-	std::string a_word;
-	iss >> a_word;
-
-	//delete cascade from type
-	size_t cpos = a_word.find('(');
-	if(cpos != std::string::npos){
-	    a_word = a_word.substr(0u,cpos);
-	}
-
-	if(TypeDef.find(a_word) != TypeDef.end()){
-	    type_ = TypeDef.at(a_word);
-	}
-	else{
-	    type_ = BLOB;
-	}
+	type_ = declToType(type);
     }
     //---------------------------------------------------------
     void Data::setType(Type_t type){
@@ -115,6 +150,10 @@ namespace sf{
 	std::string ret = type_str_;
 
 	if(print_flags){
+	    //a part of the type name, so that the affinity is kept
+	    if((key_flg_ & COMPRESSED) != 0u){
+		ret += " COMPRESSED";
+	    }
 	    if((key_flg_ & PRIMARY_KEY) != 0u){
 		ret += " PRIMARY KEY";
 	    }
@@ -128,7 +167,8 @@ namespace sf{
 		ret += " NOT NULL";
 	    }
 	    if((key_flg_ & DEFAULT) != 0u){
-		ret += " DEFAULT " + str();
+		ret += " DEFAULT ";
+		appendStr(ret);
 	    }
 	}
 
@@ -143,8 +183,8 @@ namespace sf{
     //---------------------------------------------------------
     bool Data::get(void* value_ptr, const Type_t& type) const{
 	if(type_ == type){
-	    for(size_t k=0u; k<data_.size(); ++k){
-		reinterpret_cast<uint8_t*>(value_ptr)[k] = data_[k];
+	    if(!data_.empty()){
+		std::memcpy(value_ptr, data_.data(), data_.size());
 	    }
 	    return true;
 	}
@@ -213,9 +253,12 @@ namespace sf{
     template<>
     bool Data::get(std::string& value) const{
 	if(this->type_ == TEXT){
-	    value.clear();
-	    for(size_t k=0u; k<this->data_.size(); ++k){
-		value.push_back(static_cast<char>(this->data_[k]));
+	    Binary_t raw;
+	    if((key_flg_ & COMPRESSED) != 0u && codec::decompress(data_.data(), data_.size(), raw)){
+		value.assign(raw.begin(), raw.end());
+	    }
+	    else{
+		value.assign(this->data_.begin(), this->data_.end());
 	    }
 	    return true;
 	}
@@ -240,7 +283,9 @@ namespace sf{
     template<>
     bool Data::get(Binary_t& value) const{
 	if(this->type_ == BLOB){
-	    value = this->data_;
+	    if((key_flg_ & COMPRESSED) == 0u || !codec::decompress(data_.data(), data_.size(), value)){
+		value = this->data_;
+	    }
 	    return true;
 	}
 	else{
@@ -291,24 +336,62 @@ namespace sf{
     //---------------------------------------------------------
     template<>
     void Data::set(std::string value){
-	this->data_.clear();
-	for(size_t k=0u; k<value.size(); ++k){
-	    this->data_.push_back(static_cast<uint8_t>(value[k]));
-	}
+	set(static_cast<const std::string&>(value));
+    }
+    //---------------------------------------------------------
+    void Data::set(const std::string& value){
+	this->data_.assign(value.begin(), value.end());
 	this->type_ = TEXT;
     }
+    //---------------------------------------------------------
+    void Data::set(std::string&& value){
+	//TEXT is held as bytes, so characters are copied once here.
+	set(static_cast<const std::string&>(value));
+	std::string().swap(value);
+    }
+    //---------------------------------------------------------
     void Data::set(const char* value){
-	std::string str(value);
-	set(str);
+	this->data_.assign(value, value + std::strlen(value));
+	this->type_ = TEXT;
     }
 
     //---------------------------------------------------------
     template<>
     void Data::set(Binary_t value){
+	set(std::move(value));
+    }
+    //---------------------------------------------------------
+    void Data::set(const Binary_t& value){
 	this->data_ = value;
 	this->type_ = BLOB;
     }
     //---------------------------------------------------------
+    void Data::set(Binary_t&& value){
+	this->data_ = std::move(value);
+	this->type_ = BLOB;
+    }
+
+    //---------------------------------------------------------
+    Data::Data(Binary_t&& value, const KeyFlag_t& flg)
+	:key_flg_(flg){
+	    set(std::move(value));
+	    setType(type_);
+	}
+
+    //---------------------------------------------------------
+    bool Data::take(Binary_t& value){
+	if(this->type_ == BLOB){
+	    if((key_flg_ & COMPRESSED) == 0u || !codec::decompress(data_.data(), data_.size(), value)){
+		value = std::move(this->data_);
+	    }
+	    this->data_.clear();
+	    return true;
+	}
+	else{
+	    return false;
+	}
+    }
+    //---------------------------------------------------------
     template<>
     bool Data::change(const int8_t& value){
 	if(this->type_ == INT8){
@@ -429,86 +512,116 @@ namespace sf{
     //---------------------------------------------------------
     std::string Data::str()const{
 	std::string ret;
+	appendStr(ret);
+	return ret;
+    }
+
+    //---------------------------------------------------------
+    void Data::appendStr(std::string& out) const{
+	if((key_flg_ & COMPRESSED) != 0u && (type_ == TEXT || type_ == BLOB)){
+	    appendCompressed(out, COMPRESS_THRESHOLD);
+	    return;
+	}
+	if(data_.empty() && type_ != TEXT && type_ != BLOB){
+	    out += "NULL";
+	    return;
+	}
 	switch(type_){
 	    case NONE:{
-			  ret = "";
+			  out += "NULL";
 			  break;
 		      }
 	    case BOOL:{
-			  bool value_bool = 0;
+			  bool value_bool = false;
 			  this->get(value_bool);
-			  ret = std::to_string(value_bool);
+			  out.push_back(value_bool ? '1' : '0');
 			  break;
 		      }
 	    case INT8:{
 			  int8_t value_int8 = 0;
 			  this->get(value_int8);
-			  ret = std::to_string(value_int8);
+			  literal::appendInt(out, value_int8);
 			  break;
 		      }
 	    case INT16:{
 			   int16_t value_int16 = 0;
 			   this->get(value_int16);
-			   ret = std::to_string(value_int16);
+			   literal::appendInt(out, value_int16);
 			   break;
 		       }
 	    case INT32:{
 			   int32_t value_int32 = 0;
 			   this->get(value_int32);
-			   ret = std::to_string(value_int32);
+			   literal::appendInt(out, value_int32);
 			   break;
 		       }
 	    case INT64:{
 			   int64_t value_int64 = 0;
 			   this->get(value_int64);
-			   ret = std::to_string(value_int64);
+			   literal::appendInt(out, value_int64);
 			   break;
 		       }
 	    case UINT64:{
 			   uint64_t value_uint64 = 0;
 			   this->get(value_uint64);
-			   ret = std::to_string(value_uint64);
+			   literal::appendUint(out, value_uint64);
 			   break;
 		       }
 	    case FLOAT:{
 			  float value_float = 0.0f;
 			  this->get(value_float);
-			  ret = std::to_string(value_float);
+			  literal::appendFloat(out, value_float);
 			  break;
 		      }
 	    case DOUBLE:{
 			  double value_real = 0.0;
 			  this->get(value_real);
-			  ret = std::to_string(value_real);
+			  literal::appendDouble(out, value_real);
 			  break;
 		      }
 	    case TEXT:{
-			  std::string value_text;
-			  this->get(value_text);
-			  ret = "'" + value_text + "'";
+			  literal::appendText(out,
+				  reinterpret_cast<const char*>(data_.data()), data_.size());
 			  break;
 		      }
 	    case BLOB:{
-			  Binary_t value_blob;
-			  this->get(value_blob);
-			  char buff[2*value_blob.size()+1];
-			  for(size_t k=0u; k<value_blob.size(); ++k){
-			      sprintf(&buff[2u*k],"%02x",value_blob[k]);
-			  }
-			  buff[2*value_blob.size()] = '\0';
-			  ret = "X'" + std::string(buff) + "'";
+			  literal::appendBlob(out, data_.data(), data_.size());
 			  break;
 		      }
 	}
+    }
 
-
-	return ret;
+    //---------------------------------------------------------
+    // Append a TEXT or BLOB value as a compressed BLOB literal.
+    void Data::appendCompressed(std::string& out, const size_t& threshold) const{
+	if(codec::isCompressed(data_.data(), data_.size())){
+	    literal::appendBlob(out, data_.data(), data_.size());
+	    return;
+	}
+	Binary_t packed;
+	if(data_.size() >= threshold && codec::compress(data_.data(), data_.size(), packed)){
+	    literal::appendBlob(out, packed.data(), packed.size());
+	}
+	else if(type_ == TEXT){
+	    literal::appendText(out, reinterpret_cast<const char*>(data_.data()), data_.size());
+	}
+	else{
+	    literal::appendBlob(out, data_.data(), data_.size());
+	}
     }
 
     const Type_t& Data::type() const{
 	return type_;
     }
 
+    size_t Data::size() const{
+	return data_.size();
+    }
+
+    const uint8_t* Data::bytes() const{
+	return data_.empty() ? nullptr : data_.data();
+    }
+
     //---------------------------------------------------------
     void Data::set(const Type_t& type, const std::string& dflt_str){
 	switch(type){
@@ -541,13 +654,14 @@ namespace sf{
 		       }
 	    case INT64:{
 			  int64_t value_int64_t 
-			      = static_cast<int64_t>(std::stoi(dflt_str));
+			      = static_cast<int64_t>(std::stoll(dflt_str));
 			  this->set(value_int64_t);
 			   break;
 		       }
 	    case UINT64:{
+			  //SQLite holds it as a signed integer
 			  uint64_t value_uint64_t 
-			      = static_cast<uint64_t>(std::stoi(dflt_str));
+			      = static_cast<uint64_t>(std::stoll(dflt_str));
 			  this->set(value_uint64_t);
 			   break;
 		       }
@@ -569,14 +683,7 @@ namespace sf{
 		      }
 	    case BLOB:{
 			  Binary_t value_blob;
-			  for(size_t k=0u; 2u*k+3u < dflt_str.length()-1u; ++k){
-			      uint8_t elm;
-			      std::string elm_str;
-			      elm_str.push_back(dflt_str[2u*k+2u]);
-			      elm_str.push_back(dflt_str[2u*k+3u]);
-			      elm = static_cast<uint8_t>(std::stoi(elm_str, nullptr, 16));
-			      value_blob.push_back(elm);
-			  }
+			  literal::decodeHex(dflt_str, value_blob);
 			  this->set(value_blob);
 			  break;
 		      }
@@ -584,309 +691,3166 @@ namespace sf{
     }
 
 
-    //########################################################################
-    // Fetcher
-    // Constructor
-    Fetcher::Fetcher(){}
+    //##############################################################
+    // ArenaData
+    //---------------------------------------------------------
+    const Type_t& ArenaData::type() const{
+	return type_;
+    }
 
-    //-------------------------------------------------------------------
-    // Constructor. Open database.
-    Fetcher::Fetcher(const std::string& db_name){
-       int32_t retval = sqlite3_open(db_name.c_str(), &db_ptr_);
-       if(retval != SQLITE_OK){
-	   last_err_ = sqlite3_errstr(retval);
-       }
-       else{
-	   is_opened_ = true;
-	   last_table_info_ = getTableInfo(last_err_);
-       }
-    } 
+    //---------------------------------------------------------
+    bool ArenaData::isNull() const{
+	return is_null_;
+    }
 
-    //-------------------------------------------------------------------
-    // Open database.
-    int32_t Fetcher::open(const std::string& db_name, std::string& err_msg,
-	    const int32_t& flags, const char* zVfs){
-       int32_t retval 
-	   = sqlite3_open_v2(db_name.c_str(), &db_ptr_, flags, zVfs);
-       if(retval != SQLITE_OK){
-	   this->last_err_ = sqlite3_errstr(retval);
-       }
-       else{
-	   this->is_opened_ = true;
-	   last_table_info_ = getTableInfo(last_err_);
-       }
-       return retval;
+    //---------------------------------------------------------
+    size_t ArenaData::size() const{
+	return size_;
     }
 
-    //-------------------------------------------------------------------
-    int32_t Fetcher::close(std::string err_msg){
-	err_msg = "";
-	int32_t retval 
-	    = sqlite3_close(&db_ptr_);
-	if(retval != SQLITE_OK){
-	    this->last_err_ = sqlite3_errstr(retval);
-	    err_msg = this->last_err_;
-	}
-	return retval;
+    //---------------------------------------------------------
+    const uint8_t* ArenaData::bytes() const{
+	return (size_ <= sizeof(inline_)) ? inline_ : data_;
     }
 
-    //-------------------------------------------------------------------
-    static int execCallback(void *result_ptr, int argc, char **argv, char **col_name){
-	ResultElement_t a_res;
-        for(int k=0; k<argc; ++k){
-	    if(argv[k] == nullptr || argv[k][0] == '\0'){
-		a_res[col_name[k]] = "";
-	    }
-	    else{
-		a_res[col_name[k]] = argv[k];
-	    }
+    //---------------------------------------------------------
+    bool ArenaData::get(void* value_ptr, const Type_t& type) const{
+	if(is_null_ || type_ != type){
+	    return false;
 	}
-	reinterpret_cast<ExecResult_t*>(result_ptr)->result.push_back(a_res);
-	return 0;
+	std::memcpy(value_ptr, bytes(), size_);
+	return true;
     }
 
-    //-------------------------------------------------------------------
-    // Execute SQLite query
-    ExecResult_t Fetcher::exec(const std::string& query, std::string& err_msg){
-	err_msg.clear();
-	char *err_char = 0;
-	last_exec_result_.in_sql = query;
-	last_exec_result_.result.clear();
-        int32_t ret = sqlite3_exec(db_ptr_, query.c_str(), 
-		execCallback, &last_exec_result_, &err_char);
-	if(ret != SQLITE_OK){
-	    err_msg = err_char;
-	    sqlite3_free(err_char);
+    //---------------------------------------------------------
+    void ArenaData::set(const void* value_ptr, const size_t& size, ArenaColumnList& list){
+	size_ = static_cast<uint32_t>(size);
+	is_null_ = false;
+	if(size <= sizeof(inline_)){
+	    std::memcpy(inline_, value_ptr, size);
 	}
-
-	if(to_info_update_){
-	    to_info_update_ = false;
-	    last_table_info_ = getTableInfo(last_err_);
+	else{
+	    uint8_t* buff = list.allocate(size);
+	    std::memcpy(buff, value_ptr, size);
+	    data_ = buff;
 	}
-	return last_exec_result_;
     }
 
-    //-------------------------------------------------------------------
-    // Execute SQLite query
-    std::list<ExecResult_t> Fetcher::execSeparate(const std::string& query, std::string& err_msg){
-	err_msg.clear();
-	std::list<ExecResult_t> ret_list;
-	size_t i_begin = 0u;
-	size_t i_dlm = 0u;
-	while(i_begin < query.size()){
-	    i_dlm = query.find(";",i_begin);
-	    if(i_dlm == std::string::npos){
-		i_dlm=query.size()-1u;
-	    }
-	    auto a_query = query.substr(i_begin,i_dlm-i_begin);
-	    auto a_res = exec(a_query, err_msg);
-	    if(!err_msg.empty()){
-		break;
-	    }
-	    else{
-		ret_list.push_back(a_res);
-	    }
-	    i_begin = i_dlm+1u;
+    //---------------------------------------------------------
+    template<>
+    bool ArenaData::get(int8_t& value) const{
+	return get(&value, INT8);
+    }
+    //---------------------------------------------------------
+    template<>
+    bool ArenaData::get(int16_t& value) const{
+	return get(&value, INT16);
+    }
+    //---------------------------------------------------------
+    template<>
+    bool ArenaData::get(int32_t& value) const{
+	return get(&value, INT32);
+    }
+    //---------------------------------------------------------
+    template<>
+    bool ArenaData::get(int64_t& value) const{
+	return get(&value, INT64);
+    }
+    //---------------------------------------------------------
+    template<>
+    bool ArenaData::get(uint64_t& value) const{
+	return get(&value, UINT64);
+    }
+    //---------------------------------------------------------
+    template<>
+    bool ArenaData::get(float& value) const{
+	return get(&value, FLOAT);
+    }
+    //---------------------------------------------------------
+    template<>
+    bool ArenaData::get(double& value) const{
+	return get(&value, DOUBLE);
+    }
+    //---------------------------------------------------------
+    template<>
+    bool ArenaData::get(bool& value) const{
+	return get(&value, BOOL);
+    }
+    //---------------------------------------------------------
+    template<>
+    bool ArenaData::get(std::string& value) const{
+	if(is_null_ || type_ != TEXT){
+	    return false;
 	}
-	return ret_list;
+	value.assign(reinterpret_cast<const char*>(bytes()), size_);
+	return true;
     }
-
-    //-------------------------------------------------------------------
-    // Dump result of exec function into string.
-    std::string Fetcher::dump(const ExecResult_t& res) const{
-	std::string ret = "{\"Input\":\"" + res.in_sql + "\",\n";
-	auto i_res = res.result.begin();
-	auto i_res_end = res.result.end();
-	ret += "\"results\":[";
-	bool is_first1 = false;
-	for(;i_res != i_res_end; ++i_res){
-	    if(!is_first1){
-		ret += ",\n ";
-	    }else{
-		is_first1 = false;
-	    }
-	    ret += "{";
-	    auto i_elem = i_res->begin();
-	    auto i_elem_end = i_res->end();
-	    bool is_first = true;
-	    for(;i_elem != i_elem_end; ++i_elem){
-		if(!is_first){
-		    ret += ", ";
-		}else{
-		    is_first = false;
-		}
-		ret += "\"" + i_elem->first + "\":\"" + i_elem->second + "\"";
-	    }
-	    ret += "}";
+    //---------------------------------------------------------
+    template<>
+    bool ArenaData::get(Binary_t& value) const{
+	if(is_null_ || type_ != BLOB){
+	    return false;
 	}
-	ret += "]}\n";
-	return ret;
+	value.assign(bytes(), bytes() + size_);
+	return true;
     }
 
-    //-------------------------------------------------------------------
-    //! Dump result of exec function into string.
-    std::string Fetcher::dump(const std::list<ExecResult_t>& res_list) const{
-	auto i_res_end = res_list.end();
-	std::string ret = "{\"exec_result\": [";
-	bool is_first=true;
-	for(auto i_res =res_list.begin(); i_res != i_res_end; ++i_res){
-	    if(!is_first){
+    //---------------------------------------------------------
+    Data ArenaData::data() const{
+	Data ret(type_);
+	if(is_null_){
+	    return ret;
+	}
+	switch(type_){
+	    case NONE:
+		break;
+	    case INT8:{
+			  int8_t value = 0;
+			  get(value);
+			  ret.set(value);
+			  break;
+		      }
+	    case INT16:{
+			   int16_t value = 0;
+			   get(value);
+			   ret.set(value);
+			   break;
+		       }
+	    case INT32:{
+			   int32_t value = 0;
+			   get(value);
+			   ret.set(value);
+			   break;
+		       }
+	    case INT64:{
+			   int64_t value = 0;
+			   get(value);
+			   ret.set(value);
+			   break;
+		       }
+	    case UINT64:{
+			    uint64_t value = 0u;
+			    get(value);
+			    ret.set(value);
+			    break;
+			}
+	    case FLOAT:{
+			   float value = 0.0f;
+			   get(value);
+			   ret.set(value);
+			   break;
+		       }
+	    case DOUBLE:{
+			    double value = 0.0;
+			    get(value);
+			    ret.set(value);
+			    break;
+			}
+	    case BOOL:{
+			  bool value = false;
+			  get(value);
+			  ret.set(value);
+			  break;
+		      }
+	    case TEXT:{
+			  std::string value;
+			  get(value);
+			  ret.set(value);
+			  break;
+		      }
+	    case BLOB:{
+			  Binary_t value;
+			  get(value);
+			  ret.set(value);
+			  break;
+		      }
+	}
+	return ret;
+    }
+
+    //##############################################################
+    // ArenaColumnList
+    //---------------------------------------------------------
+    ArenaColumnList::ArenaColumnList()
+	:arena_(&own_arena_){}
+
+    //---------------------------------------------------------
+    ArenaColumnList::ArenaColumnList(Arena& arena)
+	:arena_(&arena){}
+
+    //---------------------------------------------------------
+    size_t ArenaColumnList::size() const{
+	return rows_.size();
+    }
+
+    //---------------------------------------------------------
+    bool ArenaColumnList::empty() const{
+	return rows_.empty();
+    }
+
+    //---------------------------------------------------------
+    const std::vector<std::string>& ArenaColumnList::names() const{
+	return names_;
+    }
+
+    //---------------------------------------------------------
+    const ArenaData& ArenaColumnList::at(const size_t& row, const std::string& name) const{
+	auto i_name = std::find(names_.begin(), names_.end(), name);
+	if(i_name == names_.end()){
+	    throw std::out_of_range("No such a column: " + name);
+	}
+	return at(row, static_cast<size_t>(i_name - names_.begin()));
+    }
+
+    //---------------------------------------------------------
+    const ArenaData& ArenaColumnList::at(const size_t& row, const size_t& col) const{
+	if(row >= rows_.size() || col >= names_.size()){
+	    throw std::out_of_range("Index out of range in ArenaColumnList");
+	}
+	return rows_[row][col];
+    }
+
+    //---------------------------------------------------------
+    ColumnList_t ArenaColumnList::toColumnList() const{
+	ColumnList_t ret;
+	ret.reserve(rows_.size());
+	for(auto i_row = rows_.begin(); i_row != rows_.end(); ++i_row){
+	    Column_t a_col;
+	    for(size_t k=0u; k<names_.size(); ++k){
+		a_col[names_[k]] = (*i_row)[k].data();
+	    }
+	    ret.push_back(a_col);
+	}
+	return ret;
+    }
+
+    //---------------------------------------------------------
+    void ArenaColumnList::clear(){
+	rows_.clear();
+	names_.clear();
+	if(arena_ == &own_arena_){
+	    own_arena_.release();
+	}
+    }
+
+    //---------------------------------------------------------
+    void ArenaColumnList::setNames(const std::vector<std::string>& names){
+	names_ = names;
+    }
+
+    //---------------------------------------------------------
+    ArenaData* ArenaColumnList::addRow(){
+	void* buff = arena_->allocate(names_.size()*sizeof(ArenaData), alignof(ArenaData));
+	ArenaData* row = static_cast<ArenaData*>(buff);
+	for(size_t k=0u; k<names_.size(); ++k){
+	    new(&row[k]) ArenaData();
+	}
+	rows_.push_back(row);
+	return row;
+    }
+
+    //---------------------------------------------------------
+    uint8_t* ArenaColumnList::allocate(const size_t& size){
+	return static_cast<uint8_t*>(arena_->allocate(size, 1u));
+    }
+
+    //##############################################################
+    // ColumnVector
+    //---------------------------------------------------------
+    const std::string& ColumnVector::name() const{
+	return name_;
+    }
+
+    //---------------------------------------------------------
+    const Type_t& ColumnVector::type() const{
+	return type_;
+    }
+
+    //---------------------------------------------------------
+    size_t ColumnVector::size() const{
+	return size_;
+    }
+
+    //---------------------------------------------------------
+    size_t ColumnVector::nullCount() const{
+	return null_count_;
+    }
+
+    //---------------------------------------------------------
+    bool ColumnVector::isNull(const size_t& row) const{
+	return ((validity_[row >> 6] >> (row & 63u)) & 1u) == 0u;
+    }
+
+    //---------------------------------------------------------
+    const uint64_t* ColumnVector::validity() const{
+	return validity_.data();
+    }
+
+    //---------------------------------------------------------
+    const int64_t* ColumnVector::ints() const{
+	return (type_ == INT64) ? ints_.data() : nullptr;
+    }
+
+    //---------------------------------------------------------
+    const double* ColumnVector::reals() const{
+	return (type_ == DOUBLE) ? reals_.data() : nullptr;
+    }
+
+    //---------------------------------------------------------
+    const char* ColumnVector::bytes(const size_t& row, size_t& size) const{
+	if(type_ != TEXT && type_ != BLOB){
+	    size = 0u;
+	    return nullptr;
+	}
+	if(isDictionary()){
+	    if(isNull(row)){
+		size = 0u;
+		return bytes_.data();
+	    }
+	    uint32_t code = codes_[row];
+	    size = offsets_[code + 1u] - offsets_[code];
+	    return bytes_.data() + offsets_[code];
+	}
+	size = offsets_[row + 1u] - offsets_[row];
+	return bytes_.data() + offsets_[row];
+    }
+
+    //---------------------------------------------------------
+    std::string ColumnVector::text(const size_t& row) const{
+	size_t size = 0u;
+	const char* head = bytes(row, size);
+	return (head == nullptr) ? std::string() : std::string(head, size);
+    }
+
+    //---------------------------------------------------------
+    bool ColumnVector::isDictionary() const{
+	return use_dictionary_ && type_ == TEXT;
+    }
+
+    //---------------------------------------------------------
+    const uint32_t* ColumnVector::codes() const{
+	return isDictionary() ? codes_.data() : nullptr;
+    }
+
+    //---------------------------------------------------------
+    size_t ColumnVector::dictionarySize() const{
+	return isDictionary() ? offsets_.size() - 1u : 0u;
+    }
+
+    //---------------------------------------------------------
+    std::string ColumnVector::dictionary(const size_t& code) const{
+	if(code >= dictionarySize()){
+	    return std::string();
+	}
+	return bytes_.substr(offsets_[code], offsets_[code + 1u] - offsets_[code]);
+    }
+
+    //---------------------------------------------------------
+    int64_t ColumnVector::findCode(const std::string& value) const{
+	auto i_code = dictionary_index_.find(value);
+	return (i_code == dictionary_index_.end()) ? -1 : static_cast<int64_t>(i_code->second);
+    }
+
+    //---------------------------------------------------------
+    // Append a code of a TEXT value, adding the value to the dictionary if it is new.
+    // Small dictionaries are searched linearly without making a key.
+    void ColumnVector::appendCode(const char* head, const size_t& size){
+	static const size_t LINEAR_ENTRIES = 16u;
+	uint32_t n_entry = static_cast<uint32_t>(offsets_.size() - 1u);
+	if(n_entry <= LINEAR_ENTRIES){
+	    for(uint32_t code=0u; code<n_entry; ++code){
+		if(offsets_[code + 1u] - offsets_[code] == size
+			&& std::memcmp(bytes_.data() + offsets_[code], head, size) == 0){
+		    codes_.push_back(code);
+		    return;
+		}
+	    }
+	}
+	auto ins = dictionary_index_.emplace(std::string(head, size), n_entry);
+	if(ins.second){
+	    bytes_.append(head, size);
+	    offsets_.push_back(bytes_.size());
+	}
+	codes_.push_back(ins.first->second);
+    }
+
+    //---------------------------------------------------------
+    // Decide the storage type. Rows so far are nulls and get empty slots.
+    void ColumnVector::setType(const Type_t& type){
+	switch(type){
+	    case INT8:
+	    case INT16:
+	    case INT32:
+	    case INT64:
+	    case UINT64:
+	    case BOOL:
+		type_ = INT64;
+		ints_.assign(size_, 0);
+		break;
+	    case FLOAT:
+	    case DOUBLE:
+		type_ = DOUBLE;
+		reals_.assign(size_, 0.0);
+		break;
+	    case TEXT:
+	    case BLOB:
+		type_ = type;
+		if(isDictionary()){
+		    codes_.assign(size_, 0u);
+		    offsets_.assign(1u, 0u);
+		}
+		else{
+		    offsets_.assign(size_ + 1u, 0u);
+		}
+		break;
+	    case NONE:
+		type_ = NONE;
+		break;
+	}
+    }
+
+    //---------------------------------------------------------
+    void ColumnVector::reserve(const size_t& n_rows){
+	validity_.reserve((n_rows + 63u) / 64u);
+	if(type_ == INT64){
+	    ints_.reserve(n_rows);
+	}
+	else if(type_ == DOUBLE){
+	    reals_.reserve(n_rows);
+	}
+	else if(isDictionary()){
+	    codes_.reserve(n_rows);
+	}
+	else if(type_ == TEXT || type_ == BLOB){
+	    offsets_.reserve(n_rows + 1u);
+	}
+    }
+
+    //---------------------------------------------------------
+    // Append a value of a statement.
+    void ColumnVector::append(sqlite3_stmt* stmt, const int32_t& k){
+	bool is_null = (sqlite3_column_type(stmt, k) == SQLITE_NULL);
+	if(type_ == NONE && !is_null){
+	    setType(storageType(stmt, k));
+	}
+	if((size_ & 63u) == 0u){
+	    validity_.push_back(0u);
+	}
+	if(is_null){
+	    ++null_count_;
+	}
+	else{
+	    validity_.back() |= (uint64_t(1) << (size_ & 63u));
+	}
+	switch(type_){
+	    case INT64:
+		ints_.push_back(is_null ? 0 : sqlite3_column_int64(stmt, k));
+		break;
+	    case DOUBLE:
+		reals_.push_back(is_null ? 0.0 : sqlite3_column_double(stmt, k));
+		break;
+	    case TEXT:
+		if(isDictionary()){
+		    if(is_null){
+			codes_.push_back(0u);
+		    }
+		    else{
+			appendCode(reinterpret_cast<const char*>(sqlite3_column_text(stmt, k)),
+				static_cast<size_t>(sqlite3_column_bytes(stmt, k)));
+		    }
+		    break;
+		}
+		//fall through
+	    case BLOB:{
+			  const void* head = (type_ == TEXT)
+			      ? static_cast<const void*>(sqlite3_column_text(stmt, k))
+			      : sqlite3_column_blob(stmt, k);
+			  size_t size = static_cast<size_t>(sqlite3_column_bytes(stmt, k));
+			  if(head != nullptr){
+			      bytes_.append(static_cast<const char*>(head), size);
+			  }
+			  offsets_.push_back(bytes_.size());
+			  break;
+		      }
+	    default:
+		break;
+	}
+	++size_;
+    }
+
+    //##############################################################
+    // ColumnarResult
+    //---------------------------------------------------------
+    size_t ColumnarResult::size() const{
+	return size_;
+    }
+
+    //---------------------------------------------------------
+    std::vector<std::string> ColumnarResult::names() const{
+	std::vector<std::string> ret;
+	for(auto i_col = columns_.begin(); i_col != columns_.end(); ++i_col){
+	    ret.push_back(i_col->name_);
+	}
+	return ret;
+    }
+
+    //---------------------------------------------------------
+    const ColumnVector& ColumnarResult::column(const std::string& name) const{
+	for(auto i_col = columns_.begin(); i_col != columns_.end(); ++i_col){
+	    if(i_col->name_ == name){
+		return *i_col;
+	    }
+	}
+	throw std::out_of_range("No such a column: " + name);
+    }
+
+    //---------------------------------------------------------
+    const ColumnVector& ColumnarResult::column(const size_t& col) const{
+	return columns_[col];
+    }
+
+    //---------------------------------------------------------
+    void ColumnarResult::clear(){
+	size_ = 0u;
+	columns_.clear();
+    }
+
+    //##############################################################
+    // BlobStream
+    //---------------------------------------------------------
+    BlobStream::BlobStream(){}
+
+    //---------------------------------------------------------
+    BlobStream::~BlobStream(){
+	close();
+    }
+
+    //---------------------------------------------------------
+    BlobStream::BlobStream(BlobStream&& other)
+	:fetcher_(other.fetcher_), db_ptr_(other.db_ptr_), blob_ptr_(other.blob_ptr_),
+	table_name_(std::move(other.table_name_)), rowid_(other.rowid_){
+	    if(fetcher_ != nullptr){
+		fetcher_->blob_streams_.erase(&other);
+		fetcher_->blob_streams_.insert(this);
+	    }
+	    other.fetcher_ = nullptr;
+	    other.db_ptr_ = nullptr;
+	    other.blob_ptr_ = nullptr;
+	}
+
+    //---------------------------------------------------------
+    BlobStream& BlobStream::operator=(BlobStream&& other){
+	if(this != &other){
+	    close();
+	    fetcher_ = other.fetcher_;
+	    db_ptr_ = other.db_ptr_;
+	    blob_ptr_ = other.blob_ptr_;
+	    table_name_ = std::move(other.table_name_);
+	    rowid_ = other.rowid_;
+	    if(fetcher_ != nullptr){
+		fetcher_->blob_streams_.erase(&other);
+		fetcher_->blob_streams_.insert(this);
+	    }
+	    other.fetcher_ = nullptr;
+	    other.db_ptr_ = nullptr;
+	    other.blob_ptr_ = nullptr;
+	}
+	return *this;
+    }
+
+    //---------------------------------------------------------
+    bool BlobStream::isOpened() const{
+	return blob_ptr_ != nullptr;
+    }
+
+    //---------------------------------------------------------
+    size_t BlobStream::size() const{
+	return (blob_ptr_ == nullptr) ? 0u : static_cast<size_t>(sqlite3_blob_bytes(blob_ptr_));
+    }
+
+    //---------------------------------------------------------
+    int32_t BlobStream::read(const size_t& offset, uint8_t* buff, const size_t& size,
+	    std::string& err_msg){
+	err_msg.clear();
+	if(blob_ptr_ == nullptr){
+	    err_msg = "BLOB is not opened";
+	    return SQLITE_MISUSE;
+	}
+	int32_t ret = sqlite3_blob_read(blob_ptr_, buff,
+		static_cast<int>(size), static_cast<int>(offset));
+	if(ret != SQLITE_OK){
+	    err_msg = sqlite3_errmsg(db_ptr_);
+	}
+	return ret;
+    }
+
+    //---------------------------------------------------------
+    int32_t BlobStream::read(const size_t& offset, const size_t& size, Binary_t& buff,
+	    std::string& err_msg){
+	size_t total = this->size();
+	size_t n = (offset >= total) ? 0u : std::min(size, total - offset);
+	buff.resize(n);
+	if(n == 0u){
+	    err_msg.clear();
+	    return (blob_ptr_ == nullptr) ? SQLITE_MISUSE : SQLITE_OK;
+	}
+	return read(offset, buff.data(), n, err_msg);
+    }
+
+    //---------------------------------------------------------
+    int32_t BlobStream::write(const size_t& offset, const uint8_t* buff, const size_t& size,
+	    std::string& err_msg){
+	err_msg.clear();
+	if(blob_ptr_ == nullptr){
+	    err_msg = "BLOB is not opened";
+	    return SQLITE_MISUSE;
+	}
+	int32_t ret = sqlite3_blob_write(blob_ptr_, buff,
+		static_cast<int>(size), static_cast<int>(offset));
+	if(ret != SQLITE_OK){
+	    err_msg = sqlite3_errmsg(db_ptr_);
+	}
+	else if(fetcher_ != nullptr){
+	    fetcher_->noteBlobWrite(table_name_, rowid_);
+	}
+	return ret;
+    }
+
+    //---------------------------------------------------------
+    int32_t BlobStream::reopen(const int64_t& rowid, std::string& err_msg){
+	err_msg.clear();
+	if(blob_ptr_ == nullptr){
+	    err_msg = "BLOB is not opened";
+	    return SQLITE_MISUSE;
+	}
+	int32_t ret = sqlite3_blob_reopen(blob_ptr_, rowid);
+	if(ret != SQLITE_OK){
+	    err_msg = sqlite3_errmsg(db_ptr_);
+	}
+	else{
+	    rowid_ = rowid;
+	}
+	return ret;
+    }
+
+    //---------------------------------------------------------
+    int32_t BlobStream::close(){
+	int32_t ret = SQLITE_OK;
+	if(blob_ptr_ != nullptr){
+	    ret = sqlite3_blob_close(blob_ptr_);
+	    blob_ptr_ = nullptr;
+	    //a write out of transactions is committed by closing
+	    if(fetcher_ != nullptr){
+		fetcher_->blob_streams_.erase(this);
+		fetcher_->publishChanges();
+	    }
+	}
+	fetcher_ = nullptr;
+	return ret;
+    }
+
+    //########################################################################
+    // Fetcher
+    // Constructor
+    Fetcher::Fetcher(){}
+
+    //-------------------------------------------------------------------
+    // Constructor. Open database.
+    Fetcher::Fetcher(const std::string& db_name){
+       int32_t retval = sqlite3_open(db_name.c_str(), &db_ptr_);
+       if(retval != SQLITE_OK){
+	   last_err_ = sqlite3_errstr(retval);
+       }
+       else{
+	   is_opened_ = true;
+	   refreshSchema(last_err_);
+       }
+    } 
+
+    //-------------------------------------------------------------------
+    Fetcher::~Fetcher(){
+	if(is_opened_){
+	    close(last_err_);
+	}
+    }
+
+    //-------------------------------------------------------------------
+    // Open database.
+    int32_t Fetcher::open(const std::string& db_name, std::string& err_msg,
+	    const int32_t& flags, const char* zVfs){
+       int32_t retval 
+	   = sqlite3_open_v2(db_name.c_str(), &db_ptr_, flags, zVfs);
+       err_msg.clear();
+       if(retval != SQLITE_OK){
+	   this->last_err_ = sqlite3_errstr(retval);
+	   err_msg = this->last_err_;
+       }
+       else{
+	   this->is_opened_ = true;
+	   applyBusyPolicy();
+	   refreshSchema(last_err_);
+       }
+       return retval;
+    }
+
+    //-------------------------------------------------------------------
+    // Open an in-memory read replica of a database.
+    int32_t Fetcher::openReplica(const std::string& db_name, std::string& err_msg,
+	    const int32_t& refresh_ms){
+	err_msg.clear();
+	int32_t ret = sqlite3_open_v2(db_name.c_str(), &replica_src_ptr_, SQLITE_OPEN_READONLY, nullptr);
+	if(ret == SQLITE_OK){
+	    ret = sqlite3_open(":memory:", &db_ptr_);
+	}
+	if(ret != SQLITE_OK){
+	    last_err_ = sqlite3_errstr(ret);
+	    err_msg = last_err_;
+	    sqlite3_close(replica_src_ptr_);
+	    replica_src_ptr_ = nullptr;
+	    sqlite3_close(db_ptr_);
+	    db_ptr_ = nullptr;
+	    return ret;
+	}
+	is_opened_ = true;
+	applyBusyPolicy();
+	replica_refresh_ms_ = refresh_ms;
+	ret = loadReplica(err_msg);
+	if(ret == SQLITE_OK){
+	    exec("PRAGMA query_only = ON;", err_msg);
+	    refreshSchema(last_err_);
+	}
+	return ret;
+    }
+
+    //-------------------------------------------------------------------
+    // Reload the in-memory replica if the database file is changed.
+    int32_t Fetcher::refreshReplica(std::string& err_msg, const bool& force){
+	err_msg.clear();
+	if(replica_src_ptr_ == nullptr){
+	    err_msg = "This is not a replica";
+	    return SQLITE_MISUSE;
+	}
+	replica_checked_ = std::chrono::steady_clock::now();
+	int64_t version = -1;
+	sqlite3_stmt* stmt = nullptr;
+	if(sqlite3_prepare_v2(replica_src_ptr_, "PRAGMA data_version;", -1, &stmt, nullptr) == SQLITE_OK
+		&& sqlite3_step(stmt) == SQLITE_ROW){
+	    version = sqlite3_column_int64(stmt, 0);
+	}
+	sqlite3_finalize(stmt);
+	if(!force && version == replica_version_){
+	    return SQLITE_OK;
+	}
+	int32_t ret = loadReplica(err_msg);
+	if(ret == SQLITE_OK){
+	    refreshSchema(last_err_);
+	}
+	return ret;
+    }
+
+    //-------------------------------------------------------------------
+    // Copy the database file into the in-memory database.
+    int32_t Fetcher::loadReplica(std::string& err_msg){
+	//The version is read in the same read transaction as the copy
+	sqlite3_exec(replica_src_ptr_, "BEGIN;", nullptr, nullptr, nullptr);
+	sqlite3_stmt* stmt = nullptr;
+	if(sqlite3_prepare_v2(replica_src_ptr_, "PRAGMA data_version;", -1, &stmt, nullptr) == SQLITE_OK
+		&& sqlite3_step(stmt) == SQLITE_ROW){
+	    replica_version_ = sqlite3_column_int64(stmt, 0);
+	}
+	sqlite3_finalize(stmt);
+	int32_t ret = SQLITE_ERROR;
+	sqlite3_backup* backup = sqlite3_backup_init(db_ptr_, "main", replica_src_ptr_, "main");
+	if(backup != nullptr){
+	    ret = sqlite3_backup_step(backup, -1);
+	    sqlite3_backup_finish(backup);
+	}
+	sqlite3_exec(replica_src_ptr_, "COMMIT;", nullptr, nullptr, nullptr);
+	replica_checked_ = std::chrono::steady_clock::now();
+	if(ret != SQLITE_DONE){
+	    err_msg = (backup == nullptr) ? sqlite3_errmsg(db_ptr_) : sqlite3_errstr(ret);
+	    return ret;
+	}
+	clearResultCache();
+	return SQLITE_OK;
+    }
+
+    //-------------------------------------------------------------------
+    // Reload the replica before a read if the interval has passed.
+    void Fetcher::syncReplica(){
+	if(replica_src_ptr_ == nullptr || replica_refresh_ms_ < 0){
+	    return;
+	}
+	if(replica_refresh_ms_ > 0 && std::chrono::steady_clock::now() - replica_checked_
+		< std::chrono::milliseconds(replica_refresh_ms_)){
+	    return;
+	}
+	refreshReplica(last_err_);
+    }
+
+    //-------------------------------------------------------------------
+    int32_t Fetcher::close(std::string err_msg){
+	err_msg = "";
+	cancelBackup();
+	//streams refer to this, so they are closed before it is gone
+	std::set<BlobStream*> blob_streams;
+	blob_streams.swap(blob_streams_);
+	for(auto i_blob = blob_streams.begin(); i_blob != blob_streams.end(); ++i_blob){
+	    (*i_blob)->close();
+	}
+	finalizeStatements();
+	if(replica_src_ptr_ != nullptr){
+	    sqlite3_close(replica_src_ptr_);
+	    replica_src_ptr_ = nullptr;
+	}
+	int32_t retval 
+	    = sqlite3_close(db_ptr_);
+	if(retval != SQLITE_OK){
+	    this->last_err_ = sqlite3_errstr(retval);
+	    err_msg = this->last_err_;
+	}
+	else{
+	    db_ptr_ = nullptr;
+	    is_opened_ = false;
+	    if(vtab_registry_){
+		vtab_registry_->clear();
+	    }
+	    schema_.reset();
+	    schema_slot_ = nullptr;
+	    temp_schema_version_ = -1;
+	    temp_tables_.clear();
+	    declared_tables_.clear();
+	}
+	return retval;
+    }
+
+    //-------------------------------------------------------------------
+    // Get a prepared statement from the cache. It is reset and its bindings are cleared.
+    sqlite3_stmt* Fetcher::cachedStatement(const std::string& query, std::string& err_msg){
+	auto i_stmt = stmt_cache_.find(query);
+	if(i_stmt != stmt_cache_.end()){
+	    sqlite3_reset(i_stmt->second);
+	    sqlite3_clear_bindings(i_stmt->second);
+	    return i_stmt->second;
+	}
+	sqlite3_stmt* stmt = nullptr;
+	int32_t ret = sqlite3_prepare_v3(db_ptr_, query.c_str(), -1,
+		SQLITE_PREPARE_PERSISTENT, &stmt, nullptr);
+	if(ret != SQLITE_OK){
+	    err_msg = sqlite3_errmsg(db_ptr_);
+	    sqlite3_finalize(stmt);
+	    return nullptr;
+	}
+	stmt_cache_[query] = stmt;
+	return stmt;
+    }
+
+    //-------------------------------------------------------------------
+    void Fetcher::finalizeStatements(){
+	for(auto i_stmt = stmt_cache_.begin(); i_stmt != stmt_cache_.end(); ++i_stmt){
+	    sqlite3_finalize(i_stmt->second);
+	}
+	stmt_cache_.clear();
+    }
+
+    //-------------------------------------------------------------------
+    // Estimated memory of a cell in containers, besides its bytes.
+    static const size_t EXEC_CELL_BYTES = 2u*sizeof(std::string) + 32u;
+    static const size_t COLUMN_CELL_BYTES = sizeof(std::string) + sizeof(Data) + 32u;
+
+    //-------------------------------------------------------------------
+    // Estimated memory of a row of a statement.
+    static size_t rowBytes(sqlite3_stmt* stmt, const int32_t& n_col, const size_t& cell_bytes){
+	size_t ret = cell_bytes * static_cast<size_t>(n_col);
+	for(int32_t k=0; k<n_col; ++k){
+	    int32_t type = sqlite3_column_type(stmt, k);
+	    ret += (type == SQLITE_TEXT || type == SQLITE_BLOB)
+		? static_cast<size_t>(sqlite3_column_bytes(stmt, k)) : sizeof(int64_t);
+	}
+	return ret;
+    }
+
+    //-------------------------------------------------------------------
+    struct ExecContext_t{
+	ExecResult_t* res;
+	Fetcher* fetcher;
+    };
+
+    //-------------------------------------------------------------------
+    int Fetcher::execCallback(void* context_ptr, int argc, char** argv, char** col_name){
+	ExecContext_t* context = static_cast<ExecContext_t*>(context_ptr);
+	Result_t& result = context->res->result;
+	result.emplace_back();
+	ResultElement_t& a_res = result.back();
+	size_t bytes = EXEC_CELL_BYTES * static_cast<size_t>(argc);
+        for(int k=0; k<argc; ++k){
+	    if(argv[k] == nullptr || argv[k][0] == '\0'){
+		a_res[col_name[k]] = "";
+	    }
+	    else{
+		a_res[col_name[k]] = argv[k];
+		bytes += std::strlen(argv[k]);
+	    }
+	}
+	//non-zero stops the query
+	return context->fetcher->chargeResult(bytes) ? 0 : 1;
+    }
+
+    //-------------------------------------------------------------------
+    // Tables written by statements, collected by an authorizer.
+    struct WriteTargets_t{
+	Fetcher* fetcher{nullptr};
+	std::set<std::string> tables;
+	bool has_ddl{false};
+    };
+
+    //-------------------------------------------------------------------
+    int Fetcher::writeAuthorizer(void* targets_ptr, int action,
+	    const char* arg1, const char* arg2, const char*, const char*){
+	WriteTargets_t* targets = static_cast<WriteTargets_t*>(targets_ptr);
+	switch(action){
+	    //sqlite3_exec() prepares each statement right before running it.
+	    case SQLITE_SAVEPOINT:
+		if(targets->fetcher->feed_enabled_ && arg1 != nullptr && arg2 != nullptr){
+		    targets->fetcher->markSavepoint(arg1, arg2);
+		}
+		break;
+	    //WITHOUT ROWID tables and DELETE without WHERE don't call the update hook.
+	    case SQLITE_INSERT:
+	    case SQLITE_UPDATE:
+	    case SQLITE_DELETE:
+		if(arg1 != nullptr && std::strncmp(arg1, "sqlite_", 7u) != 0){
+		    targets->tables.insert(arg1);
+		}
+		break;
+	    case SQLITE_DROP_TABLE:
+	    case SQLITE_DROP_TEMP_TABLE:
+	    case SQLITE_DROP_VIEW:
+	    case SQLITE_DROP_TEMP_VIEW:
+	    case SQLITE_ALTER_TABLE:
+	    case SQLITE_ATTACH:
+	    case SQLITE_DETACH:
+		targets->has_ddl = true;
+		break;
+	    default:
+		break;
+	}
+	return SQLITE_OK;
+    }
+
+    //-------------------------------------------------------------------
+    static int readAuthorizer(void* tables_ptr, int action,
+	    const char* arg1, const char*, const char*, const char*){
+	if(action == SQLITE_READ && arg1 != nullptr){
+	    static_cast<std::set<std::string>*>(tables_ptr)->insert(arg1);
+	}
+	return SQLITE_OK;
+    }
+
+    //-------------------------------------------------------------------
+    void Fetcher::enableResultCache(const size_t& max_bytes){
+	cache_max_bytes_ = max_bytes;
+	if(!cache_enabled_){
+	    cache_enabled_ = true;
+	    data_version_ = -1;
+	    setHooks();
+	}
+	while(cache_stats_.bytes > cache_max_bytes_ && !cache_lru_.empty()){
+	    eraseCache(cache_lru_.back());
+	    ++cache_stats_.evictions;
+	}
+    }
+
+    //-------------------------------------------------------------------
+    void Fetcher::disableResultCache(){
+	cache_enabled_ = false;
+	setHooks();
+	clearResultCache();
+    }
+
+    //-------------------------------------------------------------------
+    void Fetcher::clearResultCache(){
+	cache_stats_.invalidations += cache_.size();
+	cache_.clear();
+	cache_lru_.clear();
+	cache_tables_.clear();
+	cache_stats_.entries = 0u;
+	cache_stats_.bytes = 0u;
+    }
+
+    //-------------------------------------------------------------------
+    CacheStats_t Fetcher::cacheStats() const{
+	return cache_stats_;
+    }
+
+    //-------------------------------------------------------------------
+    void Fetcher::setBusyPolicy(const BusyPolicy_t& policy){
+	busy_policy_ = policy;
+	busy_policy_.jitter = std::min(std::max(busy_policy_.jitter, 0.0), 1.0);
+	if(!busy_enabled_){
+	    busy_enabled_ = true;
+	    busy_rng_.seed(static_cast<uint32_t>(reinterpret_cast<uintptr_t>(this)
+			^ static_cast<uintptr_t>(std::chrono::steady_clock::now().time_since_epoch().count())));
+	}
+	applyBusyPolicy();
+    }
+
+    //-------------------------------------------------------------------
+    void Fetcher::clearBusyPolicy(){
+	busy_enabled_ = false;
+	if(db_ptr_ != nullptr){
+	    sqlite3_busy_handler(db_ptr_, nullptr, nullptr);
+	}
+	if(replica_src_ptr_ != nullptr){
+	    sqlite3_busy_handler(replica_src_ptr_, nullptr, nullptr);
+	}
+    }
+
+    //-------------------------------------------------------------------
+    BusyStats_t Fetcher::busyStats() const{
+	BusyStats_t stats;
+	stats.events = busy_events_.load();
+	stats.waits = busy_waits_.load();
+	stats.giveups = busy_giveups_.load();
+	stats.wait_us = busy_wait_us_.load();
+	stats.max_wait_us = busy_max_us_.load();
+	return stats;
+    }
+
+    //-------------------------------------------------------------------
+    void Fetcher::resetBusyStats(){
+	busy_events_ = 0u;
+	busy_waits_ = 0u;
+	busy_giveups_ = 0u;
+	busy_wait_us_ = 0u;
+	busy_max_us_ = 0u;
+    }
+
+    //-------------------------------------------------------------------
+    void Fetcher::setMemoryLimit(const MemoryLimit_t& limit){
+	memory_limit_ = limit;
+	if(limit.engine_soft_heap_bytes >= 0){
+	    sqlite3_soft_heap_limit64(limit.engine_soft_heap_bytes);
+	}
+    }
+
+    //-------------------------------------------------------------------
+    MemoryStats_t Fetcher::memoryStats() const{
+	MemoryStats_t stats = memory_stats_;
+	stats.engine_bytes = sqlite3_memory_used();
+	stats.engine_peak_bytes = sqlite3_memory_highwater(0);
+	return stats;
+    }
+
+    //-------------------------------------------------------------------
+    void Fetcher::resetMemoryStats(){
+	memory_stats_ = MemoryStats_t();
+	sqlite3_memory_highwater(1);
+    }
+
+    //-------------------------------------------------------------------
+    // Start to count memory of a result.
+    void Fetcher::beginResult(){
+	result_bytes_ = 0u;
+	result_warned_ = false;
+	result_aborted_ = false;
+    }
+
+    //-------------------------------------------------------------------
+    // Add memory of a row to the result. false if the result is beyond the hard limit.
+    bool Fetcher::chargeResult(const size_t& bytes){
+	result_bytes_ += bytes;
+	if(memory_limit_.hard_bytes != 0u && result_bytes_ > memory_limit_.hard_bytes){
+	    result_aborted_ = true;
+	    return false;
+	}
+	if(!result_warned_ && memory_limit_.soft_bytes != 0u && result_bytes_ > memory_limit_.soft_bytes){
+	    result_warned_ = true;
+	    ++memory_stats_.soft_exceeded;
+	    std::string msg = "A result exceeds the soft memory limit of "
+		+ std::to_string(memory_limit_.soft_bytes) + " bytes";
+	    if(memory_limit_.handler){
+		memory_limit_.handler(msg);
+	    }
+	    else{
+		std::cerr << "[SqliteFetcher] " << msg << std::endl;
+	    }
+	}
+	return true;
+    }
+
+    //-------------------------------------------------------------------
+    // Finish counting memory of a result.
+    // SQLITE_NOMEM with an error message if the result was stopped by the hard limit.
+    int32_t Fetcher::endResult(std::string& err_msg){
+	memory_stats_.last_result_bytes = result_bytes_;
+	memory_stats_.peak_result_bytes = std::max(memory_stats_.peak_result_bytes, result_bytes_);
+	if(!result_aborted_){
+	    return SQLITE_OK;
+	}
+	result_aborted_ = false;
+	++memory_stats_.hard_aborted;
+	err_msg = "A result exceeds the hard memory limit of "
+	    + std::to_string(memory_limit_.hard_bytes) + " bytes";
+	return SQLITE_NOMEM;
+    }
+
+    //-------------------------------------------------------------------
+    void Fetcher::applyBusyPolicy(){
+	if(!busy_enabled_){
+	    return;
+	}
+	if(db_ptr_ != nullptr){
+	    sqlite3_busy_handler(db_ptr_, &Fetcher::busyHandler, this);
+	}
+	if(replica_src_ptr_ != nullptr){
+	    sqlite3_busy_handler(replica_src_ptr_, &Fetcher::busyHandler, this);
+	}
+    }
+
+    //-------------------------------------------------------------------
+    // Called by SQLite when a lock is busy. count is the number of calls for the same lock.
+    // Returning 0 makes the query fail with SQLITE_BUSY.
+    int Fetcher::busyHandler(void* fetcher_ptr, int count){
+	Fetcher* fetcher = static_cast<Fetcher*>(fetcher_ptr);
+	const BusyPolicy_t& policy = fetcher->busy_policy_;
+	auto now = std::chrono::steady_clock::now();
+	if(count == 0){
+	    fetcher->busy_started_ = now;
+	    ++fetcher->busy_events_;
+	}
+	double elapsed_ms = std::chrono::duration<double, std::milli>(now - fetcher->busy_started_).count();
+	if((policy.max_attempts > 0 && count >= policy.max_attempts)
+		|| (policy.timeout_ms > 0 && elapsed_ms >= policy.timeout_ms)){
+	    ++fetcher->busy_giveups_;
+	    return 0;
+	}
+
+	double delay_ms = std::min(policy.initial_ms * std::pow(policy.multiplier, count), policy.max_backoff_ms);
+	std::uniform_real_distribution<double> uniform(1.0 - policy.jitter, 1.0);
+	delay_ms *= uniform(fetcher->busy_rng_);
+	if(policy.timeout_ms > 0){
+	    delay_ms = std::min(delay_ms, policy.timeout_ms - elapsed_ms);
+	}
+	std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(delay_ms));
+
+	auto waited = std::chrono::steady_clock::now();
+	++fetcher->busy_waits_;
+	fetcher->busy_wait_us_ += static_cast<uint64_t>(
+		std::chrono::duration_cast<std::chrono::microseconds>(waited - now).count());
+	uint64_t total_us = static_cast<uint64_t>(
+		std::chrono::duration_cast<std::chrono::microseconds>(waited - fetcher->busy_started_).count());
+	uint64_t max_us = fetcher->busy_max_us_.load();
+	while(total_us > max_us && !fetcher->busy_max_us_.compare_exchange_weak(max_us, total_us)){}
+	return 1;
+    }
+
+    //-------------------------------------------------------------------
+    // Estimate memory used by a column list.
+    static size_t estimateBytes(const ColumnList_t& rows){
+	//a node of std::map holds three pointers and a color besides the value.
+	const size_t node_bytes = sizeof(Column_t::value_type) + 4u*sizeof(void*);
+	size_t ret = sizeof(ColumnList_t) + rows.capacity()*sizeof(Column_t);
+	for(auto i_row = rows.begin(); i_row != rows.end(); ++i_row){
+	    for(auto i_elm = i_row->begin(); i_elm != i_row->end(); ++i_elm){
+		ret += node_bytes + i_elm->second.size();
+		if(i_elm->first.capacity() > 15u){
+		    ret += i_elm->first.capacity();
+		}
+	    }
+	}
+	return ret;
+    }
+
+    //-------------------------------------------------------------------
+    bool Fetcher::findCache(const std::string& key, ColumnList_t& rows, std::string& token){
+	//commits by other connections are told only by data_version
+	sqlite3_stmt* stmt = nullptr;
+	std::string err_msg;
+	stmt = cachedStatement("PRAGMA data_version;", err_msg);
+	if(stmt != nullptr && sqlite3_step(stmt) == SQLITE_ROW){
+	    int64_t version = sqlite3_column_int64(stmt, 0);
+	    if(version != data_version_){
+		clearResultCache();
+		data_version_ = version;
+	    }
+	}
+	if(stmt != nullptr){
+	    sqlite3_reset(stmt);
+	}
+
+	auto i_entry = cache_.find(key);
+	if(i_entry == cache_.end()){
+	    ++cache_stats_.misses;
+	    return false;
+	}
+	cache_lru_.splice(cache_lru_.begin(), cache_lru_, i_entry->second.i_lru);
+	rows = i_entry->second.rows;
+	token = i_entry->second.token;
+	++cache_stats_.hits;
+	return true;
+    }
+
+    //-------------------------------------------------------------------
+    void Fetcher::addCache(const std::string& key, const std::string& query,
+	    const ColumnList_t& rows, const std::string& token){
+	//rows read in a transaction may be undone by a rollback, which no hook tells.
+	if(sqlite3_get_autocommit(db_ptr_) == 0){
+	    return;
+	}
+	CacheEntry_t entry;
+	entry.bytes = estimateBytes(rows) + key.capacity() + token.capacity();
+	if(entry.bytes > cache_max_bytes_){
+	    return;
+	}
+
+	//tables read by the query are reported to the authorizer in preparing it.
+	sqlite3_stmt* stmt = nullptr;
+	sqlite3_set_authorizer(db_ptr_, readAuthorizer, &entry.tables);
+	int32_t ret = sqlite3_prepare_v2(db_ptr_, query.c_str(), -1, &stmt, nullptr);
+	sqlite3_set_authorizer(db_ptr_, nullptr, nullptr);
+	bool is_readonly = (ret == SQLITE_OK && stmt != nullptr && sqlite3_stmt_readonly(stmt) != 0);
+	sqlite3_finalize(stmt);
+	if(!is_readonly){
+	    return;
+	}
+
+	eraseCache(key);
+	while(cache_stats_.bytes + entry.bytes > cache_max_bytes_ && !cache_lru_.empty()){
+	    eraseCache(cache_lru_.back());
+	    ++cache_stats_.evictions;
+	}
+	entry.rows = rows;
+	entry.token = token;
+	cache_lru_.push_front(key);
+	entry.i_lru = cache_lru_.begin();
+	for(auto i_tbl = entry.tables.begin(); i_tbl != entry.tables.end(); ++i_tbl){
+	    cache_tables_[*i_tbl].insert(key);
+	}
+	cache_stats_.bytes += entry.bytes;
+	cache_[key] = std::move(entry);
+	cache_stats_.entries = cache_.size();
+    }
+
+    //-------------------------------------------------------------------
+    void Fetcher::eraseCache(const std::string& key){
+	auto i_entry = cache_.find(key);
+	if(i_entry == cache_.end()){
+	    return;
+	}
+	for(auto i_tbl = i_entry->second.tables.begin(); i_tbl != i_entry->second.tables.end(); ++i_tbl){
+	    auto i_keys = cache_tables_.find(*i_tbl);
+	    if(i_keys != cache_tables_.end()){
+		i_keys->second.erase(key);
+		if(i_keys->second.empty()){
+		    cache_tables_.erase(i_keys);
+		}
+	    }
+	}
+	cache_stats_.bytes -= i_entry->second.bytes;
+	cache_lru_.erase(i_entry->second.i_lru);
+	cache_.erase(i_entry);
+	cache_stats_.entries = cache_.size();
+    }
+
+    //-------------------------------------------------------------------
+    void Fetcher::invalidateTable(const std::string& table_name){
+	auto i_keys = cache_tables_.find(table_name);
+	if(i_keys == cache_tables_.end()){
+	    return;
+	}
+	std::set<std::string> keys = i_keys->second;
+	for(auto i_key = keys.begin(); i_key != keys.end(); ++i_key){
+	    eraseCache(*i_key);
+	    ++cache_stats_.invalidations;
+	}
+    }
+
+    //-------------------------------------------------------------------
+    void Fetcher::updateHook(void* fetcher_ptr, int op,
+	    const char* db_name, const char* table_name, sqlite3_int64 rowid){
+	Fetcher* fetcher = static_cast<Fetcher*>(fetcher_ptr);
+	if(fetcher->cache_enabled_){
+	    fetcher->invalidateTable(table_name);
+	}
+	if(fetcher->feed_enabled_){
+	    ChangeEvent_t event;
+	    event.table = table_name;
+	    event.op = (op == SQLITE_INSERT) ? OP_INSERT :
+		((op == SQLITE_UPDATE) ? OP_UPDATE : OP_DELETE);
+	    event.rowid = rowid;
+	    fetcher->pending_changes_.push_back(std::move(event));
+	}
+	(void)db_name;
+    }
+
+    //-------------------------------------------------------------------
+    void Fetcher::markSavepoint(const char* op, const char* name){
+	//Savepoint names are case-insensitive and may be shadowed.
+	auto i_mark = savepoints_.rbegin();
+	while(i_mark != savepoints_.rend() && sqlite3_stricmp(i_mark->name.c_str(), name) != 0){
+	    ++i_mark;
+	}
+	if(std::strcmp(op, "BEGIN") == 0){
+	    savepoints_.push_back(SavepointMark_t{name, pending_changes_.size()});
+	}
+	else if(i_mark == savepoints_.rend()){
+	    return;
+	}
+	else if(std::strcmp(op, "RELEASE") == 0){
+	    savepoints_.erase(std::next(i_mark).base(), savepoints_.end());
+	}
+	else if(std::strcmp(op, "ROLLBACK") == 0){
+	    //ROLLBACK TO keeps the savepoint itself open.
+	    pending_changes_.resize(i_mark->n_changes);
+	    savepoints_.erase(i_mark.base(), savepoints_.end());
+	}
+    }
+
+    //-------------------------------------------------------------------
+    void Fetcher::noteBlobWrite(const std::string& table_name, const int64_t& rowid){
+	if(cache_enabled_){
+	    invalidateTable(table_name);
+	}
+	if(!feed_enabled_){
+	    return;
+	}
+	//writes of chunks of a row are told once
+	if(!pending_changes_.empty()){
+	    const ChangeEvent_t& last = pending_changes_.back();
+	    if(last.op == OP_UPDATE && last.rowid == rowid && last.table == table_name){
+		return;
+	    }
+	}
+	ChangeEvent_t event;
+	event.table = table_name;
+	event.op = OP_UPDATE;
+	event.rowid = rowid;
+	pending_changes_.push_back(std::move(event));
+    }
+
+    //-------------------------------------------------------------------
+    int Fetcher::commitHook(void* fetcher_ptr){
+	Fetcher* fetcher = static_cast<Fetcher*>(fetcher_ptr);
+	fetcher->savepoints_.clear();
+	//The hook is called before the commit, which may still fail with SQLITE_BUSY.
+	ChangeBatch_t& committing = fetcher->committing_changes_;
+	committing.insert(committing.end(), fetcher->pending_changes_.begin(),
+		fetcher->pending_changes_.end());
+	fetcher->pending_changes_.clear();
+	return 0;
+    }
+
+    //-------------------------------------------------------------------
+    void Fetcher::rollbackHook(void* fetcher_ptr){
+	Fetcher* fetcher = static_cast<Fetcher*>(fetcher_ptr);
+	fetcher->pending_changes_.clear();
+	fetcher->committing_changes_.clear();
+	fetcher->savepoints_.clear();
+    }
+
+    //-------------------------------------------------------------------
+    void Fetcher::publishChanges(){
+	//the commit is done when the connection is back in autocommit mode
+	if(!committing_changes_.empty() && sqlite3_get_autocommit(db_ptr_) != 0){
+	    //Batches which couldn't be queued are carried to keep the order.
+	    if(carried_changes_.empty()){
+		carried_changes_.swap(committing_changes_);
+	    }
+	    else{
+		carried_changes_.insert(carried_changes_.end(), committing_changes_.begin(),
+			committing_changes_.end());
+		committing_changes_.clear();
+	    }
+	}
+	if(!carried_changes_.empty() && committed_changes_.push(std::move(carried_changes_))){
+	    carried_changes_.clear();
+	}
+	if(auto_dispatch_){
+	    dispatchChanges();
+	}
+    }
+
+    //-------------------------------------------------------------------
+    void Fetcher::setHooks(){
+	bool has_subscribers = false;
+	{
+	    std::lock_guard<std::mutex> lock(change_mtx_);
+	    has_subscribers = !change_handlers_.empty();
+	}
+	feed_enabled_ = has_subscribers;
+	if(cache_enabled_ || has_subscribers){
+	    sqlite3_update_hook(db_ptr_, updateHook, this);
+	}
+	else{
+	    sqlite3_update_hook(db_ptr_, nullptr, nullptr);
+	}
+	sqlite3_commit_hook(db_ptr_, has_subscribers ? commitHook : nullptr,
+		has_subscribers ? this : nullptr);
+	sqlite3_rollback_hook(db_ptr_, has_subscribers ? rollbackHook : nullptr,
+		has_subscribers ? this : nullptr);
+    }
+
+    //-------------------------------------------------------------------
+    int32_t Fetcher::subscribeChanges(ChangeHandler_t handler){
+	int32_t id = 0;
+	{
+	    std::lock_guard<std::mutex> lock(change_mtx_);
+	    id = next_change_id_++;
+	    change_handlers_[id] = handler;
+	}
+	setHooks();
+	return id;
+    }
+
+    //-------------------------------------------------------------------
+    void Fetcher::unsubscribeChanges(const int32_t& id){
+	{
+	    std::lock_guard<std::mutex> lock(change_mtx_);
+	    change_handlers_.erase(id);
+	}
+	setHooks();
+    }
+
+    //-------------------------------------------------------------------
+    size_t Fetcher::dispatchChanges(){
+	size_t n_batches = 0u;
+	ChangeBatch_t batch;
+	while(committed_changes_.pop(batch)){
+	    //Handlers may subscribe or unsubscribe, so they are called unlocked.
+	    std::vector<ChangeHandler_t> handlers;
+	    {
+		std::lock_guard<std::mutex> lock(change_mtx_);
+		handlers.reserve(change_handlers_.size());
+		for(auto i_handler = change_handlers_.begin(); i_handler != change_handlers_.end(); ++i_handler){
+		    handlers.push_back(i_handler->second);
+		}
+	    }
+	    for(auto i_handler = handlers.begin(); i_handler != handlers.end(); ++i_handler){
+		(*i_handler)(batch);
+	    }
+	    ++n_batches;
+	}
+	return n_batches;
+    }
+
+    //-------------------------------------------------------------------
+    void Fetcher::setChangeDispatch(const bool& automatic){
+	auto_dispatch_ = automatic;
+    }
+
+    //-------------------------------------------------------------------
+    // Execute SQLite query
+    ExecResult_t Fetcher::exec(const std::string& query, std::string& err_msg){
+	ExecResult_t ret;
+	exec(query, ret, err_msg);
+	return ret;
+    }
+
+    //-------------------------------------------------------------------
+    // Execute SQLite query and put the result into a given container.
+    int32_t Fetcher::exec(const std::string& query, ExecResult_t& res, std::string& err_msg){
+	err_msg.clear();
+	syncReplica();
+	if(warn_scan_){
+	    warnScan(query);
+	}
+	char *err_char = 0;
+	res.in_sql = query;
+	res.result.clear();
+	//Some writes and DDL don't call the update hook.
+	WriteTargets_t targets;
+	targets.fetcher = this;
+	const bool is_authorized = cache_enabled_ || feed_enabled_;
+	if(is_authorized){
+	    sqlite3_set_authorizer(db_ptr_, writeAuthorizer, &targets);
+	}
+	ExecContext_t context{&res, this};
+	beginResult();
+        int32_t ret = sqlite3_exec(db_ptr_, query.c_str(), 
+		&Fetcher::execCallback, &context, &err_char);
+	if(is_authorized){
+	    sqlite3_set_authorizer(db_ptr_, nullptr, nullptr);
+	}
+	if(cache_enabled_){
+	    if(targets.has_ddl){
+		clearResultCache();
+	    }
+	    for(auto i_tbl = targets.tables.begin(); i_tbl != targets.tables.end(); ++i_tbl){
+		invalidateTable(*i_tbl);
+	    }
+	}
+	if(ret != SQLITE_OK){
+	    err_msg = (err_char != nullptr) ? err_char : sqlite3_errstr(ret);
+	    sqlite3_free(err_char);
+	}
+	if(endResult(err_msg) != SQLITE_OK){
+	    res.result.clear();
+	    ret = SQLITE_NOMEM;
+	}
+	publishChanges();
+
+	if(to_info_update_){
+	    to_info_update_ = false;
+	    refreshSchema(last_err_);
+	}
+	return ret;
+    }
+
+    //-------------------------------------------------------------------
+    // Execute SQLite query
+    std::list<ExecResult_t> Fetcher::execSeparate(const std::string& query, std::string& err_msg){
+	err_msg.clear();
+	std::list<ExecResult_t> ret_list;
+	size_t i_begin = 0u;
+	size_t i_dlm = 0u;
+	while(i_begin < query.size()){
+	    i_dlm = query.find(";",i_begin);
+	    if(i_dlm == std::string::npos){
+		i_dlm=query.size()-1u;
+	    }
+	    auto a_query = query.substr(i_begin,i_dlm-i_begin);
+	    ret_list.emplace_back();
+	    exec(a_query, ret_list.back(), err_msg);
+	    if(!err_msg.empty()){
+		ret_list.pop_back();
+		break;
+	    }
+	    i_begin = i_dlm+1u;
+	}
+	return ret_list;
+    }
+
+    //-------------------------------------------------------------------
+    // Dump result of exec function into string.
+    std::string Fetcher::dump(const ExecResult_t& res) const{
+	std::string ret = "{\"Input\":\"" + res.in_sql + "\",\n";
+	auto i_res = res.result.begin();
+	auto i_res_end = res.result.end();
+	ret += "\"results\":[";
+	bool is_first1 = false;
+	for(;i_res != i_res_end; ++i_res){
+	    if(!is_first1){
+		ret += ",\n ";
+	    }else{
+		is_first1 = false;
+	    }
+	    ret += "{";
+	    auto i_elem = i_res->begin();
+	    auto i_elem_end = i_res->end();
+	    bool is_first = true;
+	    for(;i_elem != i_elem_end; ++i_elem){
+		if(!is_first){
+		    ret += ", ";
+		}else{
+		    is_first = false;
+		}
+		ret += "\"" + i_elem->first + "\":\"" + i_elem->second + "\"";
+	    }
+	    ret += "}";
+	}
+	ret += "]}\n";
+	return ret;
+    }
+
+    //-------------------------------------------------------------------
+    //! Dump result of exec function into string.
+    std::string Fetcher::dump(const std::list<ExecResult_t>& res_list) const{
+	auto i_res_end = res_list.end();
+	std::string ret = "{\"exec_result\": [";
+	bool is_first=true;
+	for(auto i_res =res_list.begin(); i_res != i_res_end; ++i_res){
+	    if(!is_first){
 		ret += ",";
 	    }
 	    else{
-		is_first = false;
+		is_first = false;
+	    }
+	    ret += dump(*i_res);
+	}
+	ret += "]}\n";
+	return ret;
+    }
+
+    //-------------------------------------------------------------------
+    bool Fetcher::inTransaction() const{
+	return db_ptr_ != nullptr && sqlite3_get_autocommit(db_ptr_) == 0;
+    }
+
+    //-------------------------------------------------------------------
+    // Fetch column list from result of executed query for SELECT.
+    ColumnList_t Fetcher::fetchColumn(const std::string& query, std::string& err_msg){
+	ColumnList_t col;
+	fetchColumn(query, col, err_msg);
+	return col;
+    }
+
+    //-------------------------------------------------------------------
+    // Fetch column list into a given container.
+    void Fetcher::fetchColumn(const std::string& query, ColumnList_t& col, std::string& err_msg){
+	err_msg.clear();
+	syncReplica();
+	if(!cache_enabled_){
+	    fetchColumnUncached(query, col, err_msg);
+	    return;
+	}
+	std::string token;
+	if(findCache(query, col, token)){
+	    return;
+	}
+	fetchColumnUncached(query, col, err_msg);
+	if(err_msg.empty()){
+	    addCache(query, query, col, token);
+	}
+    }
+
+    //-------------------------------------------------------------------
+    // TEXT values of COMPRESSED columns may be BLOBs, which are cut at NUL as text.
+    static bool isCompressedText(const Data& data){
+	return data.type() == TEXT && (data.flags() & COMPRESSED) != 0u;
+    }
+
+    //-------------------------------------------------------------------
+    void Fetcher::fetchColumnUncached(const std::string& query, ColumnList_t& col, std::string& err_msg){
+	col.clear();
+	err_msg.clear();
+	
+	//separate query by white space
+	std::istringstream iss(query);
+	std::vector<std::string> words;
+	std::string a_word;
+	while (iss >> a_word) {
+	    //delete comma
+	    size_t comma_pos = a_word.find(",");
+	    if(comma_pos != std::string::npos){
+		a_word.erase(comma_pos,1);
+	    }
+	    size_t colon_pos = a_word.find(";");
+	    if(colon_pos != std::string::npos){
+		a_word.erase(colon_pos,1);
+	    }
+	    words.push_back(a_word);
+	}
+
+	//get table name from query
+	auto i_select = std::find_if(words.begin(),words.end(),
+		[](const std::string w){ return ( w == "select" || w == "SELECT");});
+	if(i_select == words.end()){
+	    err_msg = "Query doen't include 'FROM' statement";
+	    return;
+	}
+	//get table name from query
+	auto i_from = std::find_if(words.begin(),words.end(),
+		[](const std::string w){ return ( w == "from" || w == "FROM");});
+	if(i_from == words.end()){
+	    err_msg = "Query doen't include 'FROM' statement";
+	    return;
+	}
+
+	if(std::next(i_from) != words.end() && std::next(i_from)->compare(0u, 1u, "(") == 0){
+	    //types of a subquery are taken from the statement
+	    fetchColumnByStatement(query, col, err_msg);
+	    return;
+	}
+
+	const Column_t* table_info = findTableInfo(*std::next(i_from));
+	if(table_info == nullptr && refreshSchema(last_err_) == SQLITE_OK){
+	    //the table may be made by other connections or by raw queries
+	    table_info = findTableInfo(*std::next(i_from));
+	}
+	if(table_info == nullptr){
+	    err_msg = "No such a table: " + *std::next(i_from);
+	    return;
+	}
+
+	const Column_t& table_col = *table_info;
+
+	//if all rows are selected
+	auto i_all = std::find_if(i_select, i_from,
+		[](const std::string w){ return  w == "*";});
+
+	//create new query to quate BLOB data
+	std::string new_query = "";
+	for(auto i_word=words.begin(); i_word != std::next(i_select); ++i_word){
+	    new_query += *i_word + " ";
+	}
+
+	bool is_changed = false;
+	if(i_all != i_from){
+	    auto i_col_end = table_col.end();
+	    for(auto i_col = table_col.begin(); i_col != i_col_end; ++i_col){
+		if(i_col->second.type() == BLOB){
+		    new_query += "quote(" + i_col->first + ")";
+		    is_changed = true;
+		}
+		else if(isCompressedText(i_col->second)){
+		    new_query += "quote(CAST(" + i_col->first + " AS BLOB))";
+		    is_changed = true;
+		}
+		else{
+		    new_query += i_col->first;
+		}
+
+		if(std::next(i_col) != i_col_end){
+		    new_query += ", ";
+		}
+	    }
+	}
+	//If specific rows are selected
+	else{
+	    for(auto i_word=std::next(i_select); i_word != i_from; ++i_word){
+		auto i_row = table_col.find(*i_word);
+		if(i_row != table_col.end()){
+		    if(i_row->second.type() == BLOB){
+			new_query += "quote(" + i_row->first + ")";
+			is_changed = true;
+		    }
+		    else if(isCompressedText(i_row->second)){
+			new_query += "quote(CAST(" + i_row->first + " AS BLOB))";
+			is_changed = true;
+		    }
+		    else{
+			new_query += i_row->first;
+		    }
+
+		    if(std::next(i_word) != i_from){
+			new_query += ", ";
+		    }
+		}
+		else{
+		    err_msg = "Coudn't find " + i_row->first + " in table " +  *std::next(i_from);
+		    return;
+		}
+	    }
+	}
+
+	if(!is_changed){
+	    new_query = query;
+	}
+	else{
+	    //add rest of queries
+	    auto i_words_end = words.end();
+	    for(auto i_word = i_from; i_word != i_words_end; ++i_word){
+		new_query += " " + *i_word;
+	    }
+	}
+	new_query += ";";
+
+	ExecResult_t res;
+	exec(new_query, res, err_msg);
+	if(!err_msg.empty()){
+	    return;
+	}
+	
+	col.reserve(res.result.size());
+	auto i_res_end = res.result.end();
+	for(auto i_res = res.result.begin(); i_res != i_res_end; ++i_res){
+	    auto i_elm_end = i_res->end();
+	    Column_t a_col;
+	    for(auto i_elm = i_res->begin(); i_elm != i_elm_end; ++i_elm){
+		//remove quote()
+		std::string keyword;
+		bool is_text_hex = false;
+		if(i_elm->first.compare(0u, 11u, "quote(CAST(") == 0){
+		    keyword = i_elm->first.substr(11u, i_elm->first.length()-21u);
+		    is_text_hex = true;
+		}
+		else if(i_elm->first.find("quote(") != std::string::npos){
+		    keyword = i_elm->first.substr(6u,i_elm->first.length()-7u);
+		}
+		else{
+		    keyword = i_elm->first;
+		}
+		auto i_data = table_col.find(keyword);
+		if(i_data == table_col.end()){
+		    err_msg = "Coudn't find " + keyword + " in table " +  *std::next(i_from);
+		}
+		if(is_text_hex){
+		    Data& value = a_col[keyword];
+		    value = Data(TEXT, i_data->second.flags());
+		    if(i_elm->second != "NULL"){
+			Binary_t bytes;
+			literal::decodeHex(i_elm->second, bytes);
+			value.set(std::string(bytes.begin(), bytes.end()));
+		    }
+		    continue;
+		}
+		a_col[keyword] = Data(i_elm->second, 
+			i_data->second.typeStr(), i_data->second.flags());
+	    }
+	    //release the converted row early to keep the peak memory low
+	    i_res->clear();
+	    col.push_back(std::move(a_col));
+	}
+    }
+
+    //-------------------------------------------------------------------
+    // Classify a step of a query plan by its detail.
+    static void classifyPlanNode(PlanNode_t& node){
+	if(node.detail.find("USE TEMP B-TREE") != std::string::npos){
+	    node.uses_temp_btree = true;
+	}
+	//full scan is shown like "SCAN user" or "SCAN TABLE user" in old versions.
+	std::istringstream iss(node.detail);
+	std::string a_word;
+	iss >> a_word;
+	if(a_word != "SCAN"){
+	    return;
+	}
+	iss >> a_word;
+	if(a_word == "TABLE"){
+	    iss >> a_word;
+	}
+	if(a_word.empty() || a_word == "CONSTANT" || a_word == "SUBQUERY"
+		|| a_word == "CTE" || a_word[0] == '('){
+	    return;
+	}
+	node.table = a_word;
+	node.is_full_scan = true;
+    }
+
+    //-------------------------------------------------------------------
+    // Form flat plan steps into a tree.
+    static std::vector<PlanNode_t> buildPlanTree(const std::vector<PlanNode_t>& flat,
+	    const int32_t& parent){
+	std::vector<PlanNode_t> ret;
+	auto i_node_end = flat.end();
+	for(auto i_node = flat.begin(); i_node != i_node_end; ++i_node){
+	    if(i_node->parent == parent){
+		ret.push_back(*i_node);
+		ret.back().children = buildPlanTree(flat, i_node->id);
+	    }
+	}
+	return ret;
+    }
+
+    //-------------------------------------------------------------------
+    // Get the query plan of a query.
+    QueryPlan_t Fetcher::explain(const std::string& query, std::string& err_msg){
+	err_msg.clear();
+	QueryPlan_t plan;
+	plan.in_sql = query;
+
+	std::string eqp_query = "EXPLAIN QUERY PLAN " + query;
+	sqlite3_stmt* stmt = nullptr;
+	int32_t ret = sqlite3_prepare_v2(db_ptr_, eqp_query.c_str(), -1, &stmt, nullptr);
+	if(ret != SQLITE_OK){
+	    err_msg = sqlite3_errmsg(db_ptr_);
+	    sqlite3_finalize(stmt);
+	    return plan;
+	}
+
+	std::vector<PlanNode_t> flat;
+	while((ret = sqlite3_step(stmt)) == SQLITE_ROW){
+	    PlanNode_t node;
+	    node.id = sqlite3_column_int(stmt, 0);
+	    node.parent = sqlite3_column_int(stmt, 1);
+	    const unsigned char* detail = sqlite3_column_text(stmt, 3);
+	    if(detail != nullptr){
+		node.detail = reinterpret_cast<const char*>(detail);
+	    }
+	    classifyPlanNode(node);
+	    if(node.is_full_scan){
+		plan.has_full_scan = true;
+		if(std::find(plan.scanned_tables.begin(), plan.scanned_tables.end(),
+			    node.table) == plan.scanned_tables.end()){
+		    plan.scanned_tables.push_back(node.table);
+		}
+	    }
+	    if(node.uses_temp_btree){
+		plan.has_temp_btree = true;
+	    }
+	    flat.push_back(node);
+	}
+	if(ret != SQLITE_DONE){
+	    err_msg = sqlite3_errmsg(db_ptr_);
+	}
+	sqlite3_finalize(stmt);
+
+	plan.nodes = buildPlanTree(flat, 0);
+	return plan;
+    }
+
+    //-------------------------------------------------------------------
+    void Fetcher::enableScanWarning(const int64_t& row_threshold,
+	    WarningHandler_t handler){
+	warn_scan_ = true;
+	scan_row_threshold_ = row_threshold;
+	warning_handler_ = handler;
+    }
+
+    //-------------------------------------------------------------------
+    void Fetcher::disableScanWarning(){
+	warn_scan_ = false;
+    }
+
+    //-------------------------------------------------------------------
+    // Warn if statements in the query scan large tables.
+    void Fetcher::warnScan(const std::string& query){
+	const char* head = query.c_str();
+	const char* tail = nullptr;
+	while(head != nullptr && *head != '\0'){
+	    //prepare only to know where the next statement begins
+	    sqlite3_stmt* stmt = nullptr;
+	    if(sqlite3_prepare_v2(db_ptr_, head, -1, &stmt, &tail) != SQLITE_OK){
+		sqlite3_finalize(stmt);
+		return;
+	    }
+	    sqlite3_finalize(stmt);
+	    std::string a_query(head, tail - head);
+	    head = tail;
+	    if(stmt == nullptr){
+		continue;
+	    }
+
+	    std::string err_msg;
+	    QueryPlan_t plan = explain(a_query, err_msg);
+	    auto i_tbl_end = plan.scanned_tables.end();
+	    for(auto i_tbl = plan.scanned_tables.begin(); i_tbl != i_tbl_end; ++i_tbl){
+		if(i_tbl->compare(0u, 7u, "sqlite_") == 0){
+		    continue;
+		}
+		sqlite3_stmt* cnt_stmt = nullptr;
+		std::string cnt_query = "SELECT COUNT(*) FROM \"" + *i_tbl + "\";";
+		int64_t n_rows = 0;
+		if(sqlite3_prepare_v2(db_ptr_, cnt_query.c_str(), -1, &cnt_stmt, nullptr) == SQLITE_OK
+			&& sqlite3_step(cnt_stmt) == SQLITE_ROW){
+		    n_rows = sqlite3_column_int64(cnt_stmt, 0);
+		}
+		sqlite3_finalize(cnt_stmt);
+		if(n_rows > scan_row_threshold_){
+		    std::string msg = "Full scan of table " + *i_tbl
+			+ " (" + std::to_string(n_rows) + " rows) in query: " + a_query;
+		    if(warning_handler_){
+			warning_handler_(msg);
+		    }
+		    else{
+			std::cerr << "[SqliteFetcher] " << msg << std::endl;
+		    }
+		}
+	    }
+	}
+    }
+
+    //-------------------------------------------------------------------
+    // Types of columns of a statement. NONE means the type of each value is used.
+    static std::vector<Type_t> columnTypes(sqlite3_stmt* stmt){
+	int32_t n_col = sqlite3_column_count(stmt);
+	std::vector<Type_t> types(n_col, NONE);
+	for(int32_t k=0; k<n_col; ++k){
+	    const char* decl = sqlite3_column_decltype(stmt, k);
+	    if(decl != nullptr && decl[0] != '\0'){
+		types[k] = declToType(decl);
+	    }
+	}
+	return types;
+    }
+
+    //-------------------------------------------------------------------
+    // Read a value of a statement into Data.
+    static Data columnData(sqlite3_stmt* stmt, const int32_t& k, const Type_t& type,
+	    const KeyFlag_t& flg){
+	Data ret(type, flg);
+	if(sqlite3_column_type(stmt, k) == SQLITE_NULL){
+	    return ret;
+	}
+	switch(type){
+	    case NONE:
+		break;
+	    case INT8:
+		ret.set(static_cast<int8_t>(sqlite3_column_int64(stmt, k)));
+		break;
+	    case INT16:
+		ret.set(static_cast<int16_t>(sqlite3_column_int64(stmt, k)));
+		break;
+	    case INT32:
+		ret.set(static_cast<int32_t>(sqlite3_column_int64(stmt, k)));
+		break;
+	    case INT64:
+		ret.set(static_cast<int64_t>(sqlite3_column_int64(stmt, k)));
+		break;
+	    case UINT64:
+		ret.set(static_cast<uint64_t>(sqlite3_column_int64(stmt, k)));
+		break;
+	    case FLOAT:
+		ret.set(static_cast<float>(sqlite3_column_double(stmt, k)));
+		break;
+	    case DOUBLE:
+		ret.set(sqlite3_column_double(stmt, k));
+		break;
+	    case BOOL:
+		ret.set(sqlite3_column_int64(stmt, k) != 0);
+		break;
+	    case TEXT:{
+			  const char* text = reinterpret_cast<const char*>(sqlite3_column_text(stmt, k));
+			  ret.set(std::string(text, sqlite3_column_bytes(stmt, k)));
+			  break;
+		      }
+	    case BLOB:{
+			  const uint8_t* blob = static_cast<const uint8_t*>(sqlite3_column_blob(stmt, k));
+			  ret.set(Binary_t(blob, blob + sqlite3_column_bytes(stmt, k)));
+			  break;
+		      }
+	}
+	return ret;
+    }
+
+    //-------------------------------------------------------------------
+    // Bind a value of Data to a statement.
+    static int32_t bindData(sqlite3_stmt* stmt, const int32_t& idx, const Data& data){
+	if(data.size() == 0u && data.type() != TEXT && data.type() != BLOB){
+	    return sqlite3_bind_null(stmt, idx);
+	}
+	switch(data.type()){
+	    case NONE:
+		return sqlite3_bind_null(stmt, idx);
+	    case INT8:{ int8_t v = 0; data.get(v); return sqlite3_bind_int64(stmt, idx, v);}
+	    case INT16:{ int16_t v = 0; data.get(v); return sqlite3_bind_int64(stmt, idx, v);}
+	    case INT32:{ int32_t v = 0; data.get(v); return sqlite3_bind_int64(stmt, idx, v);}
+	    case INT64:{ int64_t v = 0; data.get(v); return sqlite3_bind_int64(stmt, idx, v);}
+	    case UINT64:{
+			    uint64_t v = 0u;
+			    data.get(v);
+			    return sqlite3_bind_int64(stmt, idx, static_cast<sqlite3_int64>(v));
+			}
+	    case FLOAT:{ float v = 0.0f; data.get(v); return sqlite3_bind_double(stmt, idx, v);}
+	    case DOUBLE:{ double v = 0.0; data.get(v); return sqlite3_bind_double(stmt, idx, v);}
+	    case BOOL:{ bool v = false; data.get(v); return sqlite3_bind_int(stmt, idx, v ? 1 : 0);}
+	    //values are bound without copies. data has to live until the statement is stepped.
+	    case TEXT:{
+			  if(!codec::isCompressed(data.bytes(), data.size())){
+			      const char* text = (data.size() == 0u) ? ""
+				  : reinterpret_cast<const char*>(data.bytes());
+			      return sqlite3_bind_text64(stmt, idx, text, data.size(),
+				      SQLITE_STATIC, SQLITE_UTF8);
+			  }
+			  std::string v;
+			  data.get(v);
+			  return sqlite3_bind_text64(stmt, idx, v.data(), v.size(),
+				  SQLITE_TRANSIENT, SQLITE_UTF8);
+		      }
+	    case BLOB:{
+			  if(!codec::isCompressed(data.bytes(), data.size())){
+			      return sqlite3_bind_blob64(stmt, idx, data.bytes(), data.size(), SQLITE_STATIC);
+			  }
+			  Binary_t v;
+			  data.get(v);
+			  return sqlite3_bind_blob64(stmt, idx, v.data(), v.size(), SQLITE_TRANSIENT);
+		      }
+	}
+	return SQLITE_MISUSE;
+    }
+
+    //-------------------------------------------------------------------
+    // Bind a value of a COMPRESSED column, compressed as appendCompressed() does.
+    static int32_t bindCompressed(sqlite3_stmt* stmt, const int32_t& idx, const Data& data,
+	    const size_t& threshold){
+	if(data.type() != TEXT && data.type() != BLOB){
+	    return bindData(stmt, idx, data);
+	}
+	if(codec::isCompressed(data.bytes(), data.size())){
+	    return sqlite3_bind_blob64(stmt, idx, data.bytes(), data.size(), SQLITE_STATIC);
+	}
+	Binary_t packed;
+	if(data.size() >= threshold && codec::compress(data.bytes(), data.size(), packed)){
+	    return sqlite3_bind_blob64(stmt, idx, packed.data(), packed.size(), SQLITE_TRANSIENT);
+	}
+	return bindData(stmt, idx, data);
+    }
+
+    //-------------------------------------------------------------------
+    // Open a stream of a BLOB cell.
+    int32_t Fetcher::openBlob(const std::string& table_name, const std::string& column_name,
+	    const int64_t& rowid, const bool& writable, BlobStream& blob, std::string& err_msg){
+	err_msg.clear();
+	blob.close();
+	int32_t ret = sqlite3_blob_open(db_ptr_, "main", table_name.c_str(), column_name.c_str(),
+		rowid, writable ? 1 : 0, &blob.blob_ptr_);
+	if(ret != SQLITE_OK){
+	    err_msg = sqlite3_errmsg(db_ptr_);
+	    sqlite3_blob_close(blob.blob_ptr_);
+	    blob.blob_ptr_ = nullptr;
+	    return ret;
+	}
+	blob.fetcher_ = this;
+	blob.db_ptr_ = db_ptr_;
+	blob.table_name_ = table_name;
+	blob.rowid_ = rowid;
+	blob_streams_.insert(&blob);
+	return ret;
+    }
+
+    //-------------------------------------------------------------------
+    // Insert a row with a BLOB filled with zeros.
+    int32_t Fetcher::insertZeroBlob(const std::string& table_name, const Column_t& col,
+	    const std::string& blob_column, const size_t& blob_size,
+	    int64_t& rowid, std::string& err_msg){
+	err_msg.clear();
+	std::string query = "INSERT INTO " + table_name + "(";
+	std::string values = ") VALUES(";
+	for(auto i_col = col.begin(); i_col != col.end(); ++i_col){
+	    if(i_col->first == blob_column){
+		continue;
+	    }
+	    query += i_col->first + ", ";
+	    values += "?, ";
+	}
+	query += blob_column + values + "?);";
+
+	sqlite3_stmt* stmt = cachedStatement(query, err_msg);
+	if(stmt == nullptr){
+	    return SQLITE_ERROR;
+	}
+	int32_t idx = 1;
+	int32_t ret = SQLITE_OK;
+	for(auto i_col = col.begin(); i_col != col.end() && ret == SQLITE_OK; ++i_col){
+	    if(i_col->first != blob_column){
+		ret = bindData(stmt, idx++, i_col->second);
+	    }
+	}
+	if(ret == SQLITE_OK){
+	    ret = sqlite3_bind_zeroblob64(stmt, idx, blob_size);
+	}
+	if(ret != SQLITE_OK){
+	    err_msg = sqlite3_errmsg(db_ptr_);
+	    sqlite3_clear_bindings(stmt);
+	    return ret;
+	}
+	ret = sqlite3_step(stmt);
+	if(ret != SQLITE_DONE){
+	    err_msg = sqlite3_errmsg(db_ptr_);
+	    sqlite3_reset(stmt);
+	    return ret;
+	}
+	sqlite3_reset(stmt);
+	rowid = sqlite3_last_insert_rowid(db_ptr_);
+	publishChanges();
+	return SQLITE_OK;
+    }
+
+    //-------------------------------------------------------------------
+    // Insert rows with a cached statement.
+    int32_t Fetcher::insertRows(const std::string& table_name, const std::vector<std::string>& columns,
+	    const Data* cells, const size_t& n_rows, std::string& err_msg){
+	err_msg.clear();
+	if(columns.empty()){
+	    err_msg = "No columns to insert into " + table_name;
+	    return SQLITE_MISUSE;
+	}
+	std::string query = "INSERT INTO " + table_name + "(";
+	std::string values = ") VALUES(";
+	for(auto i_col = columns.begin(); i_col != columns.end(); ++i_col){
+	    if(i_col != columns.begin()){
+		query += ", ";
+		values += ", ";
+	    }
+	    query += *i_col;
+	    values += "?";
+	}
+	query += values + ");";
+
+	sqlite3_stmt* stmt = cachedStatement(query, err_msg);
+	if(stmt == nullptr){
+	    return SQLITE_ERROR;
+	}
+	const Column_t* table_col = findTableInfo(table_name);
+	if(table_col == nullptr && refreshSchema(last_err_) == SQLITE_OK){
+	    table_col = findTableInfo(table_name);
+	}
+	std::vector<bool> compressed(columns.size(), false);
+	for(size_t k=0u; k<columns.size() && table_col != nullptr; ++k){
+	    auto i_data = table_col->find(columns[k]);
+	    compressed[k] = i_data != table_col->end() && (i_data->second.flags() & COMPRESSED) != 0u;
+	}
+
+	int32_t n_col = static_cast<int32_t>(columns.size());
+	int32_t ret = SQLITE_DONE;
+	for(size_t r=0u; r<n_rows && ret == SQLITE_DONE; ++r){
+	    const Data* row = cells + r*columns.size();
+	    for(int32_t k=0; k<n_col && ret == SQLITE_DONE; ++k){
+		int32_t bind_ret = (compressed[k] || (row[k].flags() & COMPRESSED) != 0u)
+		    ? bindCompressed(stmt, k + 1, row[k], compress_threshold_)
+		    : bindData(stmt, k + 1, row[k]);
+		//a value bound before stays bound after reset
+		if(bind_ret != SQLITE_OK){
+		    ret = bind_ret;
+		}
+	    }
+	    if(ret == SQLITE_DONE){
+		ret = sqlite3_step(stmt);
+		sqlite3_reset(stmt);
+	    }
+	    if(ret != SQLITE_DONE){
+		err_msg = sqlite3_errmsg(db_ptr_);
+	    }
+	}
+	sqlite3_clear_bindings(stmt);
+	publishChanges();
+	return (ret == SQLITE_DONE) ? SQLITE_OK : ret;
+    }
+
+    //-------------------------------------------------------------------
+    // Copy a table into another database.
+    int32_t Fetcher::copyTable(const std::string& src_table, Fetcher& dst,
+	    const std::string& dst_table, std::string& err_msg,
+	    const std::string& filter, const ProgressHandler_t& progress){
+	err_msg.clear();
+	TableInfo_t src_info = getTableInfo(err_msg);
+	if(!err_msg.empty()){
+	    return SQLITE_ERROR;
+	}
+	auto i_src = src_info.find(src_table);
+	if(i_src == src_info.end()){
+	    err_msg = "No such a table: " + src_table;
+	    return SQLITE_ERROR;
+	}
+	IndexList_t src_indexes = getIndexInfo(src_table, err_msg);
+	if(!err_msg.empty()){
+	    return SQLITE_ERROR;
+	}
+
+	//Attach this database to the destination unless they are the same file
+	std::string src_path = sqlite3_db_filename(db_ptr_, "main");
+	std::string dst_path = sqlite3_db_filename(dst.db_ptr_, "main");
+	std::string src_schema = "main";
+	//rows are copied in a savepoint of an open transaction
+	const bool in_transaction = dst.inTransaction();
+	if(&dst != this && src_path != dst_path){
+	    if(in_transaction){
+		err_msg = "A database can't be attached in a transaction";
+		return SQLITE_MISUSE;
+	    }
+	    if(src_path.empty()){
+		err_msg = "A temporary or in-memory database can't be attached";
+		return SQLITE_ERROR;
+	    }
+	    src_schema = "sf_copy_src";
+	    std::string path;
+	    literal::appendText(path, src_path.c_str(), src_path.size());
+	    dst.exec("ATTACH DATABASE " + path + " AS " + src_schema + ";", err_msg);
+	    if(!err_msg.empty()){
+		return SQLITE_ERROR;
+	    }
+	}
+
+	std::string query;
+	std::string columns;
+	for(auto i_col = i_src->second.begin(); i_col != i_src->second.end(); ++i_col){
+	    if(!columns.empty()){
+		columns += ", ";
+	    }
+	    columns += i_col->first;
+	}
+	std::string from = " FROM " + src_schema + "." + src_table;
+	std::string where = filter.empty() ? "" : " WHERE (" + filter + ")";
+
+	//Count rows and the range of rowid to split the copy into chunks
+	int64_t n_total = 0;
+	int64_t min_rowid = 0;
+	int64_t max_rowid = -1;
+	bool has_rowid = true;
+	{
+	    ExecResult_t res;
+	    dst.exec("SELECT MIN(rowid) AS lo, MAX(rowid) AS hi, COUNT(*) AS n" + from + where + ";",
+		    res, err_msg);
+	    if(!err_msg.empty()){
+		//WITHOUT ROWID tables are copied in one chunk
+		has_rowid = false;
+		err_msg.clear();
+		dst.exec("SELECT COUNT(*) AS n" + from + where + ";", res, err_msg);
+	    }
+	    if(err_msg.empty() && !res.result.empty()){
+		const std::map<std::string, std::string>& row = res.result.front();
+		n_total = std::stoll(row.at("n"));
+		if(has_rowid && n_total > 0){
+		    min_rowid = std::stoll(row.at("lo"));
+		    max_rowid = std::stoll(row.at("hi"));
+		}
+	    }
+	}
+
+	bool to_create = false;
+	if(err_msg.empty()){
+	    TableInfo_t dst_info = dst.getTableInfo(err_msg);
+	    to_create = err_msg.empty() && dst_info.find(dst_table) == dst_info.end();
+	}
+	if(err_msg.empty()){
+	    dst.exec(in_transaction ? "SAVEPOINT sf_copy_table;" : "BEGIN IMMEDIATE;", err_msg);
+	}
+	if(err_msg.empty() && to_create){
+	    TableInfo_t create_info;
+	    create_info[dst_table] = i_src->second;
+	    dst.exec(dst.genQueryCreate(create_info, err_msg), err_msg);
+	}
+
+	const int64_t CHUNK_ROWS = 65536;
+	int64_t n_chunks = has_rowid ? std::max<int64_t>(1, n_total / CHUNK_ROWS) : 1;
+	//Offsets from min_rowid are unsigned, so rowids over the whole range of int64_t don't overflow.
+	const uint64_t span = static_cast<uint64_t>(max_rowid) - static_cast<uint64_t>(min_rowid);
+	const uint64_t n_rowids = span + 1u;
+	const uint64_t width = ((n_rowids == 0u) ? ~static_cast<uint64_t>(0u) : n_rowids)
+	    / static_cast<uint64_t>(n_chunks) + 1u;
+	int64_t n_done = 0;
+	uint64_t offset = 0u;
+	bool is_last = false;
+	for(int64_t k=0; !is_last && err_msg.empty(); ++k){
+	    is_last = (k + 1 >= n_chunks) || (span - offset < width);
+	    query = "INSERT INTO main." + dst_table + "(" + columns + ") SELECT " + columns + from;
+	    if(has_rowid){
+		query += " WHERE rowid >= ";
+		literal::appendInt(query, static_cast<int64_t>(static_cast<uint64_t>(min_rowid) + offset));
+		if(!is_last){
+		    offset += width;
+		    query += " AND rowid < ";
+		    literal::appendInt(query, static_cast<int64_t>(static_cast<uint64_t>(min_rowid) + offset));
+		}
+		if(!filter.empty()){
+		    query += " AND (" + filter + ")";
+		}
+		query += " ORDER BY rowid";
+	    }
+	    else{
+		query += where;
+	    }
+	    query += ";";
+	    dst.exec(query, err_msg);
+	    n_done += sqlite3_changes(dst.db_ptr_);
+	    if(err_msg.empty() && progress){
+		progress(n_done, n_total);
 	    }
-	    ret += dump(*i_res);
 	}
-	ret += "]}\n";
+
+	if(err_msg.empty() && to_create){
+	    IndexInfo_t index_info;
+	    index_info[dst_table] = src_indexes;
+	    if(dst_table != src_table){
+		for(auto i_idx = index_info[dst_table].begin(); i_idx != index_info[dst_table].end(); ++i_idx){
+		    if(i_idx->origin == "c"){
+			i_idx->name = dst_table + "_" + i_idx->name;
+		    }
+		}
+	    }
+	    dst.exec(dst.genQueryCreateIndex(index_info, err_msg), err_msg);
+	}
+
+	std::string end_msg;
+	if(in_transaction){
+	    dst.exec(err_msg.empty() ? "RELEASE sf_copy_table;"
+		    : "ROLLBACK TO sf_copy_table; RELEASE sf_copy_table;", end_msg);
+	}
+	else{
+	    dst.exec(err_msg.empty() ? "COMMIT;" : "ROLLBACK;", end_msg);
+	}
+	if(err_msg.empty()){
+	    err_msg = end_msg;
+	}
+	if(src_schema != "main"){
+	    dst.exec("DETACH DATABASE " + src_schema + ";", end_msg);
+	}
+	dst.to_info_update_ = true;
+	return err_msg.empty() ? SQLITE_OK : SQLITE_ERROR;
+    }
+
+    //-------------------------------------------------------------------
+    // Copy the whole database into another database.
+    int32_t Fetcher::copyDatabase(Fetcher& dst, std::string& err_msg,
+	    const ProgressHandler_t& progress){
+	err_msg.clear();
+	if(&dst == this){
+	    err_msg = "The destination is the same database";
+	    return SQLITE_MISUSE;
+	}
+	sqlite3_backup* backup = sqlite3_backup_init(dst.db_ptr_, "main", db_ptr_, "main");
+	if(backup == nullptr){
+	    err_msg = sqlite3_errmsg(dst.db_ptr_);
+	    return sqlite3_errcode(dst.db_ptr_);
+	}
+	const int32_t PAGES_PER_STEP = 4096;
+	int32_t ret = SQLITE_OK;
+	do{
+	    ret = sqlite3_backup_step(backup, PAGES_PER_STEP);
+	    if(ret == SQLITE_BUSY || ret == SQLITE_LOCKED){
+		sqlite3_sleep(10);
+	    }
+	    else if(progress){
+		int64_t n_total = sqlite3_backup_pagecount(backup);
+		progress(n_total - sqlite3_backup_remaining(backup), n_total);
+	    }
+	}while(ret == SQLITE_OK || ret == SQLITE_BUSY || ret == SQLITE_LOCKED);
+	sqlite3_backup_finish(backup);
+	if(ret != SQLITE_DONE){
+	    err_msg = sqlite3_errstr(ret);
+	    return ret;
+	}
+	//The schema and contents of the destination are replaced
+	dst.to_info_update_ = true;
+	dst.clearResultCache();
+	return SQLITE_OK;
+    }
+
+    //-------------------------------------------------------------------
+    // Back up the database into a file on a background thread.
+    int32_t Fetcher::backupTo(const std::string& path, std::string& err_msg,
+	    const int32_t& pages_per_step, const int32_t& sleep_ms,
+	    const ProgressHandler_t& progress){
+	err_msg.clear();
+	if(backup_thread_.joinable()){
+	    if(backup_running_){
+		err_msg = "A backup is running";
+		return SQLITE_BUSY;
+	    }
+	    backup_thread_.join();
+	}
+	//the connection is used by the background thread too
+	if(sqlite3_db_mutex(db_ptr_) == nullptr){
+	    err_msg = "The connection isn't serialized";
+	    return SQLITE_MISUSE;
+	}
+	sqlite3* dst_ptr = nullptr;
+	int32_t ret = sqlite3_open(path.c_str(), &dst_ptr);
+	if(ret != SQLITE_OK){
+	    err_msg = sqlite3_errstr(ret);
+	    sqlite3_close(dst_ptr);
+	    return ret;
+	}
+	sqlite3_backup* backup = sqlite3_backup_init(dst_ptr, "main", db_ptr_, "main");
+	if(backup == nullptr){
+	    err_msg = sqlite3_errmsg(dst_ptr);
+	    ret = sqlite3_errcode(dst_ptr);
+	    sqlite3_close(dst_ptr);
+	    return ret;
+	}
+
+	backup_result_ = SQLITE_OK;
+	backup_err_.clear();
+	backup_cancel_ = false;
+	backup_running_ = true;
+	backup_thread_ = std::thread([this, dst_ptr, backup, pages_per_step, sleep_ms, progress](){
+		int32_t ret = SQLITE_OK;
+		do{
+		    ret = sqlite3_backup_step(backup, pages_per_step);
+		    if(progress && ret != SQLITE_BUSY && ret != SQLITE_LOCKED){
+			int64_t n_total = sqlite3_backup_pagecount(backup);
+			progress(n_total - sqlite3_backup_remaining(backup), n_total);
+		    }
+		    if(ret == SQLITE_OK || ret == SQLITE_BUSY || ret == SQLITE_LOCKED){
+			sqlite3_sleep(sleep_ms);
+		    }
+		}while(!backup_cancel_
+			&& (ret == SQLITE_OK || ret == SQLITE_BUSY || ret == SQLITE_LOCKED));
+		sqlite3_backup_finish(backup);
+		if(ret != SQLITE_DONE){
+		    backup_result_ = backup_cancel_ ? SQLITE_ABORT : ret;
+		    backup_err_ = sqlite3_errstr(backup_result_);
+		}
+		sqlite3_close(dst_ptr);
+		backup_running_ = false;
+	    });
+	return SQLITE_OK;
+    }
+
+    //-------------------------------------------------------------------
+    // Wait for the backup to finish.
+    int32_t Fetcher::waitBackup(std::string& err_msg){
+	if(backup_thread_.joinable()){
+	    backup_thread_.join();
+	}
+	err_msg = backup_err_;
+	return backup_result_;
+    }
+
+    //-------------------------------------------------------------------
+    // Cancel the backup.
+    void Fetcher::cancelBackup(){
+	backup_cancel_ = true;
+	if(backup_thread_.joinable()){
+	    backup_thread_.join();
+	}
+    }
+
+    //-------------------------------------------------------------------
+    bool Fetcher::isBackingUp() const{
+	return backup_running_;
+    }
+
+    //-------------------------------------------------------------------
+    // Read a row of a statement into a column.
+    void Fetcher::readRow(sqlite3_stmt* stmt, const std::vector<Type_t>& types,
+	    const Column_t* table_col, Column_t& a_col, const int32_t& n_col){
+	for(int32_t k=0; k<n_col; ++k){
+	    std::string name = sqlite3_column_name(stmt, k);
+	    KeyFlag_t flg = NORMAL;
+	    if(table_col != nullptr){
+		auto i_data = table_col->find(name);
+		if(i_data != table_col->end()){
+		    flg = i_data->second.flags();
+		}
+	    }
+	    Type_t type = (types[k] == NONE) ? storageType(stmt, k) : types[k];
+	    a_col[name] = columnData(stmt, k, type, flg);
+	}
+    }
+
+    //-------------------------------------------------------------------
+    // Fetch rows of a query whose columns aren't those of a table.
+    void Fetcher::fetchColumnByStatement(const std::string& query, ColumnList_t& col,
+	    std::string& err_msg){
+	sqlite3_stmt* stmt = nullptr;
+	int32_t ret = sqlite3_prepare_v2(db_ptr_, query.c_str(), -1, &stmt, nullptr);
+	if(ret != SQLITE_OK){
+	    err_msg = sqlite3_errmsg(db_ptr_);
+	    sqlite3_finalize(stmt);
+	    return;
+	}
+	int32_t n_col = sqlite3_column_count(stmt);
+	std::vector<Type_t> types = columnTypes(stmt);
+	beginResult();
+	while((ret = sqlite3_step(stmt)) == SQLITE_ROW){
+	    if(!chargeResult(rowBytes(stmt, n_col, COLUMN_CELL_BYTES))){
+		break;
+	    }
+	    col.emplace_back();
+	    readRow(stmt, types, nullptr, col.back(), n_col);
+	}
+	if(ret != SQLITE_ROW && ret != SQLITE_DONE){
+	    err_msg = sqlite3_errmsg(db_ptr_);
+	}
+	sqlite3_finalize(stmt);
+	if(endResult(err_msg) != SQLITE_OK || !err_msg.empty()){
+	    col.clear();
+	}
+    }
+
+    //-------------------------------------------------------------------
+    // Encode a value of a statement into a token.
+    static std::string encodeToken(sqlite3_stmt* stmt, const int32_t& k){
+	static const char* hex = "0123456789abcdef";
+	std::string ret;
+	const uint8_t* bytes = nullptr;
+	int32_t n_bytes = 0;
+	switch(sqlite3_column_type(stmt, k)){
+	    case SQLITE_INTEGER:
+		return "i" + std::to_string(sqlite3_column_int64(stmt, k));
+	    case SQLITE_FLOAT:{
+				  char buff[32];
+				  snprintf(buff, sizeof(buff), "%.17g", sqlite3_column_double(stmt, k));
+				  return std::string("r") + buff;
+			      }
+	    case SQLITE_TEXT:
+			      ret = "t";
+			      bytes = sqlite3_column_text(stmt, k);
+			      n_bytes = sqlite3_column_bytes(stmt, k);
+			      break;
+	    case SQLITE_BLOB:
+			      ret = "b";
+			      bytes = static_cast<const uint8_t*>(sqlite3_column_blob(stmt, k));
+			      n_bytes = sqlite3_column_bytes(stmt, k);
+			      break;
+	    default:
+			      return "";
+	}
+	for(int32_t n=0; n<n_bytes; ++n){
+	    ret.push_back(hex[bytes[n] >> 4]);
+	    ret.push_back(hex[bytes[n] & 0x0f]);
+	}
 	return ret;
     }
 
     //-------------------------------------------------------------------
-    // Fetch column list from result of executed query for SELECT.
-    ColumnList_t Fetcher::fetchColumn(const std::string& query, std::string& err_msg){
-	ColumnList_t col;
+    // Bind a value encoded in a token.
+    static bool bindToken(sqlite3_stmt* stmt, const int32_t& idx, const std::string& token){
+	if(token.size() < 2u){
+	    return false;
+	}
+	std::string body = token.substr(1u);
+	try{
+	    switch(token[0]){
+		case 'i':
+		    return sqlite3_bind_int64(stmt, idx, std::stoll(body)) == SQLITE_OK;
+		case 'r':
+		    return sqlite3_bind_double(stmt, idx, std::stod(body)) == SQLITE_OK;
+		case 't':
+		case 'b':{
+			     if(body.size() % 2u != 0u){
+				 return false;
+			     }
+			     std::string bytes;
+			     for(size_t n=0u; n<body.size(); n+=2u){
+				 bytes.push_back(static_cast<char>(std::stoi(body.substr(n, 2u), nullptr, 16)));
+			     }
+			     if(token[0] == 't'){
+				 return sqlite3_bind_text(stmt, idx, bytes.data(),
+					 static_cast<int>(bytes.size()), SQLITE_TRANSIENT) == SQLITE_OK;
+			     }
+			     return sqlite3_bind_blob(stmt, idx, bytes.data(),
+				     static_cast<int>(bytes.size()), SQLITE_TRANSIENT) == SQLITE_OK;
+			 }
+		default:
+			 return false;
+	    }
+	}
+	catch(std::exception&){
+	    return false;
+	}
+    }
+
+    //-------------------------------------------------------------------
+    // Fetch a page of a table by keyset pagination.
+    Page_t Fetcher::fetchPage(const std::string& table_name, const std::string& key_column,
+	    const size_t& page_size, const std::string& token, std::string& err_msg){
 	err_msg.clear();
-	
-	//separate query by white space
-	std::istringstream iss(query);
-	std::vector<std::string> words;
-	std::string a_word;
-	while (iss >> a_word) {
-	    //delete comma
-	    size_t comma_pos = a_word.find(",");
-	    if(comma_pos != std::string::npos){
-		a_word.erase(comma_pos,1);
+	syncReplica();
+	Page_t page;
+	//the key is selected at the end again, since rowid isn't given by "*"
+	std::string query = "SELECT *, " + key_column + " FROM " + table_name
+	    + (token.empty() ? "" : " WHERE " + key_column + " > ?")
+	    + " ORDER BY " + key_column + " LIMIT ?;";
+	std::string cache_key = query + '\x1f' + token + '\x1f' + std::to_string(page_size);
+	if(cache_enabled_ && findCache(cache_key, page.rows, page.token)){
+	    return page;
+	}
+	sqlite3_stmt* stmt = cachedStatement(query, err_msg);
+	if(stmt == nullptr){
+	    return page;
+	}
+	int32_t idx = 1;
+	if(!token.empty() && !bindToken(stmt, idx++, token)){
+	    err_msg = "Invalid token: " + token;
+	    return page;
+	}
+	//one more row to know whether the next page exists
+	sqlite3_bind_int64(stmt, idx, static_cast<sqlite3_int64>(page_size) + 1);
+
+	std::vector<Type_t> types = columnTypes(stmt);
+	const Column_t* table_col = findTableInfo(table_name);
+	if(table_col == nullptr && refreshSchema(last_err_) == SQLITE_OK){
+	    table_col = findTableInfo(table_name);
+	}
+	int32_t key_idx = sqlite3_column_count(stmt) - 1;
+
+	int32_t ret = SQLITE_ROW;
+	std::string last_token;
+	beginResult();
+	while((ret = sqlite3_step(stmt)) == SQLITE_ROW){
+	    if(page.rows.size() == page_size){
+		page.token = last_token;
+		break;
 	    }
-	    size_t colon_pos = a_word.find(";");
-	    if(colon_pos != std::string::npos){
-		a_word.erase(colon_pos,1);
+	    if(!chargeResult(rowBytes(stmt, key_idx, COLUMN_CELL_BYTES))){
+		break;
 	    }
-	    words.push_back(a_word);
+	    page.rows.emplace_back();
+	    readRow(stmt, types, table_col, page.rows.back(), key_idx);
+	    last_token = encodeToken(stmt, key_idx);
+	}
+	if(ret != SQLITE_ROW && ret != SQLITE_DONE){
+	    err_msg = sqlite3_errmsg(db_ptr_);
+	}
+	sqlite3_reset(stmt);
+	if(endResult(err_msg) != SQLITE_OK){
+	    page = Page_t();
+	    return page;
+	}
+	if(cache_enabled_ && err_msg.empty()){
+	    addCache(cache_key, query, page.rows, page.token);
+	}
+	return page;
+    }
+
+    //-------------------------------------------------------------------
+    // Fetch column list into an arena.
+    void Fetcher::fetchColumn(const std::string& query, ArenaColumnList& col, std::string& err_msg){
+	err_msg.clear();
+	col.clear();
+	syncReplica();
+	if(warn_scan_){
+	    warnScan(query);
+	}
+
+	sqlite3_stmt* stmt = nullptr;
+	int32_t ret = sqlite3_prepare_v2(db_ptr_, query.c_str(), -1, &stmt, nullptr);
+	if(ret != SQLITE_OK){
+	    err_msg = sqlite3_errmsg(db_ptr_);
+	    sqlite3_finalize(stmt);
+	    return;
+	}
+
+	int32_t n_col = sqlite3_column_count(stmt);
+	std::vector<std::string> names;
+	for(int32_t k=0; k<n_col; ++k){
+	    names.push_back(sqlite3_column_name(stmt, k));
+	}
+	col.setNames(names);
+	std::vector<Type_t> types = columnTypes(stmt);
+
+	beginResult();
+	while((ret = sqlite3_step(stmt)) == SQLITE_ROW){
+	    if(!chargeResult(rowBytes(stmt, n_col, sizeof(ArenaData)))){
+		break;
+	    }
+	    ArenaData* row = col.addRow();
+	    for(int32_t k=0; k<n_col; ++k){
+		ArenaData& value = row[k];
+		value.type_ = (types[k] == NONE) ? storageType(stmt, k) : types[k];
+		if(sqlite3_column_type(stmt, k) == SQLITE_NULL){
+		    continue;
+		}
+		switch(value.type_){
+		    case NONE:
+			break;
+		    case INT8:{
+				  int8_t v = static_cast<int8_t>(sqlite3_column_int64(stmt, k));
+				  value.set(&v, sizeof(v), col);
+				  break;
+			      }
+		    case INT16:{
+				   int16_t v = static_cast<int16_t>(sqlite3_column_int64(stmt, k));
+				   value.set(&v, sizeof(v), col);
+				   break;
+			       }
+		    case INT32:{
+				   int32_t v = static_cast<int32_t>(sqlite3_column_int64(stmt, k));
+				   value.set(&v, sizeof(v), col);
+				   break;
+			       }
+		    case INT64:{
+				   int64_t v = sqlite3_column_int64(stmt, k);
+				   value.set(&v, sizeof(v), col);
+				   break;
+			       }
+		    case UINT64:{
+				    uint64_t v = static_cast<uint64_t>(sqlite3_column_int64(stmt, k));
+				    value.set(&v, sizeof(v), col);
+				    break;
+				}
+		    case FLOAT:{
+				   float v = static_cast<float>(sqlite3_column_double(stmt, k));
+				   value.set(&v, sizeof(v), col);
+				   break;
+			       }
+		    case DOUBLE:{
+				    double v = sqlite3_column_double(stmt, k);
+				    value.set(&v, sizeof(v), col);
+				    break;
+				}
+		    case BOOL:{
+				  bool v = (sqlite3_column_int64(stmt, k) != 0);
+				  value.set(&v, sizeof(v), col);
+				  break;
+			      }
+		    case TEXT:{
+				  const unsigned char* v = sqlite3_column_text(stmt, k);
+				  value.set(v, sqlite3_column_bytes(stmt, k), col);
+				  break;
+			      }
+		    case BLOB:{
+				  const void* v = sqlite3_column_blob(stmt, k);
+				  value.set(v, sqlite3_column_bytes(stmt, k), col);
+				  break;
+			      }
+		}
+	    }
+	}
+	if(ret != SQLITE_DONE && ret != SQLITE_ROW){
+	    err_msg = sqlite3_errmsg(db_ptr_);
+	}
+	if(endResult(err_msg) != SQLITE_OK){
+	    col.clear();
+	}
+	sqlite3_finalize(stmt);
+    }
+
+    //-------------------------------------------------------------------
+    // Fetch a result of a query column by column.
+    void Fetcher::fetchColumnar(const std::string& query, ColumnarResult& res, std::string& err_msg){
+	fetchColumnar(query, res, err_msg, false);
+    }
+
+    //-------------------------------------------------------------------
+    void Fetcher::fetchColumnar(const std::string& query, ColumnarResult& res, std::string& err_msg,
+	    const bool& dictionary_text){
+	err_msg.clear();
+	res.clear();
+	syncReplica();
+	if(warn_scan_){
+	    warnScan(query);
+	}
+
+	sqlite3_stmt* stmt = nullptr;
+	int32_t ret = sqlite3_prepare_v2(db_ptr_, query.c_str(), -1, &stmt, nullptr);
+	if(ret != SQLITE_OK){
+	    err_msg = sqlite3_errmsg(db_ptr_);
+	    sqlite3_finalize(stmt);
+	    return;
+	}
+
+	int32_t n_col = sqlite3_column_count(stmt);
+	std::vector<Type_t> types = columnTypes(stmt);
+	res.columns_.resize(n_col);
+	for(int32_t k=0; k<n_col; ++k){
+	    res.columns_[k].name_ = sqlite3_column_name(stmt, k);
+	    res.columns_[k].use_dictionary_ = dictionary_text;
+	    res.columns_[k].setType(types[k]);
+	    res.columns_[k].reserve(1024u);
+	}
+
+	beginResult();
+	while((ret = sqlite3_step(stmt)) == SQLITE_ROW){
+	    if(!chargeResult(rowBytes(stmt, n_col, sizeof(size_t)))){
+		break;
+	    }
+	    for(int32_t k=0; k<n_col; ++k){
+		res.columns_[k].append(stmt, k);
+	    }
+	    ++res.size_;
+	}
+	if(ret != SQLITE_DONE && ret != SQLITE_ROW){
+	    err_msg = sqlite3_errmsg(db_ptr_);
+	}
+	if(endResult(err_msg) != SQLITE_OK || !err_msg.empty()){
+	    res.clear();
+	}
+	sqlite3_finalize(stmt);
+    }
+
+    //-------------------------------------------------------------------
+    // Fetch column list which moves to a temporary file beyond a budget.
+    void Fetcher::fetchColumn(const std::string& query, SpilledResult& res, std::string& err_msg,
+	    const size_t& memory_budget){
+	err_msg.clear();
+	res.clear();
+	syncReplica();
+	if(warn_scan_){
+	    warnScan(query);
+	}
+
+	sqlite3_stmt* stmt = nullptr;
+	int32_t ret = sqlite3_prepare_v2(db_ptr_, query.c_str(), -1, &stmt, nullptr);
+	if(ret != SQLITE_OK){
+	    err_msg = sqlite3_errmsg(db_ptr_);
+	    sqlite3_finalize(stmt);
+	    return;
+	}
+
+	int32_t n_col = sqlite3_column_count(stmt);
+	std::vector<std::string> names;
+	for(int32_t k=0; k<n_col; ++k){
+	    names.push_back(sqlite3_column_name(stmt, k));
+	}
+	std::vector<Type_t> types = columnTypes(stmt);
+	size_t budget = (memory_budget == 0u) ? memory_limit_.soft_bytes : memory_budget;
+	res.start(names, budget, err_msg);
+
+	Column_t a_row;
+	while((ret = sqlite3_step(stmt)) == SQLITE_ROW){
+	    readRow(stmt, types, nullptr, a_row, n_col);
+	    if(res.append(a_row, rowBytes(stmt, n_col, COLUMN_CELL_BYTES), err_msg) != SQLITE_OK){
+		break;
+	    }
+	}
+	if(err_msg.empty() && ret != SQLITE_DONE){
+	    err_msg = sqlite3_errmsg(db_ptr_);
+	}
+	if(err_msg.empty()){
+	    res.finish(err_msg);
+	}
+	if(!err_msg.empty()){
+	    res.clear();
+	}
+	sqlite3_finalize(stmt);
+    }
+
+    //-------------------------------------------------------------------
+    // Expose rows in memory as a virtual table.
+    int32_t Fetcher::attachTable(const std::string& name, const Column_t& schema,
+	    const ColumnList_t& rows, std::string& err_msg){
+	VirtualTableRegistry::Source_t source;
+	for(auto i_col=schema.begin(); i_col!=schema.end(); ++i_col){
+	    source.names.push_back(i_col->first);
+	    source.decls.push_back((i_col->second.type() == NONE) ? "" : i_col->second.typeStr(false));
+	}
+	source.n_rows = rows.size();
+	source.list = &rows;
+	if(!vtab_registry_){
+	    vtab_registry_.reset(new VirtualTableRegistry());
+	}
+	int32_t ret = vtab_registry_->add(db_ptr_, name, std::move(source), err_msg);
+	if(ret == SQLITE_OK){
+	    refreshSchema(last_err_);
+	}
+	return ret;
+    }
+
+    //-------------------------------------------------------------------
+    // Expose a columnar result as a virtual table.
+    int32_t Fetcher::attachTable(const std::string& name, const ColumnarResult& res, std::string& err_msg){
+	VirtualTableRegistry::Source_t source;
+	for(size_t col=0u; col<res.columns_.size(); ++col){
+	    source.names.push_back(res.columns_[col].name());
+	    switch(res.columns_[col].type()){
+		case INT64:
+		    source.decls.push_back("INTEGER");
+		    break;
+		case DOUBLE:
+		    source.decls.push_back("REAL");
+		    break;
+		case TEXT:
+		    source.decls.push_back("TEXT");
+		    break;
+		case BLOB:
+		    source.decls.push_back("BLOB");
+		    break;
+		default:
+		    source.decls.push_back("");
+		    break;
+	    }
+	}
+	source.n_rows = res.size();
+	source.columnar = &res;
+	if(!vtab_registry_){
+	    vtab_registry_.reset(new VirtualTableRegistry());
+	}
+	int32_t ret = vtab_registry_->add(db_ptr_, name, std::move(source), err_msg);
+	if(ret == SQLITE_OK){
+	    refreshSchema(last_err_);
+	}
+	return ret;
+    }
+
+    //-------------------------------------------------------------------
+    // Drop a virtual table of rows in memory.
+    int32_t Fetcher::detachTable(const std::string& name, std::string& err_msg){
+	if(!vtab_registry_){
+	    err_msg = "No container is attached as " + name;
+	    return SQLITE_ERROR;
 	}
+	int32_t ret = vtab_registry_->remove(db_ptr_, name, err_msg);
+	if(ret == SQLITE_OK){
+	    refreshSchema(last_err_);
+	}
+	return ret;
+    }
 
-	//get table name from query
-	auto i_select = std::find_if(words.begin(),words.end(),
-		[](const std::string w){ return ( w == "select" || w == "SELECT");});
-	if(i_select == words.end()){
-	    err_msg = "Query doen't include 'FROM' statement";
-	    return col;
+    //-------------------------------------------------------------------
+    // Fetch column list from a large table in parallel.
+    void Fetcher::fetchColumnParallel(const std::string& table_name, ColumnList_t& col,
+	    std::string& err_msg, const ScanOption_t& option){
+	col.clear();
+	err_msg.clear();
+
+	std::string select = "SELECT ";
+	if(option.columns.empty()){
+	    select += "*";
 	}
-	//get table name from query
-	auto i_from = std::find_if(words.begin(),words.end(),
-		[](const std::string w){ return ( w == "from" || w == "FROM");});
-	if(i_from == words.end()){
-	    err_msg = "Query doen't include 'FROM' statement";
-	    return col;
+	for(auto i_col = option.columns.begin(); i_col != option.columns.end(); ++i_col){
+	    select += ((i_col == option.columns.begin()) ? "" : ", ") + *i_col;
 	}
+	select += " FROM " + table_name;
+	std::string cond = option.where.empty() ? "" : "(" + option.where + ")";
 
-	auto i_table_info = last_table_info_.find(*std::next(i_from));
-	if(i_table_info == last_table_info_.end()){
-	    err_msg = "No such a table: " + *std::next(i_from);
-	    return col;
+	const char* file_name = sqlite3_db_filename(db_ptr_, "main");
+	if(file_name == nullptr || file_name[0] == '\0'){
+	    fetchColumn(select + (cond.empty() ? "" : " WHERE " + cond)
+		    + " ORDER BY " + option.key_column, col, err_msg);
+	    return;
 	}
 
-	const Column_t& table_col = i_table_info->second;
+	if(option.enable_wal){
+	    exec("PRAGMA journal_mode=WAL;", err_msg);
+	    if(!err_msg.empty()){
+		return;
+	    }
+	}
 
-	//if all rows are selected
-	auto i_all = std::find_if(i_select, i_from,
-		[](const std::string w){ return  w == "*";});
+	//range of the key
+	ExecResult_t range;
+	exec("SELECT MIN(" + option.key_column + ") AS lo, MAX(" + option.key_column
+		+ ") AS hi FROM " + table_name + (cond.empty() ? "" : " WHERE " + cond) + ";",
+		range, err_msg);
+	if(!err_msg.empty() || range.result.empty() || range.result.front().at("lo").empty()){
+	    return;
+	}
+	int64_t lo = std::stoll(range.result.front().at("lo"));
+	int64_t hi = std::stoll(range.result.front().at("hi"));
 
-	//create new query to quate BLOB data
-	std::string new_query = "";
-	for(auto i_word=words.begin(); i_word != std::next(i_select); ++i_word){
-	    new_query += *i_word + " ";
+	size_t n_part = option.n_partitions;
+	if(n_part == 0u){
+	    n_part = std::max(1u, std::thread::hardware_concurrency());
 	}
+	//offsets from lo are unsigned, since hi - lo may not fit in int64_t
+	uint64_t span = static_cast<uint64_t>(hi) - static_cast<uint64_t>(lo);
+	uint64_t width = span / n_part + 1u;//0 if a partition covers all 2^64 keys
+	auto keyAt = [lo](const uint64_t& offset){
+	    return static_cast<int64_t>(static_cast<uint64_t>(lo) + offset);
+	};
 
-	bool is_changed = false;
-	if(i_all != i_from){
-	    auto i_col_end = table_col.end();
-	    for(auto i_col = table_col.begin(); i_col != i_col_end; ++i_col){
-		if(i_col->second.type() == BLOB){
-		    new_query += "quote(" + i_col->first + ")";
-		    is_changed = true;
-		}
-		else{
-		    new_query += i_col->first;
-		}
+	std::vector<ColumnList_t> results(n_part);
+	std::vector<std::string> errors(n_part);
+	std::vector<std::future<void>> futures;
+	std::string db_name = file_name;
+	ThreadPool pool(n_part);
+	for(size_t k=0u; k<n_part; ++k){
+	    uint64_t offset = width*k;
+	    if(k > 0u && (width == 0u || offset/k != width || offset > span)){
+		break;
+	    }
+	    std::string part_cond = option.key_column + " >= " + std::to_string(keyAt(offset));
+	    if(width != 0u && span - offset >= width){
+		part_cond += " AND " + option.key_column + " < "
+		    + std::to_string(keyAt(offset + width));
+	    }
+	    if(!cond.empty()){
+		part_cond += " AND " + cond;
+	    }
+	    std::string part_query = select + " WHERE " + part_cond
+		+ " ORDER BY " + option.key_column;
+	    futures.push_back(pool.submit([k, part_query, &db_name, &results, &errors](){
+			Fetcher reader;
+			if(reader.open(db_name, errors[k], SQLITE_OPEN_READONLY) == SQLITE_OK){
+			    reader.fetchColumn(part_query, results[k], errors[k]);
+			    reader.close("");
+			}
+			}));
+	}
 
-		if(std::next(i_col) != i_col_end){
-		    new_query += ", ";
-		}
+	size_t n_rows = 0u;
+	for(size_t k=0u; k<futures.size(); ++k){
+	    futures[k].get();
+	    if(!errors[k].empty() && err_msg.empty()){
+		err_msg = errors[k];
 	    }
+	    n_rows += results[k].size();
 	}
-	//If specific rows are selected
-	else{
-	    for(auto i_word=std::next(i_select); i_word != i_from; ++i_word){
-		auto i_row = table_col.find(*i_word);
-		if(i_row != table_col.end()){
-		    if(i_row->second.type() == BLOB){
-			new_query += "quote(" + i_row->first + ")";
-			is_changed = true;
-		    }
-		    else{
-			new_query += i_row->first;
-		    }
+	if(!err_msg.empty()){
+	    return;
+	}
+	col.reserve(n_rows);
+	for(size_t k=0u; k<futures.size(); ++k){
+	    std::move(results[k].begin(), results[k].end(), std::back_inserter(col));
+	}
+    }
 
-		    if(std::next(i_word) != i_from){
-			new_query += ", ";
-		    }
+    //-------------------------------------------------------------------
+    // Run a pragma giving an integer.
+    bool Fetcher::pragmaInt(const std::string& query, int64_t& value){
+	std::string err_msg;
+	sqlite3_stmt* stmt = cachedStatement(query, err_msg);
+	if(stmt == nullptr){
+	    return false;
+	}
+	bool ret = (sqlite3_step(stmt) == SQLITE_ROW);
+	if(ret){
+	    value = sqlite3_column_int64(stmt, 0);
+	}
+	sqlite3_reset(stmt);
+	return ret;
+    }
+
+    //-------------------------------------------------------------------
+    // Update the schema if the schema version is changed.
+    // The main database is shared with other connections through SchemaRegistry.
+    int32_t Fetcher::refreshSchema(std::string& err_msg){
+	err_msg.clear();
+	if(db_ptr_ == nullptr){
+	    return SQLITE_MISUSE;
+	}
+	int64_t version = -1;
+	if(!pragmaInt("PRAGMA main.schema_version;", version)){
+	    err_msg = sqlite3_errmsg(db_ptr_);
+	    return SQLITE_ERROR;
+	}
+	if(!schema_ || schema_->schema_version != version){
+	    //the SQL of the schema tells a file made again at the same path
+	    uint64_t fingerprint = 0u;
+	    sqlite3_stmt* stmt = cachedStatement("SELECT sql FROM sqlite_master;", err_msg);
+	    if(stmt == nullptr){
+		return SQLITE_ERROR;
+	    }
+	    std::hash<std::string> hasher;
+	    while(sqlite3_step(stmt) == SQLITE_ROW){
+		const char* sql = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+		fingerprint = fingerprint * 31u + hasher((sql == nullptr) ? "" : sql);
+	    }
+	    sqlite3_reset(stmt);
+
+	    auto loader = [this](std::string& load_msg){ return scanTableInfo("sqlite_master", load_msg); };
+	    const char* path = sqlite3_db_filename(db_ptr_, "main");
+	    if(schema_slot_ == nullptr && path != nullptr && path[0] != '\0'){
+		schema_slot_ = SchemaRegistry::instance().slot(path);
+	    }
+	    SchemaPtr_t snapshot;
+	    if(schema_slot_ != nullptr){
+		snapshot = schema_slot_->acquire(version, fingerprint, loader, err_msg);
+	    }
+	    else{
+		std::shared_ptr<SchemaSnapshot_t> own = std::make_shared<SchemaSnapshot_t>();
+		own->schema_version = version;
+		own->fingerprint = fingerprint;
+		own->tables = loader(err_msg);
+		snapshot = own;
+	    }
+	    if(!err_msg.empty()){
+		return SQLITE_ERROR;
+	    }
+	    schema_ = snapshot;
+	    for(auto i_table=declared_tables_.begin(); i_table!=declared_tables_.end();){
+		if(schema_->tables.count(i_table->first) != 0u){
+		    i_table = declared_tables_.erase(i_table);
 		}
 		else{
-		    err_msg = "Coudn't find " + i_row->first + " in table " +  *std::next(i_from);
-		    return col;
+		    ++i_table;
 		}
 	    }
 	}
 
-	if(!is_changed){
-	    new_query = query;
+	if(!pragmaInt("PRAGMA temp.schema_version;", version)){
+	    err_msg = sqlite3_errmsg(db_ptr_);
+	    return SQLITE_ERROR;
 	}
-	else{
-	    //add rest of queries
-	    auto i_words_end = words.end();
-	    for(auto i_word = i_from; i_word != i_words_end; ++i_word){
-		new_query += " " + *i_word;
+	if(version != temp_schema_version_){
+	    temp_tables_ = scanTableInfo("sqlite_temp_master", err_msg);
+	    if(!err_msg.empty()){
+		return SQLITE_ERROR;
 	    }
+	    temp_schema_version_ = version;
 	}
-	new_query += ";";
+	return SQLITE_OK;
+    }
 
-	ExecResult_t res = exec(new_query, err_msg);
-	if(!err_msg.empty()){
-	    return col;
+    //-------------------------------------------------------------------
+    // Find a table in temporary tables, the database and tables made by genQueryCreate().
+    const Column_t* Fetcher::findTableInfo(const std::string& table_name) const{
+	auto i_temp = temp_tables_.find(table_name);
+	if(i_temp != temp_tables_.end()){
+	    return &i_temp->second;
 	}
-	
-	auto i_res_end = res.result.end();
-	for(auto i_res = res.result.begin(); i_res != i_res_end; ++i_res){
-	    auto i_elm_end = i_res->end();
-	    Column_t a_col;
-	    for(auto i_elm = i_res->begin(); i_elm != i_elm_end; ++i_elm){
-		//remove quote()
-		std::string keyword;
-		if(i_elm->first.find("quote(") != std::string::npos){
-		    keyword = i_elm->first.substr(6u,i_elm->first.length()-7u);
-		}
-		else{
-		    keyword = i_elm->first;
-		}
-		auto i_data = table_col.find(keyword);
-		if(i_data == table_col.end()){
-		    err_msg = "Coudn't find " + keyword + " in table " +  *std::next(i_from);
-		}
-		a_col[keyword] = Data(i_elm->second, 
-			i_data->second.typeStr(), i_data->second.flags());
+	if(schema_){
+	    auto i_table = schema_->tables.find(table_name);
+	    if(i_table != schema_->tables.end()){
+		return &i_table->second;
 	    }
-	    col.push_back(a_col);
 	}
-
-	return col;
+	auto i_declared = declared_tables_.find(table_name);
+	return (i_declared == declared_tables_.end()) ? nullptr : &i_declared->second;
     }
 
     //-------------------------------------------------------------------
     // Get master table.
     TableInfo_t Fetcher::getTableInfo(std::string& err_msg){
+	//temporary tables, e.g. ones made by attachTable(), are included
+	TableInfo_t table_info = scanTableInfo("sqlite_temp_master", err_msg);
+	if(err_msg.empty()){
+	    TableInfo_t main_info = scanTableInfo("sqlite_master", err_msg);
+	    table_info.insert(main_info.begin(), main_info.end());
+	}
+	return table_info;
+    }
+
+    //-------------------------------------------------------------------
+    // Read tables listed in a master table.
+    TableInfo_t Fetcher::scanTableInfo(const std::string& master, std::string& err_msg){
 	err_msg.clear();
-	ExecResult_t res = exec("SELECT * FROM sqlite_master;",err_msg);
+	ExecResult_t res = exec("SELECT type, name FROM " + master + ";", err_msg);
 	TableInfo_t table_info;
 	if(!err_msg.empty()){
 	    return table_info;
@@ -930,72 +3894,282 @@ namespace sf{
 	    if(i_res->at("notnull") == "1"){
 		flg |= NOT_NULL;
 	    }
+	    std::string type = i_res->at("type");
+	    size_t i_compressed = type.find(" COMPRESSED");
+	    if(i_compressed != std::string::npos){
+		flg |= COMPRESSED;
+		type.erase(i_compressed, 11u);
+	    }
 
 	    if(has_dflt){
 		table_info[i_res->at("name")]
-		    = Data(i_res->at("dflt_value"), i_res->at("type"),  flg);
+		    = Data(i_res->at("dflt_value"), type,  flg);
 	    }
 	    else{
 		table_info[i_res->at("name")]
-		    = Data(i_res->at("type"), flg);
+		    = Data(type, flg);
 	    }
 	}
 	return table_info;
     }
 
+    //-------------------------------------------------------------------
+    // Split "CREATE INDEX name ON table(col1, expr2) WHERE cond" into columns and the condition.
+    static void parseIndexSql(const std::string& sql,
+	    std::vector<std::string>& columns, std::string& where){
+	columns.clear();
+	where.clear();
+	size_t i_open = sql.find('(');
+	if(i_open == std::string::npos){
+	    return;
+	}
+	int32_t depth = 0;
+	char quote = '\0';
+	std::string a_col;
+	size_t k = i_open;
+	for(; k < sql.size(); ++k){
+	    char c = sql[k];
+	    if(quote != '\0'){
+		if(c == quote){
+		    quote = '\0';
+		}
+	    }
+	    else if(c == '\'' || c == '"' || c == '`'){
+		quote = c;
+	    }
+	    else if(c == '('){
+		++depth;
+		if(depth == 1){
+		    continue;
+		}
+	    }
+	    else if(c == ')'){
+		--depth;
+		if(depth == 0){
+		    break;
+		}
+	    }
+	    else if(c == ',' && depth == 1){
+		columns.push_back(a_col);
+		a_col.clear();
+		continue;
+	    }
+	    a_col.push_back(c);
+	}
+	columns.push_back(a_col);
+	for(auto i_col = columns.begin(); i_col != columns.end(); ++i_col){
+	    size_t i_first = i_col->find_first_not_of(" \t\n");
+	    size_t i_last = i_col->find_last_not_of(" \t\n");
+	    *i_col = (i_first == std::string::npos) ?
+		"" : i_col->substr(i_first, i_last - i_first + 1u);
+	}
+
+	if(k >= sql.size()){
+	    return;
+	}
+	std::string rest = sql.substr(k + 1u);
+	std::string rest_upper = rest;
+	std::transform(rest_upper.begin(), rest_upper.end(), rest_upper.begin(), ::toupper);
+	size_t i_where = rest_upper.find("WHERE");
+	if(i_where != std::string::npos){
+	    where = rest.substr(i_where + 5u);
+	    size_t i_first = where.find_first_not_of(" \t\n");
+	    size_t i_last = where.find_last_not_of(" \t\n;");
+	    where = (i_first == std::string::npos) ?
+		"" : where.substr(i_first, i_last - i_first + 1u);
+	}
+    }
+
+    //-------------------------------------------------------------------
+    // Get index information of all tables.
+    IndexInfo_t Fetcher::getIndexInfo(std::string& err_msg){
+	err_msg.clear();
+	ExecResult_t res = exec("SELECT * FROM sqlite_master WHERE type = 'table';",err_msg);
+	IndexInfo_t index_info;
+	if(!err_msg.empty()){
+	    return index_info;
+	}
+	auto i_res_end = res.result.end();
+	for(auto i_res = res.result.begin(); i_res != i_res_end; ++i_res){
+	    std::string tbl_name = i_res->at("name");
+	    IndexList_t a_list = getIndexInfo(tbl_name, err_msg);
+	    if(!err_msg.empty()){
+		break;
+	    }
+	    else if(!a_list.empty()){
+		index_info[tbl_name] = a_list;
+	    }
+	}
+	return index_info;
+    }
+
+    //-------------------------------------------------------------------
+    IndexList_t Fetcher::getIndexInfo(const std::string& table_name, std::string& err_msg){
+	err_msg.clear();
+	IndexList_t index_list;
+	ExecResult_t res = exec("PRAGMA index_list(" + table_name + ");", err_msg);
+	if(!err_msg.empty()){
+	    return index_list;
+	}
+	//index_list shows the newest index first
+	auto i_res_end = res.result.rend();
+	for(auto i_res = res.result.rbegin(); i_res != i_res_end; ++i_res){
+	    Index_t an_index;
+	    an_index.name = i_res->at("name");
+	    an_index.is_unique = (i_res->at("unique") == "1");
+	    an_index.origin = i_res->at("origin");
+
+	    //Expressions and conditions are given only by the original SQL.
+	    ExecResult_t sql_res = exec("SELECT sql FROM sqlite_master WHERE type = 'index' AND name = '"
+		    + an_index.name + "';", err_msg);
+	    if(!err_msg.empty()){
+		break;
+	    }
+	    std::string sql;
+	    if(!sql_res.result.empty()){
+		sql = sql_res.result.front().at("sql");
+	    }
+
+	    if(!sql.empty()){
+		parseIndexSql(sql, an_index.columns, an_index.where);
+	    }
+	    else{
+		//Indexes made by constraints have no SQL.
+		ExecResult_t info_res = exec("PRAGMA index_info(" + an_index.name + ");", err_msg);
+		if(!err_msg.empty()){
+		    break;
+		}
+		auto i_info_end = info_res.result.end();
+		for(auto i_info = info_res.result.begin(); i_info != i_info_end; ++i_info){
+		    an_index.columns.push_back(i_info->at("name"));
+		}
+	    }
+	    index_list.push_back(an_index);
+	}
+	return index_list;
+    }
+
+    //-------------------------------------------------------------------
+    // Generate queries to create indexes.
+    std::string Fetcher::genQueryCreateIndex(const IndexInfo_t& index_info, std::string& err_msg){
+	err_msg.clear();
+	std::string ret;
+	auto i_table_end = index_info.end();
+	for(auto i_table = index_info.begin(); i_table != i_table_end; ++i_table){
+	    auto i_idx_end = i_table->second.end();
+	    size_t n_auto = 0u;
+	    for(auto i_idx = i_table->second.begin(); i_idx != i_idx_end; ++i_idx){
+		if(i_idx->origin == "pk"){
+		    continue;
+		}
+		if(i_idx->columns.empty()){
+		    err_msg = "No columns in index " + i_idx->name + " of table " + i_table->first;
+		    return ret;
+		}
+		//names beginning with "sqlite_" are reserved
+		std::string name = i_idx->name;
+		if(name.empty() || name.compare(0u, 7u, "sqlite_") == 0){
+		    name = i_table->first + "_unique_" + std::to_string(n_auto++);
+		}
+		ret += (i_idx->is_unique ? "CREATE UNIQUE INDEX " : "CREATE INDEX ")
+		    + name + " ON " + i_table->first + "(";
+		auto i_col_end = i_idx->columns.end();
+		for(auto i_col = i_idx->columns.begin(); i_col != i_col_end; ++i_col){
+		    if(i_col != i_idx->columns.begin()){
+			ret += ", ";
+		    }
+		    ret += *i_col;
+		}
+		ret += ")";
+		if(!i_idx->where.empty()){
+		    ret += " WHERE " + i_idx->where;
+		}
+		ret += "; ";
+	    }
+	}
+	return ret;
+    }
+
+    //-------------------------------------------------------------------
+    // Generate queries to create tables and indexes.
+    std::string Fetcher::genQueryCreate(const TableInfo_t& table_info,
+	    const IndexInfo_t& index_info, std::string& err_msg){
+	std::string ret = genQueryCreate(table_info, err_msg);
+	if(!err_msg.empty()){
+	    return ret;
+	}
+	ret += genQueryCreateIndex(index_info, err_msg);
+	return ret;
+    }
+
     //-------------------------------------------------------------------
     // Generate queries to create table from a table info.
     std::string Fetcher::genQueryCreate(const TableInfo_t& table_info, std::string& err_msg){
-	err_msg.clear();
 	std::string ret;
+	appendQueryCreate(table_info, ret, err_msg);
+	return ret;
+    }
+
+    //-------------------------------------------------------------------
+    // Append queries to create table from a table info.
+    void Fetcher::appendQueryCreate(const TableInfo_t& table_info,
+	    std::string& query, std::string& err_msg){
+	err_msg.clear();
 	auto i_table_end = table_info.end();
 	for(auto i_table=table_info.begin(); i_table != i_table_end; ++i_table){
-	    //If this is a new table, update last_table_info_
-	    if(last_table_info_.find(i_table->first) == i_table_end){
-		last_table_info_[i_table->first] = i_table->second;
+	    //If this is a new table, keep it until it is found in the database
+	    if(findTableInfo(i_table->first) == nullptr){
+		declared_tables_[i_table->first] = i_table->second;
 	    }
-	    ret += "CREATE TABLE " + i_table->first + "(";
+	    query += "CREATE TABLE ";
+	    query += i_table->first;
+	    query += "(";
 	    auto i_col_end = i_table->second.end();
 	    bool is_first = true;
 	    for(auto i_col = i_table->second.begin(); i_col!=i_col_end; ++i_col){
 		if(!is_first){
-		    ret += ", ";
+		    query += ", ";
 		}
 		else{
 		    is_first = false;
 		}
-		ret += i_col->first + " " + i_col->second.typeStr();
+		query += i_col->first;
+		query += " ";
+		query += i_col->second.typeStr();
 	    }
-	    ret += "); ";
+	    query += "); ";
 	}
 	to_info_update_ = true;
-	return ret;
     }
 
     //-------------------------------------------------------------------
     // Generate queries to create table from a table info.
     std::string Fetcher::genQueryCreate(const Table_t& table, std::string& err_msg){
-	err_msg.clear();
 	std::string ret;
-	TableInfo_t a_table_info;
+	appendQueryCreate(table, ret, err_msg);
+	return ret;
+    }
+
+    //-------------------------------------------------------------------
+    // Append queries to create tables and insert columns.
+    void Fetcher::appendQueryCreate(const Table_t& table, std::string& query, std::string& err_msg){
+	err_msg.clear();
 	auto i_table_end = table.end();
 	for(auto i_table=table.begin(); i_table!=i_table_end; ++i_table){
 	    TableInfo_t a_table_info;
 	    a_table_info[i_table->first] = i_table->second.front();
-	    ret += genQueryCreate(a_table_info, err_msg);
+	    appendQueryCreate(a_table_info, query, err_msg);
 	    if(!err_msg.empty()){
 		break;
 	    }
 	    else{
-		ret += genQueryInsert(i_table->first, i_table->second, err_msg);
+		appendQueryInsert(i_table->first, i_table->second, query, err_msg);
 	    }
 
 	    if(!err_msg.empty()){
 		break;
 	    }
 	}
-
-	return ret;
     }
 
     //-------------------------------------------------------------------
@@ -1003,7 +4177,6 @@ namespace sf{
     std::string Fetcher::genQueryCreate(const std::string& name,
 	    const ColumnList_t& column_list, std::string& err_msg){
 	err_msg.clear();
-	std::string ret;
 	Table_t a_table;
 	a_table[name] = column_list;
 	return genQueryCreate(a_table, err_msg);
@@ -1018,8 +4191,8 @@ namespace sf{
 	std::string ret;
 	TableInfo_t a_table_info;
 	a_table_info[name] = column;
-	ret = genQueryCreate(a_table_info, err_msg);
-	ret += genQueryInsert(name, column, err_msg);
+	appendQueryCreate(a_table_info, ret, err_msg);
+	appendQueryInsert(name, column, ret, err_msg);
 	return ret;
     }
 
@@ -1027,82 +4200,139 @@ namespace sf{
     // Generate a query to insert a column.
     std::string Fetcher::genQueryInsert(const std::string& table_name,
 	    const Column_t& col, std::string& err_msg){
+	std::string ret;
+	appendQueryInsert(table_name, col, ret, err_msg);
+	return ret;
+    }
+
+    //-------------------------------------------------------------------
+    // Append a query to insert a column.
+    void Fetcher::appendQueryInsert(const std::string& table_name,
+	    const Column_t& col, std::string& query, std::string& err_msg){
 	err_msg.clear();
-	std::string ret = "INSERT INTO " + table_name + "(";
+	query += "INSERT INTO ";
+	query += table_name;
+	query += "(";
 	auto i_col_end = col.end();
 	bool is_first = true;
 	for(auto i_col = col.begin(); i_col != i_col_end; ++i_col){
 	    if(!is_first){
-		ret += ", ";
+		query += ", ";
 	    }
 	    else{
 		is_first = false;
 	    }
-	    ret += i_col->first;
+	    query += i_col->first;
         }
-	ret += ") VALUES(";
+	query += ") VALUES(";
 	is_first = true;
+	const Column_t* table_col = findTableInfo(table_name);
+	if(table_col == nullptr && refreshSchema(last_err_) == SQLITE_OK){
+	    table_col = findTableInfo(table_name);
+	}
 	for(auto i_col = col.begin(); i_col != i_col_end; ++i_col){
 	    if(!is_first){
-		ret += ", ";
+		query += ", ";
 	    }
 	    else{
 		is_first = false;
 	    }
-	    ret += i_col->second.str();
+	    appendValue(i_col->first, i_col->second, table_col, query);
         }
-	ret += "); ";
-	return ret;
+	query += "); ";
+    }
+
+    //-------------------------------------------------------------------
+    // Append a value as a literal, compressed if the column is COMPRESSED.
+    void Fetcher::appendValue(const std::string& name, const Data& value,
+	    const Column_t* table_col, std::string& query) const{
+	bool compressed = (value.flags() & COMPRESSED) != 0u;
+	if(!compressed && table_col != nullptr){
+	    auto i_data = table_col->find(name);
+	    compressed = i_data != table_col->end() && (i_data->second.flags() & COMPRESSED) != 0u;
+	}
+	if(compressed && (value.type() == TEXT || value.type() == BLOB)){
+	    value.appendCompressed(query, compress_threshold_);
+	}
+	else{
+	    value.appendStr(query);
+	}
+    }
+
+    //-------------------------------------------------------------------
+    void Fetcher::setCompressionThreshold(const size_t& bytes){
+	compress_threshold_ = bytes;
     }
 
     //-------------------------------------------------------------------
     //! Generate a query to insert a column.
     std::string Fetcher::genQueryInsert(const std::string& table_name,
 	    const ColumnList_t& col, std::string& err_msg){
+	std::string ret;
+	appendQueryInsert(table_name, col, ret, err_msg);
+	return ret;
+    }
+
+    //-------------------------------------------------------------------
+    // Append queries to insert columns.
+    void Fetcher::appendQueryInsert(const std::string& table_name,
+	    const ColumnList_t& col, std::string& query, std::string& err_msg){
 	err_msg.clear();
 	auto i_col_end = col.end();
-	std::string ret;
 	for(auto i_col = col.begin(); i_col != i_col_end; ++i_col){
-	    ret += genQueryInsert(table_name, *i_col, err_msg);
+	    appendQueryInsert(table_name, *i_col, query, err_msg);
 	    if(!err_msg.empty()){
 		break;
 	    }
 	}
-	return ret;
-
     }
 
     //-------------------------------------------------------------------
     // Generate a query to update a column.
     std::string Fetcher::genQueryUpdate(const std::string& table_name,
 	    const Column_t& col, std::string& err_msg){
+	std::string ret;
+	appendQueryUpdate(table_name, col, ret, err_msg);
+	return ret;
+    }
+
+    //-------------------------------------------------------------------
+    // Append a query to update a column.
+    void Fetcher::appendQueryUpdate(const std::string& table_name,
+	    const Column_t& col, std::string& query, std::string& err_msg){
 	err_msg.clear();
-	std::string ret = "UPDATE "+ table_name +" SET ";
-	bool has_id=false;
+	query += "UPDATE ";
+	query += table_name;
+	query += " SET ";
 	bool is_first = true;
 	auto i_col_end = col.end();
-	std::string key_str;
+	auto i_key = i_col_end;
+	const Column_t* table_col = findTableInfo(table_name);
+	if(table_col == nullptr && refreshSchema(last_err_) == SQLITE_OK){
+	    table_col = findTableInfo(table_name);
+	}
 	for(auto i_col=col.begin(); i_col != i_col_end; ++i_col){
 	    if((i_col->second.flags() & PRIMARY_KEY) != 0u){
-		key_str = " WHERE " + i_col->first
-		    + " = " + i_col->second.str();
-		has_id = true;
+		i_key = i_col;
 	    }
 	    else{
 		if(!is_first){
-		    ret += ", ";
+		    query += ", ";
 		}
 		else{
 		    is_first = false;
 		}
-		ret += i_col->first + " = " + i_col->second.str();
+		query += i_col->first;
+		query += " = ";
+		appendValue(i_col->first, i_col->second, table_col, query);
 	    }
 	}
 
-	if(has_id){
-	    ret += key_str;
+	if(i_key != i_col_end){
+	    query += " WHERE ";
+	    query += i_key->first;
+	    query += " = ";
+	    i_key->second.appendStr(query);
 	}
-
-	return ret;
     }
 }
@@ -14,6 +14,17 @@
 #include <vector>
 #include <list>
 #include <map>
+#include <functional>
+#include <unordered_map>
+#include <set>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <memory>
+#include <random>
+#include "Arena.hpp"
+#include "LockFreeQueue.hpp"
 
 //! SqliteFetcher name space
 namespace sf{
@@ -44,6 +55,11 @@ namespace sf{
     const KeyFlag_t AUTO_INCREMENT = 0b00000100;
     const KeyFlag_t NOT_NULL = 0b00001000;
     const KeyFlag_t DEFAULT = 0b00010000;
+    //! TEXT or BLOB values are compressed by zlib when they are inserted. The type is declared as "TEXT COMPRESSED".
+    const KeyFlag_t COMPRESSED = 0b00100000;
+
+    //! Default size of values in bytes from which values of COMPRESSED columns are compressed.
+    const size_t COMPRESS_THRESHOLD = 256u;
     
     //! Sepported types of SQL
     namespace sql_types{
@@ -127,6 +143,7 @@ namespace sf{
              * \li AUTO_INCREMENT
              * \li NOT_NULL
              * \li DEFAULT : If this flag is set, the contained value becomes default value when this is used in creating table.
+             * \li COMPRESSED : TEXT or BLOB values not shorter than COMPRESS_THRESHOLD are written in compressed form.
 	     */
 	    Data(sql_types::TypeStr_t type, const KeyFlag_t& flg=NORMAL);
 
@@ -159,12 +176,36 @@ namespace sf{
 		    this->setType(type_);
 		}
 
-	    //! Put value as a string. This is convenient when create query.
+	    //! Set a binary value in initializing without copying it.
+	    /*!
+	     * \param[in] value initial value. This is moved into Data.
+	     * \param[in] flg Flags for value. See [here](#flag_exp).
+	     */
+	    Data(Binary_t&& value, const KeyFlag_t& flg=NORMAL);
+
+	    //! Put value as a SQL literal. This is convenient when create query.
+	    /*!
+	     * TEXT is quoted with escaping, BLOB is in X'...' style and floating point values
+	     * have the shortest digits read back to the same value. A null value is NULL.
+	     */
 	    std::string str() const;
 
+	    //! Append value as a SQL literal to a buffer. See str().
+	    /*!
+	     * If the COMPRESSED flag is set, TEXT and BLOB values are appended as compressed BLOB literals.
+	     * \param[in,out] out buffer the literal is appended to.
+	     */
+	    void appendStr(std::string& out) const;
+
 	    //! Put type
 	    const Type_t& type() const;
 
+	    //! Size of the value in bytes.
+	    size_t size() const;
+
+	    //! Pointer to bytes of the value. nullptr if the value is empty.
+	    const uint8_t* bytes() const;
+
 	    /*! Put type in string style.
 	     * \param[in] print_flags If it is true, output string includes flag statements.
 	     * \retval TypeStr_t type and flag statements.
@@ -177,6 +218,7 @@ namespace sf{
 	    const KeyFlag_t& flags() const;
 
 	    /*! Get value.
+	     * A TEXT or BLOB value with the COMPRESSED flag is decompressed each time it is got.
 	     * \param[out] value output value.
 	     * \retval true success
 	     * \retval false type of value and that of Data are different.
@@ -184,6 +226,14 @@ namespace sf{
 	    template<typename T_OUT>
 		bool get(T_OUT& value) const;
 
+	    /*! Move binary value out of Data without copying it.
+	     * The value in Data becomes empty.
+	     * \param[out] value output value.
+	     * \retval true success
+	     * \retval false type of Data is not BLOB.
+	     */
+	    bool take(Binary_t& value);
+
 	    //! Set value
 	    /*!
 	     * This function set value and type similtaneously.
@@ -194,6 +244,12 @@ namespace sf{
 		void set(T_IN value);
 
 	    void set(const char* value);
+	    void set(const std::string& value);
+	    //! Set TEXT value. The input string is released.
+	    void set(std::string&& value);
+	    void set(const Binary_t& value);
+	    //! Set BLOB value without copying it.
+	    void set(Binary_t&& value);
 
 	    //! Set value
 	    /*!
@@ -218,6 +274,9 @@ namespace sf{
 	    bool get(void* value_ptr, const Type_t& type) const;
 	    void set(void* value_ptr, const Type_t& type, const uint32_t& size);
 	    bool change(void* value_ptr, const Type_t& type, const uint32_t& size);
+	    void appendCompressed(std::string& out, const size_t& threshold) const;
+	    friend class Fetcher;
+	    friend class SpilledResult;
 	    KeyFlag_t key_flg_{NORMAL};
 	    bool is_auto_{false};
 	    Binary_t data_;
@@ -344,6 +403,284 @@ namespace sf{
      */
     using TableInfo_t  = std::map<std::string, Column_t>;
 
+    class ArenaColumnList;
+
+    //! A value in ArenaColumnList.
+    /*!
+     * The bytes of the value are allocated from the arena of the list.
+     * This is valid while the arena is not released.
+     */
+    class ArenaData{
+	public:
+	    //! Put type
+	    const Type_t& type() const;
+
+	    //! true if the value is NULL.
+	    bool isNull() const;
+
+	    /*! Get value.
+	     * \param[out] value output value.
+	     * \retval true success
+	     * \retval false type of value and that of Data are different, or the value is NULL.
+	     */
+	    template<typename T_OUT>
+		bool get(T_OUT& value) const;
+
+	    //! Copy the value into Data.
+	    Data data() const;
+
+	    //! Size of the value in bytes.
+	    size_t size() const;
+
+	    //! Pointer to bytes of the value.
+	    const uint8_t* bytes() const;
+
+	private:
+	    friend class Fetcher;
+	    bool get(void* value_ptr, const Type_t& type) const;
+	    void set(const void* value_ptr, const size_t& size, ArenaColumnList& list);
+	    //values no longer than 8 bytes are held in place.
+	    union{
+		const uint8_t* data_;
+		uint8_t inline_[8];
+	    };
+	    uint32_t size_{0u};
+	    Type_t type_{NONE};
+	    bool is_null_{true};
+    };
+
+    //! Column list whose rows, strings and blobs are allocated from an Arena.
+    /*!
+     * This is an alternative of ColumnList_t for large results.
+     * Column names are held only once and each row is an array of ArenaData,
+     * so a result takes only a few allocations and is released in one shot.
+     *
+     * ```cpp
+     * ArenaColumnList res;
+     * fetcher.fetchColumn("SELECT name, age FROM user", res, err_msg);
+     * for(size_t k=0u; k<res.size(); ++k){
+     *     std::string name;
+     *     res.at(k, "name").get(name);
+     * }
+     * ```
+     */
+    class ArenaColumnList{
+	public:
+	    //! Constructor. The list has its own arena.
+	    ArenaColumnList();
+
+	    //! Constructor. The list uses a given arena.
+	    /*!
+	     * \param[in] arena Arena to allocate rows from. It must live longer than this list.
+	     *     clear() of this list doesn't release the arena.
+	     */
+	    explicit ArenaColumnList(Arena& arena);
+
+	    ArenaColumnList(const ArenaColumnList&) = delete;
+	    ArenaColumnList& operator=(const ArenaColumnList&) = delete;
+
+	    //! Number of rows.
+	    size_t size() const;
+
+	    //! true if there are no rows.
+	    bool empty() const;
+
+	    //! Names of columns.
+	    const std::vector<std::string>& names() const;
+
+	    //! Get a value by the row index and the column name.
+	    /*!
+	     * \exception std::out_of_range the column name is not in the list.
+	     */
+	    const ArenaData& at(const size_t& row, const std::string& name) const;
+
+	    //! Get a value by the row index and the column index.
+	    const ArenaData& at(const size_t& row, const size_t& col) const;
+
+	    //! Copy the rows into ColumnList_t.
+	    ColumnList_t toColumnList() const;
+
+	    //! Remove all rows. The own arena is released.
+	    void clear();
+
+	private:
+	    friend class Fetcher;
+	    friend class ArenaData;
+	    void setNames(const std::vector<std::string>& names);
+	    ArenaData* addRow();
+	    uint8_t* allocate(const size_t& size);
+
+	    Arena own_arena_;
+	    Arena* arena_;
+	    std::vector<std::string> names_;
+	    std::vector<ArenaData*> rows_;
+    };
+
+    //! A column of a columnar result.
+    /*!
+     * Values are held in a contiguous buffer of the storage type of the column:
+     * integers and BOOL in int64_t, FLOAT and DOUBLE in double, and TEXT and BLOB as bytes
+     * with offsets. Nulls are told by a validity bitmap, where bit (k % 64) of word (k / 64)
+     * is 1 if row k is not null. Buffer slots of nulls are 0 or empty.
+     * See Kernels.hpp for aggregations over the buffers.
+     */
+    class ColumnVector{
+	public:
+	    //! Name of the column.
+	    const std::string& name() const;
+
+	    //! Storage type. One of INT64, DOUBLE, TEXT, BLOB and NONE (all rows are null).
+	    const Type_t& type() const;
+
+	    //! Number of rows.
+	    size_t size() const;
+
+	    //! Number of null rows.
+	    size_t nullCount() const;
+
+	    //! true if a row is null.
+	    bool isNull(const size_t& row) const;
+
+	    //! Validity bitmap of (size() + 63) / 64 words.
+	    const uint64_t* validity() const;
+
+	    //! Buffer of integers. nullptr unless type() is INT64.
+	    const int64_t* ints() const;
+
+	    //! Buffer of real numbers. nullptr unless type() is DOUBLE.
+	    const double* reals() const;
+
+	    //! Get TEXT or BLOB of a row as bytes.
+	    /*!
+	     * \param[in] row index of the row.
+	     * \param[out] size size of the value in bytes.
+	     * \retval pointer to the bytes. nullptr unless type() is TEXT or BLOB.
+	     */
+	    const char* bytes(const size_t& row, size_t& size) const;
+
+	    //! Get TEXT of a row. Empty for nulls and other types.
+	    std::string text(const size_t& row) const;
+
+	    //! true if TEXT values are held as codes of a dictionary. See Fetcher::fetchColumnar().
+	    bool isDictionary() const;
+
+	    //! Buffer of codes of rows. nullptr unless isDictionary() is true.
+	    /*!
+	     * Codes are indexes of the dictionary in the order of first appearance.
+	     * The code of a null row is 0, so rows have to be masked by validity().
+	     */
+	    const uint32_t* codes() const;
+
+	    //! Number of distinct values in the dictionary. 0 unless isDictionary() is true.
+	    size_t dictionarySize() const;
+
+	    //! Get a value of the dictionary by the code.
+	    std::string dictionary(const size_t& code) const;
+
+	    //! Find the code of a value.
+	    /*!
+	     * \retval code of the value. -1 if the value is not in the dictionary.
+	     */
+	    int64_t findCode(const std::string& value) const;
+
+	private:
+	    friend class Fetcher;
+	    friend class ColumnarResult;
+	    void setType(const Type_t& type);
+	    void append(sqlite3_stmt* stmt, const int32_t& k);
+	    void reserve(const size_t& n_rows);
+	    void appendCode(const char* head, const size_t& size);
+
+	    std::string name_;
+	    Type_t type_{NONE};
+	    size_t size_{0u};
+	    size_t null_count_{0u};
+	    std::vector<uint64_t> validity_;
+	    std::vector<int64_t> ints_;
+	    std::vector<double> reals_;
+	    //offsets of rows, or of values of the dictionary
+	    std::vector<size_t> offsets_;
+	    std::string bytes_;
+	    bool use_dictionary_{false};
+	    std::vector<uint32_t> codes_;
+	    std::unordered_map<std::string, uint32_t> dictionary_index_;
+    };
+
+    //! Result of a query held column by column.
+    /*!
+     * This is fetched by Fetcher::fetchColumnar() for analytics over many rows.
+     * ```cpp
+     * ColumnarResult res;
+     * fetcher.fetchColumnar("SELECT height_cm FROM user", res, err_msg);
+     * const ColumnVector& height = res.column("height_cm");
+     * double mean = kernel::mean(height);
+     * ```
+     */
+    class ColumnarResult{
+	public:
+	    //! Number of rows.
+	    size_t size() const;
+
+	    //! Names of columns.
+	    std::vector<std::string> names() const;
+
+	    //! Get a column by the name.
+	    /*!
+	     * \exception std::out_of_range the column name is not in the result.
+	     */
+	    const ColumnVector& column(const std::string& name) const;
+
+	    //! Get a column by the index.
+	    const ColumnVector& column(const size_t& col) const;
+
+	    //! Remove all columns and rows.
+	    void clear();
+
+	private:
+	    friend class Fetcher;
+	    size_t size_{0u};
+	    std::vector<ColumnVector> columns_;
+    };
+
+    //! Index definition.
+    struct Index_t{
+	std::string name;//!< name of the index.
+	bool is_unique{false};//!< true for a UNIQUE index.
+	//! How the index was created.
+	/*!
+	 * \li "c" : CREATE INDEX statement.
+	 * \li "u" : UNIQUE constraint of the table.
+	 * \li "pk" : PRIMARY KEY constraint of the table.
+	 */
+	std::string origin{"c"};
+	//! Indexed columns or expressions in order.
+	/*! Each element can have COLLATE and ASC/DESC. (e.g. "age DESC", "lower(name)") */
+	std::vector<std::string> columns;
+	std::string where;//!< condition of a partial index. Empty if this is not a partial index.
+    };
+
+    //! List of indexes of a table.
+    using IndexList_t = std::vector<Index_t>;
+
+    //! Index information. This has table names as keys and lists of indexes of the tables.
+    /*! Examples for creating a IndexInfo_t.
+     *
+     * ```cpp
+     * Index_t idx_age;
+     * idx_age.name = "user_age";
+     * idx_age.columns = {"age", "height_cm DESC"};
+     * Index_t idx_name;
+     * idx_name.name = "user_name";
+     * idx_name.is_unique = true;
+     * idx_name.columns = {"lower(name)"};
+     * idx_name.where = "country IS NOT NULL";
+     *
+     * IndexInfo_t index_info;
+     * index_info["user"] = {idx_age, idx_name};
+     * ```
+     */
+    using IndexInfo_t = std::map<std::string, IndexList_t>;
+
     //! Element of Result_t
     using ResultElement_t = std::map<std::string,std::string>;
 
@@ -356,6 +693,228 @@ namespace sf{
 	Result_t result;//!< result of the query.
     };
 
+    //! A node of a query plan given by EXPLAIN QUERY PLAN.
+    struct PlanNode_t{
+	int32_t id{0};//!< id of the node.
+	int32_t parent{0};//!< id of the parent node. 0 means a root node.
+	std::string detail;//!< description of the step given by SQLite.
+	std::string table;//!< name of the scanned table. Empty if the step doesn't scan a table.
+	bool is_full_scan{false};//!< true if the step scans a whole table.
+	bool uses_temp_btree{false};//!< true if the step builds a temporary B-tree for ORDER BY, GROUP BY or DISTINCT.
+	std::vector<PlanNode_t> children;//!< child steps.
+    };
+
+    //! Output type of Fetcher::explain function
+    struct QueryPlan_t{
+	std::string in_sql;//!< SQL query input to get this plan.
+	std::vector<PlanNode_t> nodes;//!< root nodes of the plan tree.
+	bool has_full_scan{false};//!< true if any of the steps scans a whole table.
+	bool has_temp_btree{false};//!< true if any of the steps uses a temporary B-tree.
+	std::vector<std::string> scanned_tables;//!< tables scanned wholly.
+    };
+
+    //! Options of Fetcher::fetchColumnParallel function
+    struct ScanOption_t{
+	std::vector<std::string> columns;//!< columns to be selected. All columns are selected if it is empty.
+	std::string where;//!< condition of rows. Empty means all rows.
+	//! Integer column to split the table into ranges. This must be rowid or an INTEGER PRIMARY KEY.
+	std::string key_column{"rowid"};
+	size_t n_partitions{0u};//!< number of ranges read in parallel. If it is 0, the number of cores is used.
+	//! If true, the database is switched into WAL mode, so writers aren't blocked by the scan.
+	bool enable_wal{false};
+    };
+
+    //! Output type of Fetcher::fetchPage function
+    struct Page_t{
+	ColumnList_t rows;//!< rows in the page.
+	//! Opaque token to fetch the next page. Empty if this is the last page.
+	std::string token;
+    };
+
+    //! Statistics of the result cache of Fetcher.
+    struct CacheStats_t{
+	uint64_t hits{0u};//!< number of queries served from the cache.
+	uint64_t misses{0u};//!< number of queries run on the database.
+	uint64_t evictions{0u};//!< number of entries removed to keep the memory bound.
+	uint64_t invalidations{0u};//!< number of entries removed by changes of tables.
+	size_t entries{0u};//!< number of entries in the cache.
+	size_t bytes{0u};//!< estimated memory used by the entries.
+    };
+
+    //! Policy to retry when the database is locked by other connections.
+    /*!
+     * The n-th retry of a lock sleeps for min(initial_ms * multiplier^n, max_backoff_ms)
+     * scaled by a random factor in [1 - jitter, 1], so that writers waiting for the same lock
+     * don't retry at the same moment.
+     */
+    struct BusyPolicy_t{
+	int32_t timeout_ms{5000};//!< give up after waiting this long for a lock. 0 or less means no limit.
+	int32_t max_attempts{0};//!< give up after this number of retries. 0 or less means no limit.
+	double initial_ms{1.0};//!< sleep before the first retry.
+	double max_backoff_ms{100.0};//!< upper bound of a sleep.
+	double multiplier{2.0};//!< growth of sleeps.
+	double jitter{0.5};//!< fraction of a sleep chosen at random, from 0 to 1.
+    };
+
+    //! Statistics of waits for locks. See Fetcher::setBusyPolicy().
+    struct BusyStats_t{
+	uint64_t events{0u};//!< number of times a lock was busy.
+	uint64_t waits{0u};//!< number of sleeps before retries.
+	uint64_t giveups{0u};//!< number of times SQLITE_BUSY was returned.
+	uint64_t wait_us{0u};//!< total time of sleeps in microseconds.
+	uint64_t max_wait_us{0u};//!< longest time waited for a lock in microseconds.
+    };
+
+    //! Operations changing rows.
+    enum ChangeOp_t{
+	OP_INSERT,//!< a row is inserted.
+	OP_UPDATE,//!< a row is updated.
+	OP_DELETE//!< a row is deleted.
+    };
+
+    //! A change of a row.
+    struct ChangeEvent_t{
+	std::string table;//!< name of the changed table.
+	ChangeOp_t op{OP_INSERT};//!< operation.
+	int64_t rowid{0};//!< rowid of the changed row.
+    };
+
+    //! Changes committed in a transaction.
+    using ChangeBatch_t = std::vector<ChangeEvent_t>;
+
+    //! Handler to receive changes committed.
+    using ChangeHandler_t = std::function<void(const ChangeBatch_t&)>;
+
+    class Fetcher;
+
+    //! Stream to read and write a BLOB cell incrementally.
+    /*!
+     * This is opened by Fetcher::openBlob(). Contents are read and written in chunks
+     * without materializing the whole value. The size of the BLOB can't be changed by writing,
+     * so make a cell of the size first, e.g. by Fetcher::insertZeroBlob().
+     * A stream may outlive its Fetcher. Fetcher::close() and the destructor of Fetcher
+     * close streams opened by it, and they are not opened any more.
+     * ```cpp
+     * int64_t rowid = 0;
+     * fetcher.insertZeroBlob("artifact", {{"name", Data("model")}}, "body", file_size, rowid, err_msg);
+     * BlobStream blob;
+     * fetcher.openBlob("artifact", "body", rowid, true, blob, err_msg);
+     * for(size_t offset=0u; offset<file_size; offset+=chunk.size()){
+     *     ... read a chunk from the file ...
+     *     blob.write(offset, chunk.data(), chunk.size(), err_msg);
+     * }
+     * ```
+     */
+    class BlobStream{
+	public:
+	    BlobStream();
+
+	    //! Destructor. The stream is closed.
+	    ~BlobStream();
+
+	    BlobStream(const BlobStream&) = delete;
+	    BlobStream& operator=(const BlobStream&) = delete;
+	    BlobStream(BlobStream&& other);
+	    BlobStream& operator=(BlobStream&& other);
+
+	    //! true if the stream is opened.
+	    bool isOpened() const;
+
+	    //! Size of the BLOB in bytes.
+	    size_t size() const;
+
+	    //! Read a part of the BLOB.
+	    /*!
+	     * \param[in] offset offset in bytes to start reading at.
+	     * \param[out] buff buffer having size bytes at least.
+	     * \param[in] size number of bytes to read.
+	     * \param[out] err_msg error message.
+	     * \retval SQLITE_OK success.
+	     * \retval others Some errors occured. See [here](https://www.sqlite.org/rescode.html)
+	     */
+	    int32_t read(const size_t& offset, uint8_t* buff, const size_t& size, std::string& err_msg);
+
+	    //! Read a part of the BLOB.
+	    /*!
+	     * \param[in] offset offset in bytes to start reading at.
+	     * \param[in] size number of bytes to read. It is shortened at the end of the BLOB.
+	     * \param[out] buff buffer resized to the read bytes.
+	     * \param[out] err_msg error message.
+	     * \retval SQLITE_OK success.
+	     * \retval others Some errors occured. See [here](https://www.sqlite.org/rescode.html)
+	     */
+	    int32_t read(const size_t& offset, const size_t& size, Binary_t& buff, std::string& err_msg);
+
+	    //! Write a part of the BLOB.
+	    /*!
+	     * The update hook of SQLite isn't called for BLOB streams, so cached results of the table
+	     * are invalidated here and an OP_UPDATE event of the row is given to subscribers of changes.
+	     * \param[in] offset offset in bytes to start writing at.
+	     * \param[in] buff bytes to be written.
+	     * \param[in] size number of bytes to write. offset + size must not exceed size().
+	     * \param[out] err_msg error message.
+	     * \retval SQLITE_OK success.
+	     * \retval others Some errors occured. See [here](https://www.sqlite.org/rescode.html)
+	     */
+	    int32_t write(const size_t& offset, const uint8_t* buff, const size_t& size, std::string& err_msg);
+
+	    //! Move the stream to the same column of another row.
+	    /*!
+	     * This is faster than opening a new stream.
+	     * \param[in] rowid rowid of the row.
+	     * \param[out] err_msg error message.
+	     * \retval SQLITE_OK success.
+	     * \retval others Some errors occured. See [here](https://www.sqlite.org/rescode.html)
+	     */
+	    int32_t reopen(const int64_t& rowid, std::string& err_msg);
+
+	    //! Close the stream.
+	    int32_t close();
+
+	private:
+	    friend class Fetcher;
+	    Fetcher* fetcher_{nullptr};
+	    sqlite3* db_ptr_{nullptr};
+	    sqlite3_blob* blob_ptr_{nullptr};
+	    std::string table_name_;
+	    int64_t rowid_{0};
+    };
+
+    //! Handler to receive warning messages from Fetcher.
+    using WarningHandler_t = std::function<void(const std::string&)>;
+
+    //! Handler to receive progress of long operations.
+    /*!
+     * The first argument is the amount done and the second is the total,
+     * in units of the operation (rows or pages).
+     */
+    using ProgressHandler_t = std::function<void(const int64_t&, const int64_t&)>;
+
+    class VirtualTableRegistry;
+    class SpilledResult;
+    struct SchemaSnapshot_t;
+    class SchemaSlot;
+
+    //! Limits of memory used by results of queries. See Fetcher::setMemoryLimit().
+    struct MemoryLimit_t{
+	size_t soft_bytes{0u};//!< a warning is given once per query whose result grows beyond this. 0 means no limit.
+	size_t hard_bytes{0u};//!< a query fails when its result grows beyond this. 0 means no limit.
+	//! Passed to sqlite3_soft_heap_limit64(), which is shared by all connections of the process.
+	//! Negative leaves it unchanged.
+	int64_t engine_soft_heap_bytes{-1};
+	WarningHandler_t handler;//!< handler to receive warnings. If it is empty, warnings are put into std::cerr.
+    };
+
+    //! Statistics of memory used by results of queries.
+    struct MemoryStats_t{
+	size_t last_result_bytes{0u};//!< estimated memory of the last result.
+	size_t peak_result_bytes{0u};//!< largest estimated memory of a result.
+	uint64_t soft_exceeded{0u};//!< number of results beyond the soft limit.
+	uint64_t hard_aborted{0u};//!< number of queries failed by the hard limit.
+	int64_t engine_bytes{0};//!< memory used by SQLite in the process, by sqlite3_memory_used().
+	int64_t engine_peak_bytes{0};//!< peak memory used by SQLite in the process.
+    };
+
     //! Fetcher class
     /*! Fetcher is a powerful class to fetch and convert result from SQLite to STL container.
      * This also can generate SQL queries form STL tables and columns.
@@ -374,6 +933,12 @@ namespace sf{
 	     */
 	    Fetcher(const std::string& db_name); 
 
+	    //! Destructor. Close database.
+	    ~Fetcher();
+
+	    Fetcher(const Fetcher&) = delete;
+	    Fetcher& operator=(const Fetcher&) = delete;
+
 	    //! Open database.
 	    /*!
 	      \param[in] db_name name of a database to be opened.
@@ -392,21 +957,60 @@ namespace sf{
 		    const int32_t& flags= (SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE), 
 		    const char* zVfs=nullptr);
 
+	    //! Open an in-memory read replica of a database.
+	    /*!
+	     * The database file is loaded into an in-memory database by the backup API,
+	     * and queries are served from the copy. The copy is read only, and the file remains
+	     * to be written by other connections.
+	     * The copy is reloaded when "PRAGMA data_version" of the file is changed.
+	     * It is checked at the beginning of reads once refresh_ms has passed since the last check.
+	     * \param[in] db_name name of a database file.
+	     * \param[out] err_msg error message.
+	     * \param[in] refresh_ms interval of checks in milli seconds.
+	     *     0 checks at every read, and a negative value disables checks except refreshReplica().
+	     * \retval SQLITE_OK Successfully loaded the database.
+	     * \retval others Some errors occured. See [here](https://www.sqlite.org/rescode.html)
+	     */
+	    int32_t openReplica(const std::string& db_name, std::string& err_msg,
+		    const int32_t& refresh_ms=1000);
+
+	    //! Reload the in-memory replica if the database file is changed.
+	    /*!
+	     * \param[out] err_msg error message.
+	     * \param[in] force reload even if the file is not changed.
+	     * \retval SQLITE_OK success.
+	     * \retval others Some errors occured. See [here](https://www.sqlite.org/rescode.html)
+	     */
+	    int32_t refreshReplica(std::string& err_msg, const bool& force=false);
+
 	    //! Close database
 	    /*!
 	     * In case of creating a new database, please close database with this function
-	     * in advance of open a new database.
+	     * in advance of open a new database. BLOB streams opened by openBlob() are closed.
 	     */
 	    int32_t close(std::string err_msg);
 
 	    //! Execute SQLite query
 	    /*!
+	     * Values of COMPRESSED columns are not decompressed, and a compressed TEXT value
+	     * is read as an empty string. Use fetchColumn() to read them.
 	     * \param[in] query SQLite query to be executed
 	     * \param[out] err_msg error message
 	     * \retval result result of the input query.
 	     */
 	    ExecResult_t exec(const std::string& query, std::string& err_msg);
 
+	    //! Execute SQLite query
+	    /*!
+	     * Rows are put into the given container directly, so the result is never copied.
+	     * \param[in] query SQLite query to be executed
+	     * \param[out] res result of the input query. Rows in it are removed first.
+	     * \param[out] err_msg error message
+	     * \retval SQLITE_OK Successfully executed.
+	     * \retval others Some errors occured. See [here](https://www.sqlite.org/rescode.html)
+	     */
+	    int32_t exec(const std::string& query, ExecResult_t& res, std::string& err_msg);
+
 	    //! Execute SQLite query
 	    /*!
 	     * This function execute mltiple SQL query separately and results are packed into std::list.
@@ -430,14 +1034,339 @@ namespace sf{
 	     */
 	    std::string dump(const std::list<ExecResult_t>& res_list) const;
 
+	    //! true if a transaction is open on the connection. See Transaction.hpp.
+	    bool inTransaction() const;
+
 	    //! Fetch column list from result of executed query for SELECT.
 	    /*!
+	     * Types of values are those of the first table after FROM.
+	     * If a subquery is there, types are taken from declared types of the result.
 	     * \param[in] query SQL query to select values.
 	     * \param[out] err_msg Error message. In case of fething successfully, this becomes empty.
 	     * \retval list of columns selected by queries.
 	     */
 	    ColumnList_t fetchColumn(const std::string& query, std::string& err_msg);
 
+	    //! Fetch column list into a given container.
+	    /*!
+	     * \param[in] query SQL query to select values.
+	     * \param[out] col list of columns selected by queries. Rows in it are removed first.
+	     * \param[out] err_msg Error message. In case of fething successfully, this becomes empty.
+	     */
+	    void fetchColumn(const std::string& query, ColumnList_t& col, std::string& err_msg);
+
+	    //! Fetch column list into an arena from result of executed query for SELECT.
+	    /*!
+	     * Values are read directly from the statement and converted
+	     * according to declared types of the columns.
+	     * \param[in] query SQL query to select values.
+	     * \param[out] col list of columns selected by queries. Rows in it are removed first.
+	     * \param[out] err_msg Error message. In case of fething successfully, this becomes empty.
+	     */
+	    void fetchColumn(const std::string& query, ArenaColumnList& col, std::string& err_msg);
+
+	    //! Fetch a result of a query column by column.
+	    /*!
+	     * The storage type of a column is decided by its declared type,
+	     * or by the first non-null value for expressions. Other values are converted to it.
+	     * Values of COMPRESSED columns are held as stored, i.e. the header and the zlib stream.
+	     * \param[in] query query to select rows.
+	     * \param[out] res result.
+	     * \param[out] err_msg Error message. In case of fething successfully, this becomes empty.
+	     */
+	    void fetchColumnar(const std::string& query, ColumnarResult& res, std::string& err_msg);
+
+	    //! Fetch a result column by column with TEXT columns encoded by dictionaries.
+	    /*!
+	     * Each distinct TEXT value of a column is held once, and rows have codes of 4 bytes.
+	     * This fits columns of few distinct values like country codes.
+	     * ```cpp
+	     * fetcher.fetchColumnar("SELECT country, height_cm FROM user", res, err_msg, true);
+	     * const ColumnVector& country = res.column("country");
+	     * int64_t jp = country.findCode("JP");
+	     * kernel::Mask_t is_jp;
+	     * kernel::filter(country.codes(), country.validity(), country.size(),
+	     *     [jp](const uint32_t& c){ return c == jp; }, is_jp);
+	     * ```
+	     * \param[in] query query to select rows.
+	     * \param[out] res result.
+	     * \param[out] err_msg Error message. In case of fething successfully, this becomes empty.
+	     * \param[in] dictionary_text true to encode TEXT columns by dictionaries.
+	     */
+	    void fetchColumnar(const std::string& query, ColumnarResult& res, std::string& err_msg,
+		    const bool& dictionary_text);
+
+	    //! Fetch column list which moves to a temporary file when it exceeds a memory budget.
+	    /*!
+	     * Rows are kept in memory until their estimated size exceeds the budget,
+	     * then they and the following rows are written to a temporary file. See SpilledResult.hpp.
+	     * \param[in] query SQL query to select values.
+	     * \param[out] res result. Rows in it are removed first.
+	     * \param[out] err_msg Error message. In case of fething successfully, this becomes empty.
+	     * \param[in] memory_budget bytes of rows kept in memory.
+	     * If it is 0, the soft limit of setMemoryLimit() is used, and rows never move if it is also 0.
+	     */
+	    void fetchColumn(const std::string& query, SpilledResult& res, std::string& err_msg,
+		    const size_t& memory_budget=0u);
+
+	    //! Fetch column list from a large table in parallel.
+	    /*!
+	     * The table is split into ranges of the key column by its MIN and MAX.
+	     * Each range is read on its own read-only connection in parallel, 
+	     * and results are concatenated in the order of the key.
+	     * In-memory databases are read on this connection serially.
+	     * \param[in] table_name name of the table to be read.
+	     * \param[out] col list of columns. Rows in it are removed first.
+	     * \param[out] err_msg Error message. In case of fething successfully, this becomes empty.
+	     * \param[in] option columns, condition and the way of partitioning.
+	     */
+	    void fetchColumnParallel(const std::string& table_name, ColumnList_t& col,
+		    std::string& err_msg, const ScanOption_t& option=ScanOption_t());
+
+	    //! Fetch a page of a table by keyset pagination.
+	    /*!
+	     * Rows are sorted by the key column and a page is selected by
+	     * "WHERE key > ? ORDER BY key LIMIT ?" with a cached prepared statement,
+	     * so a deep page costs the same as the first one.
+	     * ```cpp
+	     * Page_t page;
+	     * do{
+	     *     page = fetcher.fetchPage("user", "ID", 100u, page.token, err_msg);
+	     *     ...
+	     * }while(!page.token.empty());
+	     * ```
+	     * \param[in] table_name name of the table.
+	     * \param[in] key_column column to sort rows. Values of it must be unique and not NULL.
+	     * \param[in] page_size maximum number of rows in a page.
+	     * \param[in] token token given by the previous page. Empty for the first page.
+	     * \param[out] err_msg Error message. In case of fething successfully, this becomes empty.
+	     * \retval page rows in the page and the token for the next page.
+	     */
+	    Page_t fetchPage(const std::string& table_name, const std::string& key_column,
+		    const size_t& page_size, const std::string& token, std::string& err_msg);
+
+	    //! Enable the cache of results of fetchColumn() and fetchPage().
+	    /*!
+	     * Results are cached by the query and its parameters, and least recently used ones
+	     * are evicted to keep the memory bound.
+	     * An entry is invalidated when a table read by it is changed on this connection,
+	     * which is told by the update hook and by writes or DDL statements given to exec().
+	     * Commits by other connections are told by "PRAGMA data_version" and clear the whole cache.
+	     * Results read in a transaction are not cached, because they may be rolled back.
+	     * \param[in] max_bytes upper bound of estimated memory used by cached results.
+	     */
+	    void enableResultCache(const size_t& max_bytes);
+
+	    //! Disable the result cache and remove all of its entries.
+	    void disableResultCache();
+
+	    //! Remove all entries of the result cache.
+	    void clearResultCache();
+
+	    //! Statistics of the result cache.
+	    CacheStats_t cacheStats() const;
+
+	    //! Retry when the database is locked by other connections.
+	    /*!
+	     * Without a policy, queries fail with SQLITE_BUSY at once.
+	     * The policy is kept when the database is opened again.
+	     * ```cpp
+	     * BusyPolicy_t policy;
+	     * policy.timeout_ms = 2000;
+	     * policy.max_backoff_ms = 50.0;
+	     * fetcher.setBusyPolicy(policy);
+	     * ```
+	     * \param[in] policy timeout, limit of retries and backoff.
+	     */
+	    void setBusyPolicy(const BusyPolicy_t& policy);
+
+	    //! Remove the busy policy. Queries fail with SQLITE_BUSY at once.
+	    void clearBusyPolicy();
+
+	    //! Statistics of waits for locks.
+	    BusyStats_t busyStats() const;
+
+	    //! Reset statistics of waits for locks.
+	    void resetBusyStats();
+
+	    //! Limit memory used by results of queries.
+	    /*!
+	     * Memory of rows, strings and blobs is estimated while a result of exec(), fetchColumn(),
+	     * fetchPage() or fetchColumnar() is read. When it grows beyond the soft limit a warning is given,
+	     * and when it grows beyond the hard limit the query is stopped, the partial result is released
+	     * and SQLITE_NOMEM is returned with an error message.
+	     * Use fetchPage() to read a result larger than the limit.
+	     * ```cpp
+	     * MemoryLimit_t limit;
+	     * limit.soft_bytes = 64u << 20;
+	     * limit.hard_bytes = 512u << 20;
+	     * fetcher.setMemoryLimit(limit);
+	     * ```
+	     * \param[in] limit limits. Zeros remove the limits.
+	     */
+	    void setMemoryLimit(const MemoryLimit_t& limit);
+
+	    //! Statistics of memory used by results.
+	    MemoryStats_t memoryStats() const;
+
+	    //! Reset statistics of memory used by results.
+	    void resetMemoryStats();
+
+	    //! Subscribe changes of rows.
+	    /*!
+	     * Changes on this connection are collected by the update hook, and are delivered
+	     * in a batch per transaction only after it is committed. Changes in a transaction
+	     * rolled back are discarded. Changes by other connections aren't delivered.
+	     * A batch is held while COMMIT fails, e.g. with SQLITE_BUSY, and the transaction is open.
+	     * Batches are delivered by dispatchChanges(). exec() calls it at the end
+	     * unless automatic dispatch is disabled by setChangeDispatch().
+	     * ```cpp
+	     * int32_t id = fetcher.subscribeChanges([](const ChangeBatch_t& batch){
+	     *     for(auto& e : batch){ ... }
+	     * });
+	     * ```
+	     * \param[in] handler Handler to receive batches of changes.
+	     * \retval id of the subscription to unsubscribe.
+	     */
+	    int32_t subscribeChanges(ChangeHandler_t handler);
+
+	    //! Unsubscribe changes of rows.
+	    /*!
+	     * \param[in] id id given by subscribeChanges().
+	     */
+	    void unsubscribeChanges(const int32_t& id);
+
+	    //! Deliver committed changes to subscribers.
+	    /*!
+	     * This can be called from a thread other than that of this connection,
+	     * e.g. a thread of a replication component.
+	     * \retval number of delivered batches.
+	     */
+	    size_t dispatchChanges();
+
+	    //! Set whether exec() delivers committed changes at the end.
+	    /*!
+	     * \param[in] automatic If false, changes are queued until dispatchChanges() is called.
+	     */
+	    void setChangeDispatch(const bool& automatic);
+
+	    //! Open a stream of a BLOB cell.
+	    /*!
+	     * \param[in] table_name name of the table.
+	     * \param[in] column_name name of the BLOB column.
+	     * \param[in] rowid rowid of the row.
+	     * \param[in] writable true to open the stream for writing.
+	     * \param[out] blob opened stream.
+	     * \param[out] err_msg error message.
+	     * \retval SQLITE_OK success.
+	     * \retval others Some errors occured. See [here](https://www.sqlite.org/rescode.html)
+	     */
+	    int32_t openBlob(const std::string& table_name, const std::string& column_name,
+		    const int64_t& rowid, const bool& writable, BlobStream& blob, std::string& err_msg);
+
+	    //! Insert rows with a prepared statement.
+	    /*!
+	     * Cells are bound to a cached INSERT statement row by row, so no value is encoded into queries.
+	     * Run this in a transaction for many rows. See also IngestPipeline.hpp.
+	     * Values of COMPRESSED columns are compressed as genQueryInsert() does.
+	     * \param[in] table_name name of the table.
+	     * \param[in] columns names of columns.
+	     * \param[in] cells values of n_rows * columns.size() cells in the order of rows and columns.
+	     * \param[in] n_rows number of rows.
+	     * \param[out] err_msg error message.
+	     * \retval SQLITE_OK success.
+	     * \retval others Some errors occured. Rows before the failed one are inserted.
+	     */
+	    int32_t insertRows(const std::string& table_name, const std::vector<std::string>& columns,
+		    const Data* cells, const size_t& n_rows, std::string& err_msg);
+
+	    //! Insert a row with a BLOB filled with zeros.
+	    /*!
+	     * Values are bound to a prepared statement, and the BLOB is bound by sqlite3_bind_zeroblob,
+	     * so no value is encoded into the query. Contents of the BLOB are written by openBlob().
+	     * \param[in] table_name name of the table.
+	     * \param[in] col values of other columns.
+	     * \param[in] blob_column name of the BLOB column.
+	     * \param[in] blob_size size of the BLOB in bytes.
+	     * \param[out] rowid rowid of the inserted row.
+	     * \param[out] err_msg error message.
+	     * \retval SQLITE_OK success.
+	     * \retval others Some errors occured. See [here](https://www.sqlite.org/rescode.html)
+	     */
+	    int32_t insertZeroBlob(const std::string& table_name, const Column_t& col,
+		    const std::string& blob_column, const size_t& blob_size,
+		    int64_t& rowid, std::string& err_msg);
+
+	    //! Copy a table into another database.
+	    /*!
+	     * Rows are copied inside SQLite by "INSERT ... SELECT" through ATTACH,
+	     * so values are not converted to Data. If the destination table doesn't exist,
+	     * it is created from getTableInfo() and getIndexInfo() of this database,
+	     * and the indexes are created after the rows are copied.
+	     * Rows are copied in chunks of rowid in a transaction to report progress.
+	     * If dst is in a transaction, they are copied in a savepoint of it instead,
+	     * and a table of another database can't be copied since ATTACH fails in transactions.
+	     * \param[in] src_table name of the table in this database.
+	     * \param[in] dst destination. This can be this Fetcher to copy a table in a database.
+	     * \param[in] dst_table name of the table in the destination.
+	     * \param[out] err_msg error message.
+	     * \param[in] filter condition to select rows, e.g. "age >= 20". Empty to copy all rows.
+	     * \param[in] progress handler called after each chunk with copied and total rows.
+	     * \retval SQLITE_OK success.
+	     * \retval others Some errors occured. See [here](https://www.sqlite.org/rescode.html)
+	     */
+	    int32_t copyTable(const std::string& src_table, Fetcher& dst,
+		    const std::string& dst_table, std::string& err_msg,
+		    const std::string& filter="", const ProgressHandler_t& progress=nullptr);
+
+	    //! Copy the whole database into another database.
+	    /*!
+	     * Pages are copied by the online backup API and the destination is overwritten.
+	     * \param[in] dst destination.
+	     * \param[out] err_msg error message.
+	     * \param[in] progress handler called after each step with copied and total pages.
+	     * \retval SQLITE_OK success.
+	     * \retval others Some errors occured. See [here](https://www.sqlite.org/rescode.html)
+	     */
+	    int32_t copyDatabase(Fetcher& dst, std::string& err_msg,
+		    const ProgressHandler_t& progress=nullptr);
+
+	    //! Back up the database into a file on a background thread.
+	    /*!
+	     * Pages are copied by the online backup API in steps of pages_per_step,
+	     * sleeping sleep_ms between steps so that I/O of other queries is not blocked.
+	     * The source connection is this one, so changes made through this Fetcher
+	     * during the backup are copied without restarting it.
+	     * Only one backup runs at a time. Closing this Fetcher cancels the running backup.
+	     * The background thread shares the connection, so it must be opened in the serialized mode,
+	     * i.e. not with SQLITE_OPEN_NOMUTEX. Otherwise SQLITE_MISUSE is returned.
+	     * \param[in] path path of the backup file. It is overwritten.
+	     * \param[out] err_msg error message in starting the backup.
+	     * \param[in] pages_per_step number of pages copied in a step. Negative to copy all in one step.
+	     * \param[in] sleep_ms sleep between steps in milli seconds.
+	     * \param[in] progress handler called after each step with copied and total pages.
+	     *     It is called on the background thread.
+	     * \retval SQLITE_OK the backup started.
+	     * \retval others Some errors occured. See [here](https://www.sqlite.org/rescode.html)
+	     */
+	    int32_t backupTo(const std::string& path, std::string& err_msg,
+		    const int32_t& pages_per_step=256, const int32_t& sleep_ms=10,
+		    const ProgressHandler_t& progress=nullptr);
+
+	    //! Wait for the backup started by backupTo() to finish.
+	    /*!
+	     * \param[out] err_msg error message of the backup.
+	     * \retval SQLITE_OK the backup is completed or no backup was started.
+	     * \retval others Some errors occured. See [here](https://www.sqlite.org/rescode.html)
+	     */
+	    int32_t waitBackup(std::string& err_msg);
+
+	    //! Cancel the backup started by backupTo() and wait for the thread to stop.
+	    void cancelBackup();
+
+	    //! true while a backup is running.
+	    bool isBackingUp() const;
+
 	    //! Get table information
 	    /*!
 	     * Get table information of existing tables.
@@ -446,6 +1375,120 @@ namespace sf{
 	     *     corresponded to tables in database.
 	     */
 	    TableInfo_t getTableInfo(std::string& err_msg);
+
+	    //! Register a C++ callable as a SQL function.
+	    /*!
+	     * Types of arguments and the result are taken from the callable.
+	     * bool, integers, float, double, std::string, Binary_t and Data are available.
+	     * Arguments are converted by SQLite, e.g. NULL becomes 0, so take Data to tell NULL.
+	     * An exception thrown by the callable becomes an error of the query.
+	     * ```cpp
+	     * fetcher.registerFunction("distance_km",
+	     *     [](double lat0, double lon0, double lat1, double lon1){ return ...; }, err_msg, true);
+	     * fetcher.fetchColumn("SELECT * FROM shop WHERE distance_km(lat, lon, 35.68, 139.77) < 1.0", err_msg);
+	     * ```
+	     * \param[in] name name of the function in SQL.
+	     * \param[in] func callable. It is copied and held until the connection is closed.
+	     * \param[out] err_msg error message.
+	     * \param[in] deterministic true if the result depends only on arguments.
+	     *     Deterministic functions can be used in indexes and CHECK constraints.
+	     *     SQLite may reuse their results, so leave this false for callables with state.
+	     * \retval SQLITE_OK success.
+	     * \retval others Some errors occured. See [here](https://www.sqlite.org/rescode.html)
+	     */
+	    template<typename F>
+		int32_t registerFunction(const std::string& name, F func,
+			std::string& err_msg, const bool& deterministic=false);
+
+	    //! Register C++ callables as a SQL aggregate function.
+	    /*!
+	     * A state of T_STATE is made by its default constructor for each group.
+	     * ```cpp
+	     * struct Score_t{ double sum{0.0}; int64_t n{0}; };
+	     * fetcher.registerAggregate<Score_t>("mean_score",
+	     *     [](Score_t& s, double v){ s.sum += v; ++s.n; },
+	     *     [](const Score_t& s){ return s.n == 0 ? 0.0 : s.sum / s.n; }, err_msg);
+	     * ```
+	     * \param[in] name name of the function in SQL.
+	     * \param[in] step callable taking a state and arguments for each row.
+	     * \param[in] final_func callable taking the state and returning the result.
+	     * \param[out] err_msg error message.
+	     * \param[in] deterministic true if the result depends only on arguments.
+	     * \retval SQLITE_OK success.
+	     * \retval others Some errors occured. See [here](https://www.sqlite.org/rescode.html)
+	     */
+	    template<typename T_STATE, typename F_STEP, typename F_FINAL>
+		int32_t registerAggregate(const std::string& name, F_STEP step, F_FINAL final_func,
+			std::string& err_msg, const bool& deterministic=false);
+
+	    //! Expose rows in memory to SQL as a read-only table.
+	    /*!
+	     * The table is made in the temp schema by the virtual table module "sf_memory",
+	     * so it can be joined with tables in the database.
+	     * Values are read from rows without copying, so rows must live and must not be changed
+	     * until detachTable() or close().
+	     * Rows are sorted by a column at the first time the column is constrained
+	     * with =, <, <=, > or >=, and the sorted order is used after that.
+	     * ```cpp
+	     * ColumnList_t visits = ...;
+	     * fetcher.attachTable("visit", {{"user_id", Data(INT64)}, {"page", Data(TEXT)}}, visits, err_msg);
+	     * ExecResult_t res = fetcher.exec("SELECT u.name, v.page FROM user u JOIN visit v ON v.user_id = u.ID", err_msg);
+	     * ```
+	     * fetchColumn() takes types from the first table after FROM, so use exec() for joins.
+	     * \param[in] name name of the table.
+	     * \param[in] schema names and types of columns. Values are not used.
+	     * \param[in] rows rows of the table. Missing values are NULL.
+	     * \param[out] err_msg error message.
+	     * \retval SQLITE_OK success.
+	     * \retval others Some errors occured. See [here](https://www.sqlite.org/rescode.html)
+	     */
+	    int32_t attachTable(const std::string& name, const Column_t& schema,
+		    const ColumnList_t& rows, std::string& err_msg);
+
+	    //! Expose a columnar result to SQL as a read-only table.
+	    /*!
+	     * Types of columns are INTEGER, REAL, TEXT or BLOB from types of ColumnVector.
+	     * See the other attachTable().
+	     * \param[in] name name of the table.
+	     * \param[in] res result. It must live until detachTable() or close().
+	     * \param[out] err_msg error message.
+	     * \retval SQLITE_OK success.
+	     * \retval others Some errors occured. See [here](https://www.sqlite.org/rescode.html)
+	     */
+	    int32_t attachTable(const std::string& name, const ColumnarResult& res, std::string& err_msg);
+
+	    //! Drop a table made by attachTable().
+	    /*!
+	     * \param[in] name name of the table.
+	     * \param[out] err_msg error message.
+	     * \retval SQLITE_OK success.
+	     * \retval others Some errors occured. See [here](https://www.sqlite.org/rescode.html)
+	     */
+	    int32_t detachTable(const std::string& name, std::string& err_msg);
+
+	    //! Get the query plan of a query.
+	    /*!
+	     * Run "EXPLAIN QUERY PLAN" for the query and form the output into a tree.
+	     * Steps scanning a whole table and steps using temporary B-trees are flagged.
+	     * \param[in] query SQL query to be explained. Only the first statement is explained.
+	     * \param[out] err_msg error message.
+	     * \retval plan Query plan of the input query.
+	     */
+	    QueryPlan_t explain(const std::string& query, std::string& err_msg);
+
+	    //! Enable warnings about full table scans.
+	    /*!
+	     * While this is enabled, exec() and fetchColumn() check the plan of each statement
+	     * before running it, and warn if it scans a table having more rows than the threshold.
+	     * This is for debugging. It costs an additional COUNT(*) per scanned table.
+	     * \param[in] row_threshold Scans of tables having rows no more than this are ignored.
+	     * \param[in] handler Handler to receive warnings. If it is empty, warnings are put into std::cerr.
+	     */
+	    void enableScanWarning(const int64_t& row_threshold=0,
+		    WarningHandler_t handler=nullptr);
+
+	    //! Disable warnings about full table scans.
+	    void disableScanWarning();
 	    
 	    //! Get table information
 	    /*!
@@ -457,6 +1500,23 @@ namespace sf{
 	     */
 	    Column_t getTableInfo(const std::string& table_name, std::string& err_msg);
 
+	    //! Get index information
+	    /*!
+	     * Get definitions of indexes of existing tables.
+	     * \param[out] err_msg error message
+	     * \retval Index information. Tables without indexes are not included.
+	     */
+	    IndexInfo_t getIndexInfo(std::string& err_msg);
+
+	    //! Get index information
+	    /*!
+	     * Get definitions of indexes of an existing table.
+	     * \param[in] table_name name of target table
+	     * \param[out] err_msg error message
+	     * \retval List of indexes of the table.
+	     */
+	    IndexList_t getIndexInfo(const std::string& table_name, std::string& err_msg);
+
 	    //! Generate queries to create table from a table info.
 	    /*!
 	     * \param[in] table_info Table information containing definition of tables.
@@ -465,6 +1525,26 @@ namespace sf{
 	     */
 	    std::string genQueryCreate(const TableInfo_t& table_info, std::string& err_msg);
 
+	    //! Generate queries to create tables and their indexes.
+	    /*!
+	     * \param[in] table_info Table information containing definition of tables.
+	     * \param[in] index_info Index information containing definition of indexes.
+	     * \param[out] err_msg Error message.
+	     * \retval Query message to create tables and indexes.
+	     */
+	    std::string genQueryCreate(const TableInfo_t& table_info,
+		    const IndexInfo_t& index_info, std::string& err_msg);
+
+	    //! Generate queries to create indexes.
+	    /*!
+	     * Indexes made by PRIMARY KEY constraints are skipped.
+	     * Indexes made by UNIQUE constraints are created as UNIQUE indexes with new names.
+	     * \param[in] index_info Index information containing definition of indexes.
+	     * \param[out] err_msg Error message.
+	     * \retval Query message to create indexes.
+	     */
+	    std::string genQueryCreateIndex(const IndexInfo_t& index_info, std::string& err_msg);
+
 	    //! Generate queries to create tables and insert columns from Table_t
 	    /*!
 	     * \param[in] table Table containing columns.
@@ -526,18 +1606,188 @@ namespace sf{
 	    std::string genQueryUpdate(const std::string& table_name,
 		    const Column_t& col, std::string& err_msg);
 
+	    //! Set the size of values from which values of COMPRESSED columns are compressed.
+	    /*!
+	     * Insert and update queries compress TEXT and BLOB values of columns
+	     * which are declared as COMPRESSED in the table or have the COMPRESSED flag.
+	     * Shorter values and values which don't get smaller are written as they are.
+	     * \param[in] bytes size in bytes. The default is COMPRESS_THRESHOLD.
+	     */
+	    void setCompressionThreshold(const size_t& bytes);
+
+	    //! Append queries to create tables to a buffer.
+	    /*!
+	     * Same as genQueryCreate(), but the queries are appended to a buffer given by the caller.
+	     * The buffer can be cleared and reused for many queries without reallocation.
+	     * \param[in] table_info Table information containing definition of tables.
+	     * \param[in,out] query buffer the queries are appended to.
+	     * \param[out] err_msg Error message.
+	     */
+	    void appendQueryCreate(const TableInfo_t& table_info,
+		    std::string& query, std::string& err_msg);
+
+	    //! Append queries to create tables and insert columns to a buffer.
+	    /*!
+	     * \param[in] table Table containing columns.
+	     * \param[in,out] query buffer the queries are appended to.
+	     * \param[out] err_msg Error message.
+	     */
+	    void appendQueryCreate(const Table_t& table, std::string& query, std::string& err_msg);
+
+	    //! Append a query to insert a column to a buffer.
+	    /*!
+	     * \param[in] table_name name of a table to be inserted a column into.
+	     * \param[in] col A column to be inserted into the table.
+	     * \param[in,out] query buffer the query is appended to.
+	     * \param[out] err_msg Error message.
+	     */
+	    void appendQueryInsert(const std::string& table_name,
+		    const Column_t& col, std::string& query, std::string& err_msg);
+
+	    //! Append queries to insert columns to a buffer.
+	    /*!
+	     * \param[in] table_name name of a table to be inserted columns into.
+	     * \param[in] col Columns to be inserted into the table.
+	     * \param[in,out] query buffer the queries are appended to.
+	     * \param[out] err_msg Error message.
+	     */
+	    void appendQueryInsert(const std::string& table_name,
+		    const ColumnList_t& col, std::string& query, std::string& err_msg);
+
+	    //! Append a query to update a column to a buffer.
+	    /*!
+	     * \param[in] table_name name of a table to be updated.
+	     * \param[in] col An updated column.
+	     * \param[in,out] query buffer the query is appended to.
+	     * \param[out] err_msg Error message.
+	     */
+	    void appendQueryUpdate(const std::string& table_name,
+		    const Column_t& col, std::string& query, std::string& err_msg);
+
 	private:
-	    ExecResult_t last_exec_result_;
-	    TableInfo_t last_table_info_;
+	    friend class BlobStream;
+	    struct CacheEntry_t{
+		ColumnList_t rows;
+		std::string token;
+		std::set<std::string> tables;
+		size_t bytes{0u};
+		std::list<std::string>::iterator i_lru;
+	    };
+	    struct SavepointMark_t{
+		std::string name;
+		size_t n_changes;
+	    };
+
+	    void fetchColumnUncached(const std::string& query, ColumnList_t& col, std::string& err_msg);
+	    void fetchColumnByStatement(const std::string& query, ColumnList_t& col, std::string& err_msg);
+	    bool findCache(const std::string& key, ColumnList_t& rows, std::string& token);
+	    void addCache(const std::string& key, const std::string& query,
+		    const ColumnList_t& rows, const std::string& token);
+	    void eraseCache(const std::string& key);
+	    void invalidateTable(const std::string& table_name);
+	    static void updateHook(void* fetcher_ptr, int op,
+		    const char* db_name, const char* table_name, sqlite3_int64 rowid);
+	    static int commitHook(void* fetcher_ptr);
+	    static void rollbackHook(void* fetcher_ptr);
+	    void publishChanges();
+	    static int writeAuthorizer(void* targets_ptr, int action,
+		    const char* arg1, const char* arg2, const char*, const char*);
+	    void markSavepoint(const char* op, const char* name);
+	    void noteBlobWrite(const std::string& table_name, const int64_t& rowid);
+	    static int busyHandler(void* fetcher_ptr, int count);
+	    static int execCallback(void* context_ptr, int argc, char** argv, char** col_name);
+	    void beginResult();
+	    bool chargeResult(const size_t& bytes);
+	    int32_t endResult(std::string& err_msg);
+	    void applyBusyPolicy();
+	    void setHooks();
+	    void syncReplica();
+	    int32_t loadReplica(std::string& err_msg);
+	    int32_t refreshSchema(std::string& err_msg);
+	    const Column_t* findTableInfo(const std::string& table_name) const;
+	    void appendValue(const std::string& name, const Data& value,
+		    const Column_t* table_col, std::string& query) const;
+	    TableInfo_t scanTableInfo(const std::string& master, std::string& err_msg);
+	    bool pragmaInt(const std::string& query, int64_t& value);
+	    void warnScan(const std::string& query);
+	    sqlite3_stmt* cachedStatement(const std::string& query, std::string& err_msg);
+	    void finalizeStatements();
+	    void readRow(sqlite3_stmt* stmt, const std::vector<Type_t>& types,
+		    const Column_t* table_col, Column_t& a_col, const int32_t& n_col);
+
+	    std::shared_ptr<const SchemaSnapshot_t> schema_;
+	    SchemaSlot* schema_slot_{nullptr};
+	    int64_t temp_schema_version_{-1};
+	    TableInfo_t temp_tables_;
+	    TableInfo_t declared_tables_;
 	    std::string last_err_;
 
 	    bool is_opened_{false};
 	    bool to_info_update_{false};
 	    sqlite3* db_ptr_{nullptr};
 
+	    std::map<std::string, sqlite3_stmt*> stmt_cache_;
+
+	    std::unique_ptr<VirtualTableRegistry> vtab_registry_;
+
+	    std::thread backup_thread_;
+	    std::atomic<bool> backup_running_{false};
+	    std::atomic<bool> backup_cancel_{false};
+	    int32_t backup_result_{SQLITE_OK};
+	    std::string backup_err_;
+
+	    sqlite3* replica_src_ptr_{nullptr};
+	    int32_t replica_refresh_ms_{-1};
+	    int64_t replica_version_{-1};
+	    std::chrono::steady_clock::time_point replica_checked_;
+
+	    bool cache_enabled_{false};
+	    size_t cache_max_bytes_{0u};
+	    int64_t data_version_{-1};
+	    std::unordered_map<std::string, CacheEntry_t> cache_;
+	    std::list<std::string> cache_lru_;
+	    std::map<std::string, std::set<std::string>> cache_tables_;
+	    CacheStats_t cache_stats_;
+
+	    bool busy_enabled_{false};
+	    BusyPolicy_t busy_policy_;
+	    std::chrono::steady_clock::time_point busy_started_;
+	    std::minstd_rand busy_rng_;
+	    std::atomic<uint64_t> busy_events_{0u};
+	    std::atomic<uint64_t> busy_waits_{0u};
+	    std::atomic<uint64_t> busy_giveups_{0u};
+	    std::atomic<uint64_t> busy_wait_us_{0u};
+	    std::atomic<uint64_t> busy_max_us_{0u};
+
+	    MemoryLimit_t memory_limit_;
+	    MemoryStats_t memory_stats_;
+	    size_t result_bytes_{0u};
+	    bool result_warned_{false};
+	    bool result_aborted_{false};
+
+	    size_t compress_threshold_{COMPRESS_THRESHOLD};
+
+	    std::map<int32_t, ChangeHandler_t> change_handlers_;
+	    std::mutex change_mtx_;
+	    int32_t next_change_id_{0};
+	    std::atomic<bool> feed_enabled_{false};
+	    bool auto_dispatch_{true};
+	    ChangeBatch_t pending_changes_;
+	    ChangeBatch_t committing_changes_;
+	    ChangeBatch_t carried_changes_;
+	    std::vector<SavepointMark_t> savepoints_;
+
+	    std::set<BlobStream*> blob_streams_;
+	    LockFreeQueue<ChangeBatch_t> committed_changes_{1024u};
+
+	    bool warn_scan_{false};
+	    int64_t scan_row_threshold_{0};
+	    WarningHandler_t warning_handler_;
+
 
 	    
     };
     
 }
+#include "SqlFunction.hpp"
 #endif
@@ -0,0 +1,111 @@
+/*
+ * ThreadPool.hpp
+ *
+ * Copyright (C) 2020 Taishi Ueda <taishi.ueda@gmail.com>
+ *
+ * Distributed under terms of the MIT license.
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#ifndef SF_THREAD_POOL_HPP
+#define SF_THREAD_POOL_HPP
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <vector>
+
+//! SqliteFetcher name space
+namespace sf{
+
+    //! Fixed size thread pool.
+    /*!
+     * ```cpp
+     * ThreadPool pool(4);
+     * std::future<int> f = pool.submit([](){ return 1; });
+     * int one = f.get();
+     * ```
+     */
+    class ThreadPool{
+	public:
+	    //! Constructor. Threads are started.
+	    /*!
+	     * \param[in] n_threads number of threads. If it is 0, the number of cores is used.
+	     */
+	    explicit ThreadPool(const size_t& n_threads=0u){
+		size_t n = n_threads;
+		if(n == 0u){
+		    n = std::max(1u, std::thread::hardware_concurrency());
+		}
+		for(size_t k=0u; k<n; ++k){
+		    threads_.emplace_back([this](){ work(); });
+		}
+	    }
+
+	    //! Destructor. Waits for queued tasks to finish.
+	    ~ThreadPool(){
+		{
+		    std::lock_guard<std::mutex> lock(mtx_);
+		    stop_ = true;
+		}
+		cv_.notify_all();
+		for(auto i_th = threads_.begin(); i_th != threads_.end(); ++i_th){
+		    i_th->join();
+		}
+	    }
+
+	    ThreadPool(const ThreadPool&) = delete;
+	    ThreadPool& operator=(const ThreadPool&) = delete;
+
+	    //! Number of threads.
+	    size_t size() const{
+		return threads_.size();
+	    }
+
+	    //! Queue a task.
+	    /*!
+	     * \param[in] func task without arguments.
+	     * \retval future to get the return value of the task.
+	     */
+	    template<typename F>
+		std::future<typename std::result_of<F()>::type> submit(F func){
+		    using Ret_t = typename std::result_of<F()>::type;
+		    auto task = std::make_shared<std::packaged_task<Ret_t()>>(func);
+		    std::future<Ret_t> ret = task->get_future();
+		    {
+			std::lock_guard<std::mutex> lock(mtx_);
+			tasks_.push([task](){ (*task)(); });
+		    }
+		    cv_.notify_one();
+		    return ret;
+		}
+
+	private:
+	    void work(){
+		while(true){
+		    std::function<void()> task;
+		    {
+			std::unique_lock<std::mutex> lock(mtx_);
+			cv_.wait(lock, [this](){ return stop_ || !tasks_.empty();});
+			if(tasks_.empty()){
+			    return;
+			}
+			task = std::move(tasks_.front());
+			tasks_.pop();
+		    }
+		    task();
+		}
+	    }
+
+	    std::vector<std::thread> threads_;
+	    std::queue<std::function<void()>> tasks_;
+	    std::mutex mtx_;
+	    std::condition_variable cv_;
+	    bool stop_{false};
+    };
+}
+#endif
@@ -0,0 +1,282 @@
+/*
+ * Transaction.cpp
+ *
+ * Copyright (C) 2020 Taishi Ueda <taishi.ueda@gmail.com>
+ *
+ * Distributed under terms of the MIT license.
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#include "Transaction.hpp"
+#include "Literal.hpp"
+#include <exception>
+
+namespace sf{
+
+    //-------------------------------------------------------------------
+    // Execute a query without results.
+    static int32_t execQuery(Fetcher& fetcher, const std::string& query, std::string& err_msg){
+	ExecResult_t res;
+	int32_t ret = fetcher.exec(query, res, err_msg);
+	if(ret == SQLITE_OK && !err_msg.empty()){
+	    ret = SQLITE_ERROR;
+	}
+	return ret;
+    }
+
+    //##############################################################
+    // Transaction
+    //-------------------------------------------------------------------
+    Transaction::Transaction(Fetcher& fetcher, const TransactionMode_t& mode, const size_t& batch_bytes)
+	:fetcher_(fetcher), batch_bytes_(batch_bytes){
+	    const char* query = "BEGIN DEFERRED;";
+	    if(mode == TX_IMMEDIATE){
+		query = "BEGIN IMMEDIATE;";
+	    }
+	    else if(mode == TX_EXCLUSIVE){
+		query = "BEGIN EXCLUSIVE;";
+	    }
+	    is_active_ = (execQuery(fetcher_, query, err_msg_) == SQLITE_OK);
+	}
+
+    //-------------------------------------------------------------------
+    Transaction::~Transaction(){
+	if(!is_active_){
+	    return;
+	}
+	std::string err_msg;
+	if(std::uncaught_exception() || commit(err_msg) != SQLITE_OK){
+	    rollback(err_msg);
+	}
+    }
+
+    //-------------------------------------------------------------------
+    bool Transaction::isActive() const{
+	return is_active_;
+    }
+
+    //-------------------------------------------------------------------
+    const std::string& Transaction::errMsg() const{
+	return err_msg_;
+    }
+
+    //-------------------------------------------------------------------
+    Fetcher& Transaction::fetcher(){
+	return fetcher_;
+    }
+
+    //-------------------------------------------------------------------
+    ExecResult_t Transaction::exec(const std::string& query, std::string& err_msg){
+	ExecResult_t res;
+	if(flush(err_msg) == SQLITE_OK){
+	    fetcher_.exec(query, res, err_msg);
+	}
+	if(!err_msg.empty()){
+	    err_msg_ = err_msg;
+	}
+	return res;
+    }
+
+    //-------------------------------------------------------------------
+    int32_t Transaction::insert(const std::string& table_name, const Column_t& col, std::string& err_msg){
+	if(checkActive(err_msg) != SQLITE_OK){
+	    return SQLITE_MISUSE;
+	}
+	fetcher_.appendQueryInsert(table_name, col, batch_, err_msg);
+	return err_msg.empty() ? flushIfFull(err_msg) : SQLITE_ERROR;
+    }
+
+    //-------------------------------------------------------------------
+    int32_t Transaction::insert(const std::string& table_name, const ColumnList_t& col, std::string& err_msg){
+	err_msg.clear();
+	for(auto i_col=col.begin(); i_col!=col.end(); ++i_col){
+	    int32_t ret = insert(table_name, *i_col, err_msg);
+	    if(ret != SQLITE_OK){
+		return ret;
+	    }
+	}
+	return SQLITE_OK;
+    }
+
+    //-------------------------------------------------------------------
+    int32_t Transaction::update(const std::string& table_name, const Column_t& col, std::string& err_msg){
+	if(checkActive(err_msg) != SQLITE_OK){
+	    return SQLITE_MISUSE;
+	}
+	fetcher_.appendQueryUpdate(table_name, col, batch_, err_msg);
+	return err_msg.empty() ? flushIfFull(err_msg) : SQLITE_ERROR;
+    }
+
+    //-------------------------------------------------------------------
+    // Rows given after BEGIN failed or after the end would be dropped silently.
+    int32_t Transaction::checkActive(std::string& err_msg){
+	err_msg.clear();
+	if(is_active_){
+	    return SQLITE_OK;
+	}
+	err_msg = "The transaction is not active";
+	if(!err_msg_.empty()){
+	    err_msg += ": " + err_msg_;
+	}
+	return SQLITE_MISUSE;
+    }
+
+    //-------------------------------------------------------------------
+    int32_t Transaction::flushIfFull(std::string& err_msg){
+	return (batch_.size() < batch_bytes_) ? SQLITE_OK : flush(err_msg);
+    }
+
+    //-------------------------------------------------------------------
+    int32_t Transaction::flush(std::string& err_msg){
+	err_msg.clear();
+	if(!is_active_){
+	    err_msg = "The transaction is not active";
+	    err_msg_ = err_msg;
+	    return SQLITE_MISUSE;
+	}
+	if(batch_.empty()){
+	    return SQLITE_OK;
+	}
+	int32_t ret = execQuery(fetcher_, batch_, err_msg);
+	batch_.clear();
+	if(ret != SQLITE_OK){
+	    err_msg_ = err_msg;
+	}
+	return ret;
+    }
+
+    //-------------------------------------------------------------------
+    int32_t Transaction::commit(std::string& err_msg){
+	int32_t ret = flush(err_msg);
+	if(ret == SQLITE_MISUSE){
+	    return ret;
+	}
+	if(ret != SQLITE_OK){
+	    std::string rollback_msg;
+	    finish("ROLLBACK;", rollback_msg);
+	    return ret;
+	}
+	ret = finish("COMMIT;", err_msg);
+	if(ret != SQLITE_OK && !fetcher_.inTransaction()){
+	    //SQLite has already rolled back
+	    is_active_ = false;
+	}
+	return ret;
+    }
+
+    //-------------------------------------------------------------------
+    int32_t Transaction::rollback(std::string& err_msg){
+	err_msg.clear();
+	batch_.clear();
+	if(!is_active_){
+	    err_msg = "The transaction is not active";
+	    return SQLITE_MISUSE;
+	}
+	return finish("ROLLBACK;", err_msg);
+    }
+
+    //-------------------------------------------------------------------
+    int32_t Transaction::finish(const char* query, std::string& err_msg){
+	int32_t ret = execQuery(fetcher_, query, err_msg);
+	if(ret == SQLITE_OK){
+	    is_active_ = false;
+	}
+	else{
+	    err_msg_ = err_msg;
+	}
+	return ret;
+    }
+
+    //##############################################################
+    // Savepoint
+    //-------------------------------------------------------------------
+    Savepoint::Savepoint(Transaction& tx, const std::string& name)
+	:fetcher_(tx.fetcher()), tx_ptr_(&tx), name_(name){
+	    begin();
+	}
+
+    //-------------------------------------------------------------------
+    Savepoint::Savepoint(Fetcher& fetcher, const std::string& name)
+	:fetcher_(fetcher), name_(name){
+	    begin();
+	}
+
+    //-------------------------------------------------------------------
+    void Savepoint::begin(){
+	if(flushParent(err_msg_) == SQLITE_OK){
+	    is_active_ = (execQuery(fetcher_, "SAVEPOINT " + quoted() + ";", err_msg_) == SQLITE_OK);
+	}
+    }
+
+    //-------------------------------------------------------------------
+    Savepoint::~Savepoint(){
+	if(!is_active_){
+	    return;
+	}
+	std::string err_msg;
+	if(std::uncaught_exception() || release(err_msg) != SQLITE_OK){
+	    rollback(err_msg);
+	}
+    }
+
+    //-------------------------------------------------------------------
+    bool Savepoint::isActive() const{
+	return is_active_;
+    }
+
+    //-------------------------------------------------------------------
+    const std::string& Savepoint::errMsg() const{
+	return err_msg_;
+    }
+
+    //-------------------------------------------------------------------
+    std::string Savepoint::quoted() const{
+	std::string ret;
+	literal::appendName(ret, name_);
+	return ret;
+    }
+
+    //-------------------------------------------------------------------
+    int32_t Savepoint::flushParent(std::string& err_msg){
+	err_msg.clear();
+	return (tx_ptr_ == nullptr) ? SQLITE_OK : tx_ptr_->flush(err_msg);
+    }
+
+    //-------------------------------------------------------------------
+    int32_t Savepoint::release(std::string& err_msg){
+	if(!is_active_){
+	    err_msg = "The savepoint is not active";
+	    return SQLITE_MISUSE;
+	}
+	int32_t ret = flushParent(err_msg);
+	if(ret == SQLITE_OK){
+	    ret = execQuery(fetcher_, "RELEASE " + quoted() + ";", err_msg);
+	}
+	if(ret == SQLITE_OK){
+	    is_active_ = false;
+	}
+	else{
+	    err_msg_ = err_msg;
+	}
+	return ret;
+    }
+
+    //-------------------------------------------------------------------
+    int32_t Savepoint::rollback(std::string& err_msg){
+	if(!is_active_){
+	    err_msg = "The savepoint is not active";
+	    return SQLITE_MISUSE;
+	}
+	//queries batched after the savepoint are discarded as well
+	std::string flush_msg;
+	flushParent(flush_msg);
+	int32_t ret = execQuery(fetcher_, "ROLLBACK TO " + quoted() + "; RELEASE " + quoted() + ";", err_msg);
+	if(ret == SQLITE_OK){
+	    is_active_ = false;
+	}
+	else{
+	    err_msg_ = err_msg;
+	}
+	return ret;
+    }
+}
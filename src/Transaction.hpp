@@ -0,0 +1,181 @@
+/*
+ * Transaction.hpp
+ *
+ * Copyright (C) 2020 Taishi Ueda <taishi.ueda@gmail.com>
+ *
+ * Distributed under terms of the MIT license.
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#ifndef SF_TRANSACTION_HPP
+#define SF_TRANSACTION_HPP
+#include "SqliteFetcher.hpp"
+
+//! SqliteFetcher name space
+namespace sf{
+
+    //! Ways to begin a transaction. See [here](https://www.sqlite.org/lang_transaction.html)
+    enum TransactionMode_t{
+	TX_DEFERRED,//!< locks are taken when the database is read or written first.
+	TX_IMMEDIATE,//!< the write lock is taken at the beginning.
+	TX_EXCLUSIVE//!< the write lock is taken and other connections can't read.
+    };
+
+    //! Transaction guard.
+    /*!
+     * A transaction begins in the constructor. It is committed by commit() or the destructor,
+     * and it is rolled back by rollback() or the destructor called in unwinding by an exception.
+     * Queries made by insert() and update() are batched and executed together,
+     * so rows are written without a sync of the journal for each row.
+     * ```cpp
+     * {
+     *     Transaction tx(fetcher, TX_IMMEDIATE);
+     *     for(const Column_t& a_row : rows){
+     *         tx.insert("user", a_row, err_msg);
+     *     }
+     *     ExecResult_t res = tx.exec("SELECT count(*) AS n FROM user", err_msg);
+     *     tx.commit(err_msg);
+     * }
+     * ```
+     */
+    class Transaction{
+	public:
+	    //! Begin a transaction.
+	    /*!
+	     * See isActive() and errMsg() for the result.
+	     * \param[in] fetcher connection.
+	     * \param[in] mode way to begin the transaction.
+	     * \param[in] batch_bytes batched queries are executed when they exceed this size.
+	     */
+	    Transaction(Fetcher& fetcher, const TransactionMode_t& mode=TX_DEFERRED,
+		    const size_t& batch_bytes=1u << 20);
+
+	    //! Commit the transaction, or roll it back if an exception is thrown.
+	    ~Transaction();
+
+	    Transaction(const Transaction&) = delete;
+	    Transaction& operator=(const Transaction&) = delete;
+
+	    //! true until the transaction is committed or rolled back.
+	    bool isActive() const;
+
+	    //! Error message of the last failed operation, including the beginning.
+	    const std::string& errMsg() const;
+
+	    //! Connection of the transaction.
+	    Fetcher& fetcher();
+
+	    //! Execute a query in the transaction. Batched queries are executed before it.
+	    /*!
+	     * \param[in] query SQL query.
+	     * \param[out] err_msg error message.
+	     * \retval result of the query.
+	     */
+	    ExecResult_t exec(const std::string& query, std::string& err_msg);
+
+	    //! Add a query to insert a row into the batch. See Fetcher::genQueryInsert().
+	    /*!
+	     * \param[in] table_name name of the table.
+	     * \param[in] col row.
+	     * \param[out] err_msg error message. Errors of batched queries are also put here.
+	     * \retval SQLITE_OK success.
+	     * \retval SQLITE_MISUSE the transaction failed to begin or has ended.
+	     * \retval others Some errors occured. See [here](https://www.sqlite.org/rescode.html)
+	     */
+	    int32_t insert(const std::string& table_name, const Column_t& col, std::string& err_msg);
+
+	    //! Add queries to insert rows into the batch.
+	    int32_t insert(const std::string& table_name, const ColumnList_t& col, std::string& err_msg);
+
+	    //! Add a query to update rows into the batch. See Fetcher::genQueryUpdate().
+	    int32_t update(const std::string& table_name, const Column_t& col, std::string& err_msg);
+
+	    //! Execute batched queries.
+	    int32_t flush(std::string& err_msg);
+
+	    //! Execute batched queries and commit the transaction.
+	    /*!
+	     * The transaction is rolled back if the batched queries fail.
+	     * \param[out] err_msg error message.
+	     * \retval SQLITE_OK success.
+	     * \retval others Some errors occured. See [here](https://www.sqlite.org/rescode.html)
+	     */
+	    int32_t commit(std::string& err_msg);
+
+	    //! Discard batched queries and roll back the transaction.
+	    int32_t rollback(std::string& err_msg);
+
+	private:
+	    int32_t finish(const char* query, std::string& err_msg);
+	    int32_t flushIfFull(std::string& err_msg);
+	    int32_t checkActive(std::string& err_msg);
+
+	    Fetcher& fetcher_;
+	    bool is_active_{false};
+	    size_t batch_bytes_;
+	    std::string batch_;
+	    std::string err_msg_;
+    };
+
+    //! Savepoint guard.
+    /*!
+     * A savepoint is made in the constructor. It is released by release() or the destructor,
+     * and it is rolled back by rollback() or the destructor called in unwinding by an exception.
+     * Savepoints can be nested in a transaction or in other savepoints.
+     * Outside a transaction, the outermost savepoint begins a transaction.
+     * ```cpp
+     * Transaction tx(fetcher);
+     * tx.insert("user", a_row, err_msg);
+     * {
+     *     Savepoint sp(tx, "height");
+     *     tx.update("user", new_height, err_msg);
+     *     if(!is_valid){
+     *         sp.rollback(err_msg);//the insertion is kept
+     *     }
+     * }
+     * tx.commit(err_msg);
+     * ```
+     */
+    class Savepoint{
+	public:
+	    //! Make a savepoint in a transaction. Batched queries of the transaction are executed first.
+	    /*!
+	     * \param[in] tx transaction.
+	     * \param[in] name name of the savepoint.
+	     */
+	    Savepoint(Transaction& tx, const std::string& name);
+
+	    //! Make a savepoint on a connection.
+	    Savepoint(Fetcher& fetcher, const std::string& name);
+
+	    //! Release the savepoint, or roll it back if an exception is thrown.
+	    ~Savepoint();
+
+	    Savepoint(const Savepoint&) = delete;
+	    Savepoint& operator=(const Savepoint&) = delete;
+
+	    //! true until the savepoint is released or rolled back.
+	    bool isActive() const;
+
+	    //! Error message of the last failed operation, including making the savepoint.
+	    const std::string& errMsg() const;
+
+	    //! Release the savepoint. Changes after it are kept in the transaction.
+	    int32_t release(std::string& err_msg);
+
+	    //! Undo changes after the savepoint and release it.
+	    int32_t rollback(std::string& err_msg);
+
+	private:
+	    void begin();
+	    std::string quoted() const;
+	    int32_t flushParent(std::string& err_msg);
+
+	    Fetcher& fetcher_;
+	    Transaction* tx_ptr_{nullptr};
+	    std::string name_;
+	    bool is_active_{false};
+	    std::string err_msg_;
+    };
+}
+#endif
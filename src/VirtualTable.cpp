@@ -0,0 +1,551 @@
+/*
+ * VirtualTable.cpp
+ *
+ * Copyright (C) 2020 Taishi Ueda <taishi.ueda@gmail.com>
+ *
+ * Distributed under terms of the MIT license.
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#include "VirtualTable.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+
+namespace sf{
+
+    using Source_t = VirtualTableRegistry::Source_t;
+
+    //-------------------------------------------------------------------
+    // A value in a cell compared in the order of SQLite:
+    // NULL < numbers < TEXT < BLOB, and TEXT and BLOB by bytes.
+    struct Cell_t{
+	int32_t kind{0};
+	bool is_int{false};
+	int64_t i{0};
+	double d{0.0};
+	const char* p{nullptr};
+	size_t n{0u};
+    };
+
+    static const int32_t CELL_NULL = 0;
+    static const int32_t CELL_NUMBER = 1;
+    static const int32_t CELL_TEXT = 2;
+    static const int32_t CELL_BLOB = 3;
+
+    //-------------------------------------------------------------------
+    static int32_t compareCell(const Cell_t& a, const Cell_t& b){
+	if(a.kind != b.kind){
+	    return (a.kind < b.kind) ? -1 : 1;
+	}
+	switch(a.kind){
+	    case CELL_NUMBER:
+		if(a.is_int && b.is_int){
+		    return (a.i < b.i) ? -1 : ((a.i > b.i) ? 1 : 0);
+		}
+		else{
+		    double x = a.is_int ? static_cast<double>(a.i) : a.d;
+		    double y = b.is_int ? static_cast<double>(b.i) : b.d;
+		    return (x < y) ? -1 : ((x > y) ? 1 : 0);
+		}
+	    case CELL_TEXT:
+	    case CELL_BLOB:{
+			       int32_t ret = std::memcmp(a.p, b.p, std::min(a.n, b.n));
+			       if(ret != 0){
+				   return ret;
+			       }
+			       return (a.n < b.n) ? -1 : ((a.n > b.n) ? 1 : 0);
+			   }
+	    default:
+		return 0;
+	}
+    }
+
+    //-------------------------------------------------------------------
+    // Cell of a row of a container.
+    static Cell_t cellAt(const Source_t& source, const size_t& row, const size_t& col){
+	Cell_t cell;
+	if(source.columnar != nullptr){
+	    const ColumnVector& vec = source.columnar->column(col);
+	    if(vec.isNull(row)){
+		return cell;
+	    }
+	    switch(vec.type()){
+		case INT64:
+		    cell.kind = CELL_NUMBER;
+		    cell.is_int = true;
+		    cell.i = vec.ints()[row];
+		    break;
+		case DOUBLE:
+		    cell.kind = CELL_NUMBER;
+		    cell.d = vec.reals()[row];
+		    break;
+		case TEXT:
+		case BLOB:
+		    cell.kind = (vec.type() == TEXT) ? CELL_TEXT : CELL_BLOB;
+		    cell.p = vec.bytes(row, cell.n);
+		    break;
+		default:
+		    break;
+	    }
+	    return cell;
+	}
+
+	const Column_t& a_row = (*source.list)[row];
+	auto i_data = a_row.find(source.names[col]);
+	if(i_data == a_row.end()){
+	    return cell;
+	}
+	const Data& data = i_data->second;
+	if(data.size() == 0u && data.type() != TEXT && data.type() != BLOB){
+	    return cell;
+	}
+	cell.kind = CELL_NUMBER;
+	cell.is_int = true;
+	switch(data.type()){
+	    case NONE:
+		cell.kind = CELL_NULL;
+		break;
+	    case INT8:{ int8_t v = 0; data.get(v); cell.i = v; break;}
+	    case INT16:{ int16_t v = 0; data.get(v); cell.i = v; break;}
+	    case INT32:{ int32_t v = 0; data.get(v); cell.i = v; break;}
+	    case INT64:{ int64_t v = 0; data.get(v); cell.i = v; break;}
+	    case UINT64:{ uint64_t v = 0u; data.get(v); cell.i = static_cast<int64_t>(v); break;}
+	    case BOOL:{ bool v = false; data.get(v); cell.i = v ? 1 : 0; break;}
+	    case FLOAT:{ float v = 0.0f; data.get(v); cell.is_int = false; cell.d = v; break;}
+	    case DOUBLE:{ double v = 0.0; data.get(v); cell.is_int = false; cell.d = v; break;}
+	    case TEXT:
+	    case BLOB:
+		cell.kind = (data.type() == TEXT) ? CELL_TEXT : CELL_BLOB;
+		cell.p = reinterpret_cast<const char*>(data.bytes());
+		cell.n = data.size();
+		break;
+	}
+	return cell;
+    }
+
+    //-------------------------------------------------------------------
+    static Cell_t cellOf(sqlite3_value* value){
+	Cell_t cell;
+	switch(sqlite3_value_type(value)){
+	    case SQLITE_INTEGER:
+		cell.kind = CELL_NUMBER;
+		cell.is_int = true;
+		cell.i = sqlite3_value_int64(value);
+		break;
+	    case SQLITE_FLOAT:
+		cell.kind = CELL_NUMBER;
+		cell.d = sqlite3_value_double(value);
+		break;
+	    case SQLITE_TEXT:
+		cell.kind = CELL_TEXT;
+		cell.p = reinterpret_cast<const char*>(sqlite3_value_text(value));
+		cell.n = static_cast<size_t>(sqlite3_value_bytes(value));
+		break;
+	    case SQLITE_BLOB:
+		cell.kind = CELL_BLOB;
+		cell.p = static_cast<const char*>(sqlite3_value_blob(value));
+		cell.n = static_cast<size_t>(sqlite3_value_bytes(value));
+		break;
+	    default:
+		break;
+	}
+	return cell;
+    }
+
+    //-------------------------------------------------------------------
+    // Kind of values a declared type converts constraint values to, by the rule of affinity.
+    // CELL_NULL if values are not converted.
+    static int32_t declKind(std::string decl){
+	std::transform(decl.begin(), decl.end(), decl.begin(), ::toupper);
+	if(decl.find("INT") != std::string::npos){
+	    return CELL_NUMBER;
+	}
+	if(decl.find("CHAR") != std::string::npos || decl.find("CLOB") != std::string::npos
+		|| decl.find("TEXT") != std::string::npos){
+	    return CELL_TEXT;
+	}
+	if(decl.empty() || decl.find("BLOB") != std::string::npos){
+	    return CELL_NULL;
+	}
+	return CELL_NUMBER;
+    }
+
+    //-------------------------------------------------------------------
+    static std::string quoteName(const std::string& name){
+	std::string ret = "\"";
+	for(const char& c : name){
+	    ret += c;
+	    if(c == '"'){
+		ret += '"';
+	    }
+	}
+	return ret + "\"";
+    }
+
+    //-------------------------------------------------------------------
+    // Rows sorted by a column. It is made at the first time.
+    static const std::vector<uint32_t>& sortedRows(Source_t& source, const size_t& col){
+	std::vector<uint32_t>& order = source.sorted[col];
+	if(order.size() == source.n_rows){
+	    return order;
+	}
+	std::vector<Cell_t> cells(source.n_rows);
+	order.resize(source.n_rows);
+	for(size_t row=0u; row<source.n_rows; ++row){
+	    cells[row] = cellAt(source, row, col);
+	    order[row] = static_cast<uint32_t>(row);
+	}
+	std::stable_sort(order.begin(), order.end(), [&cells](const uint32_t& a, const uint32_t& b){
+		return compareCell(cells[a], cells[b]) < 0;
+		});
+	return order;
+    }
+
+    //##############################################################
+    // Module of SQLite
+    struct VTab_t{
+	sqlite3_vtab base;
+	Source_t* source;
+    };
+
+    struct Cursor_t{
+	sqlite3_vtab_cursor base;
+	const std::vector<uint32_t>* order;
+	size_t pos;
+	size_t end;
+    };
+
+    // Bits of idxNum. The column is in idxNum >> 8.
+    static const int32_t IDX_EQ = 1;
+    static const int32_t IDX_LOWER = 2;
+    static const int32_t IDX_LOWER_STRICT = 4;
+    static const int32_t IDX_UPPER = 8;
+    static const int32_t IDX_UPPER_STRICT = 16;
+    static const int32_t IDX_ORDERED = 32;
+
+    //-------------------------------------------------------------------
+    static int xConnect(sqlite3* db, void* client, int argc, const char* const* argv,
+	    sqlite3_vtab** vtab, char** err){
+	VirtualTableRegistry* registry = static_cast<VirtualTableRegistry*>(client);
+	Source_t* source = (argc < 3) ? nullptr : registry->find(argv[2]);
+	if(source == nullptr){
+	    *err = sqlite3_mprintf("sf_memory: no container is attached as %s", argc < 3 ? "" : argv[2]);
+	    return SQLITE_ERROR;
+	}
+	std::string query = "CREATE TABLE x(";
+	for(size_t col=0u; col<source->names.size(); ++col){
+	    query += (col == 0u ? "" : ", ") + quoteName(source->names[col]) + " " + source->decls[col];
+	}
+	query += ")";
+	int32_t ret = sqlite3_declare_vtab(db, query.c_str());
+	if(ret != SQLITE_OK){
+	    return ret;
+	}
+	VTab_t* table = static_cast<VTab_t*>(sqlite3_malloc(sizeof(VTab_t)));
+	if(table == nullptr){
+	    return SQLITE_NOMEM;
+	}
+	std::memset(table, 0, sizeof(VTab_t));
+	table->source = source;
+	*vtab = &table->base;
+	return SQLITE_OK;
+    }
+
+    //-------------------------------------------------------------------
+    static int xDisconnect(sqlite3_vtab* vtab){
+	sqlite3_free(vtab);
+	return SQLITE_OK;
+    }
+
+    //-------------------------------------------------------------------
+    // Use an equality on a column if any, otherwise bounds of a column.
+    // Constraints are checked again by SQLite, so the rows found only have to include the answer.
+    static int xBestIndex(sqlite3_vtab* vtab, sqlite3_index_info* info){
+	const Source_t* source = reinterpret_cast<VTab_t*>(vtab)->source;
+	double n = static_cast<double>(std::max<size_t>(source->n_rows, 1u));
+	int32_t eq = -1;
+	int32_t col = -1;
+	for(int32_t k=0; k<info->nConstraint; ++k){
+	    const sqlite3_index_info::sqlite3_index_constraint& c = info->aConstraint[k];
+	    if(!c.usable || c.iColumn < 0 || std::strcmp(sqlite3_vtab_collation(info, k), "BINARY") != 0){
+		continue;
+	    }
+	    if(c.op == SQLITE_INDEX_CONSTRAINT_EQ){
+		eq = k;
+		break;
+	    }
+	    if(col < 0 && (c.op == SQLITE_INDEX_CONSTRAINT_GT || c.op == SQLITE_INDEX_CONSTRAINT_GE
+			|| c.op == SQLITE_INDEX_CONSTRAINT_LT || c.op == SQLITE_INDEX_CONSTRAINT_LE)){
+		col = c.iColumn;
+	    }
+	}
+
+	int32_t idx = 0;
+	if(eq >= 0){
+	    col = info->aConstraint[eq].iColumn;
+	    idx = IDX_EQ;
+	    info->aConstraintUsage[eq].argvIndex = 1;
+	    info->estimatedCost = std::log2(n) + 10.0;
+	    info->estimatedRows = 10;
+	}
+	else if(col >= 0){
+	    int32_t argv_index = 0;
+	    for(int32_t k=0; k<info->nConstraint; ++k){
+		const sqlite3_index_info::sqlite3_index_constraint& c = info->aConstraint[k];
+		if(!c.usable || c.iColumn != col || std::strcmp(sqlite3_vtab_collation(info, k), "BINARY") != 0){
+		    continue;
+		}
+		int32_t bit = 0;
+		if((c.op == SQLITE_INDEX_CONSTRAINT_GT || c.op == SQLITE_INDEX_CONSTRAINT_GE)
+			&& (idx & IDX_LOWER) == 0){
+		    bit = IDX_LOWER | (c.op == SQLITE_INDEX_CONSTRAINT_GT ? IDX_LOWER_STRICT : 0);
+		}
+		else if((c.op == SQLITE_INDEX_CONSTRAINT_LT || c.op == SQLITE_INDEX_CONSTRAINT_LE)
+			&& (idx & IDX_UPPER) == 0){
+		    bit = IDX_UPPER | (c.op == SQLITE_INDEX_CONSTRAINT_LT ? IDX_UPPER_STRICT : 0);
+		}
+		if(bit != 0){
+		    idx |= bit;
+		    info->aConstraintUsage[k].argvIndex = ++argv_index;
+		}
+	    }
+	    bool both = (idx & IDX_LOWER) != 0 && (idx & IDX_UPPER) != 0;
+	    info->estimatedCost = std::log2(n) + n / (both ? 16.0 : 4.0);
+	    info->estimatedRows = static_cast<sqlite3_int64>(n / (both ? 16.0 : 4.0));
+	}
+	else{
+	    info->estimatedCost = n;
+	    info->estimatedRows = static_cast<sqlite3_int64>(n);
+	}
+
+	//rows come in the order of a single column
+	if(info->nOrderBy == 1 && !info->aOrderBy[0].desc && info->aOrderBy[0].iColumn >= 0
+		&& (col < 0 || col == info->aOrderBy[0].iColumn)){
+	    col = info->aOrderBy[0].iColumn;
+	    idx |= IDX_ORDERED;
+	    info->orderByConsumed = 1;
+	}
+	if(idx != 0){
+	    info->idxNum = idx | (col << 8);
+	}
+	return SQLITE_OK;
+    }
+
+    //-------------------------------------------------------------------
+    static int xOpen(sqlite3_vtab*, sqlite3_vtab_cursor** cursor){
+	Cursor_t* a_cursor = static_cast<Cursor_t*>(sqlite3_malloc(sizeof(Cursor_t)));
+	if(a_cursor == nullptr){
+	    return SQLITE_NOMEM;
+	}
+	std::memset(a_cursor, 0, sizeof(Cursor_t));
+	*cursor = &a_cursor->base;
+	return SQLITE_OK;
+    }
+
+    //-------------------------------------------------------------------
+    static int xClose(sqlite3_vtab_cursor* cursor){
+	sqlite3_free(cursor);
+	return SQLITE_OK;
+    }
+
+    //-------------------------------------------------------------------
+    static int xFilter(sqlite3_vtab_cursor* cursor, int idx, const char*, int argc, sqlite3_value** argv){
+	Cursor_t* a_cursor = reinterpret_cast<Cursor_t*>(cursor);
+	Source_t& source = *reinterpret_cast<VTab_t*>(cursor->pVtab)->source;
+	a_cursor->order = nullptr;
+	a_cursor->pos = 0u;
+	a_cursor->end = source.n_rows;
+	if(idx == 0){
+	    return SQLITE_OK;
+	}
+
+	size_t col = static_cast<size_t>(idx >> 8);
+	int32_t kind = declKind(source.decls[col]);
+	//values converted by affinity are not in the order, so all rows are scanned
+	for(int32_t k=0; k<argc; ++k){
+	    Cell_t value = cellOf(argv[k]);
+	    if(value.kind == CELL_NULL
+		    || (kind != CELL_NULL && value.kind != CELL_BLOB && value.kind != kind)){
+		if((idx & IDX_ORDERED) == 0){
+		    return SQLITE_OK;
+		}
+		idx &= ~(IDX_EQ | IDX_LOWER | IDX_UPPER);
+		break;
+	    }
+	}
+
+	const std::vector<uint32_t>& order = sortedRows(source, col);
+	a_cursor->order = &order;
+	auto less = [&source, &col](const uint32_t& row, const Cell_t& value){
+	    return compareCell(cellAt(source, row, col), value) < 0;
+	};
+	auto greater = [&source, &col](const Cell_t& value, const uint32_t& row){
+	    return compareCell(value, cellAt(source, row, col)) < 0;
+	};
+	if((idx & IDX_EQ) != 0){
+	    Cell_t value = cellOf(argv[0]);
+	    a_cursor->pos = std::lower_bound(order.begin(), order.end(), value, less) - order.begin();
+	    a_cursor->end = std::upper_bound(order.begin(), order.end(), value, greater) - order.begin();
+	    return SQLITE_OK;
+	}
+	int32_t k = 0;
+	if((idx & IDX_LOWER) != 0){
+	    Cell_t value = cellOf(argv[k++]);
+	    a_cursor->pos = (((idx & IDX_LOWER_STRICT) != 0)
+		    ? std::upper_bound(order.begin(), order.end(), value, greater)
+		    : std::lower_bound(order.begin(), order.end(), value, less)) - order.begin();
+	}
+	if((idx & IDX_UPPER) != 0){
+	    Cell_t value = cellOf(argv[k++]);
+	    a_cursor->end = (((idx & IDX_UPPER_STRICT) != 0)
+		    ? std::lower_bound(order.begin(), order.end(), value, less)
+		    : std::upper_bound(order.begin(), order.end(), value, greater)) - order.begin();
+	}
+	a_cursor->end = std::max(a_cursor->pos, a_cursor->end);
+	return SQLITE_OK;
+    }
+
+    //-------------------------------------------------------------------
+    static int xNext(sqlite3_vtab_cursor* cursor){
+	++reinterpret_cast<Cursor_t*>(cursor)->pos;
+	return SQLITE_OK;
+    }
+
+    //-------------------------------------------------------------------
+    static int xEof(sqlite3_vtab_cursor* cursor){
+	const Cursor_t* a_cursor = reinterpret_cast<Cursor_t*>(cursor);
+	return a_cursor->pos >= a_cursor->end;
+    }
+
+    //-------------------------------------------------------------------
+    static size_t rowOf(const Cursor_t* cursor){
+	return (cursor->order == nullptr) ? cursor->pos : (*cursor->order)[cursor->pos];
+    }
+
+    //-------------------------------------------------------------------
+    static int xRowid(sqlite3_vtab_cursor* cursor, sqlite3_int64* rowid){
+	*rowid = static_cast<sqlite3_int64>(rowOf(reinterpret_cast<Cursor_t*>(cursor)));
+	return SQLITE_OK;
+    }
+
+    //-------------------------------------------------------------------
+    // Values are passed without copying. They live as long as the container.
+    static int xColumn(sqlite3_vtab_cursor* cursor, sqlite3_context* ctx, int col){
+	const Source_t& source = *reinterpret_cast<VTab_t*>(cursor->pVtab)->source;
+	Cell_t cell = cellAt(source, rowOf(reinterpret_cast<Cursor_t*>(cursor)), static_cast<size_t>(col));
+	switch(cell.kind){
+	    case CELL_NUMBER:
+		if(cell.is_int){
+		    sqlite3_result_int64(ctx, cell.i);
+		}
+		else{
+		    sqlite3_result_double(ctx, cell.d);
+		}
+		break;
+	    case CELL_TEXT:
+		sqlite3_result_text64(ctx, (cell.p == nullptr) ? "" : cell.p, cell.n, SQLITE_STATIC, SQLITE_UTF8);
+		break;
+	    case CELL_BLOB:
+		sqlite3_result_blob64(ctx, (cell.p == nullptr) ? "" : cell.p, cell.n, SQLITE_STATIC);
+		break;
+	    default:
+		sqlite3_result_null(ctx);
+		break;
+	}
+	return SQLITE_OK;
+    }
+
+    //-------------------------------------------------------------------
+    static sqlite3_module memory_module = {
+	0,//iVersion
+	xConnect,//xCreate
+	xConnect,
+	xBestIndex,
+	xDisconnect,
+	xDisconnect,//xDestroy
+	xOpen,
+	xClose,
+	xFilter,
+	xNext,
+	xEof,
+	xColumn,
+	xRowid,
+	nullptr,//xUpdate
+	nullptr,//xBegin
+	nullptr,//xSync
+	nullptr,//xCommit
+	nullptr,//xRollback
+	nullptr,//xFindFunction
+	nullptr,//xRename
+	nullptr,//xSavepoint
+	nullptr,//xRelease
+	nullptr,//xRollbackTo
+	nullptr//xShadowName
+    };
+
+    //##############################################################
+    // VirtualTableRegistry
+    //-------------------------------------------------------------------
+    int32_t VirtualTableRegistry::add(sqlite3* db, const std::string& name,
+	    Source_t&& source, std::string& err_msg){
+	err_msg.clear();
+	if(sources_.find(name) != sources_.end()){
+	    err_msg = "A container is already attached as " + name;
+	    return SQLITE_ERROR;
+	}
+	int32_t ret = SQLITE_OK;
+	if(db_ptr_ != db){
+	    ret = sqlite3_create_module_v2(db, "sf_memory", &memory_module, this, nullptr);
+	    if(ret != SQLITE_OK){
+		err_msg = sqlite3_errmsg(db);
+		return ret;
+	    }
+	    db_ptr_ = db;
+	}
+
+	source.sorted.assign(source.names.size(), std::vector<uint32_t>());
+	sources_[name] = std::move(source);
+	char* err = nullptr;
+	std::string query = "CREATE VIRTUAL TABLE temp." + quoteName(name) + " USING sf_memory";
+	ret = sqlite3_exec(db, query.c_str(), nullptr, nullptr, &err);
+	if(ret != SQLITE_OK){
+	    err_msg = (err == nullptr) ? sqlite3_errstr(ret) : err;
+	    sqlite3_free(err);
+	    sources_.erase(name);
+	}
+	return ret;
+    }
+
+    //-------------------------------------------------------------------
+    int32_t VirtualTableRegistry::remove(sqlite3* db, const std::string& name, std::string& err_msg){
+	err_msg.clear();
+	if(sources_.find(name) == sources_.end()){
+	    err_msg = "No container is attached as " + name;
+	    return SQLITE_ERROR;
+	}
+	char* err = nullptr;
+	std::string query = "DROP TABLE temp." + quoteName(name);
+	int32_t ret = sqlite3_exec(db, query.c_str(), nullptr, nullptr, &err);
+	if(ret != SQLITE_OK){
+	    err_msg = (err == nullptr) ? sqlite3_errstr(ret) : err;
+	    sqlite3_free(err);
+	    return ret;
+	}
+	sources_.erase(name);
+	return ret;
+    }
+
+    //-------------------------------------------------------------------
+    void VirtualTableRegistry::clear(){
+	sources_.clear();
+	db_ptr_ = nullptr;
+    }
+
+    //-------------------------------------------------------------------
+    VirtualTableRegistry::Source_t* VirtualTableRegistry::find(const std::string& name){
+	auto i_source = sources_.find(name);
+	return (i_source == sources_.end()) ? nullptr : &i_source->second;
+    }
+}
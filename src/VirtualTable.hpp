@@ -0,0 +1,65 @@
+/*
+ * VirtualTable.hpp
+ *
+ * Copyright (C) 2020 Taishi Ueda <taishi.ueda@gmail.com>
+ *
+ * Distributed under terms of the MIT license.
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#ifndef SF_VIRTUAL_TABLE_HPP
+#define SF_VIRTUAL_TABLE_HPP
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+#include "SqliteFetcher.hpp"
+
+//! SqliteFetcher name space
+namespace sf{
+
+    //! Containers of a connection exposed to SQL by the virtual table module "sf_memory".
+    /*!
+     * This is held by Fetcher. See Fetcher::attachTable().
+     * Tables are created in the temp schema and are read only.
+     * Rows are read from the containers directly, so they must not be changed while attached.
+     */
+    class VirtualTableRegistry{
+	public:
+	    //! A container exposed as a table.
+	    struct Source_t{
+		std::vector<std::string> names;//!< names of columns.
+		std::vector<std::string> decls;//!< declared types of columns.
+		size_t n_rows{0u};//!< number of rows.
+		const ColumnList_t* list{nullptr};//!< rows, or nullptr if columnar is used.
+		const ColumnarResult* columnar{nullptr};//!< rows, or nullptr if list is used.
+		//! Rows sorted by each column. They are made when a column is constrained first.
+		std::vector<std::vector<uint32_t>> sorted;
+	    };
+
+	    //! Create a table of a container.
+	    /*!
+	     * \param[in] db connection. The module is registered to it at the first time.
+	     * \param[in] name name of the table.
+	     * \param[in] source container and its schema.
+	     * \param[out] err_msg error message.
+	     * \retval SQLITE_OK success.
+	     * \retval others Some errors occured. See [here](https://www.sqlite.org/rescode.html)
+	     */
+	    int32_t add(sqlite3* db, const std::string& name, Source_t&& source, std::string& err_msg);
+
+	    //! Drop a table of a container.
+	    int32_t remove(sqlite3* db, const std::string& name, std::string& err_msg);
+
+	    //! Forget all tables. This is called when the connection is closed.
+	    void clear();
+
+	    //! Find a source by the name of the table. nullptr if it is not found.
+	    Source_t* find(const std::string& name);
+
+	private:
+	    sqlite3* db_ptr_{nullptr};
+	    std::map<std::string, Source_t> sources_;
+    };
+}
+#endif
@@ -9,11 +9,28 @@
 #include <stdlib.h>
 #include <iostream>
 #include "SqliteFetcher.hpp"
+#include "ShardedFetcher.hpp"
+#include "Kernels.hpp"
+#include "Transaction.hpp"
+#include "Codec.hpp"
+#include "IngestPipeline.hpp"
+#include "SpilledResult.hpp"
+#include "SchemaRegistry.hpp"
+#include <stdexcept>
 
 int main(int argc, char* argv[]) {
 
     using namespace sf;
 
+    //results of sections are checked, and the exit code is 1 if some of them are wrong.
+    int n_failed = 0;
+    auto check = [&n_failed](const bool& is_ok, const std::string& what){
+	if(!is_ok){
+	    std::cerr << "FAILED: " << what << std::endl;
+	    ++n_failed;
+	}
+    };
+
     /* Open database */
     Fetcher sql_fetch("test.db");
 
@@ -225,8 +242,613 @@ int main(int argc, char* argv[]) {
     }
 
     ColumnList_t all_user = sql_fetch.fetchColumn("SELECT * from user;", err_msg);
-    
-    return 0;
+
+    //###############################################################
+    //  Query plan
+    //
+    std::cout << "--- 11. Explain a query ---" << std::endl;
+    QueryPlan_t plan = sql_fetch.explain("SELECT name FROM user WHERE age > 20 ORDER BY height_cm", err_msg);
+    for(auto i_node = plan.nodes.begin(); i_node != plan.nodes.end(); ++i_node){
+	std::cout << i_node->detail
+	    << (i_node->is_full_scan ? " <- full scan" : "")
+	    << (i_node->uses_temp_btree ? " <- temp B-tree" : "") << std::endl;
+    }
+    //warn full scans of tables having more than 2 rows
+    sql_fetch.enableScanWarning(2);
+    all_user = sql_fetch.fetchColumn("SELECT * from user;", err_msg);
+    sql_fetch.disableScanWarning();
+
+    //###############################################################
+    //  Indexes
+    //
+    std::cout << "--- 12. Create and get indexes ---" << std::endl;
+    Index_t idx_age;
+    idx_age.name = "user_age";
+    idx_age.columns = {"age", "height_cm DESC"};
+    Index_t idx_name;
+    idx_name.name = "user_name";
+    idx_name.columns = {"lower(name)"};
+    idx_name.where = "country IS NOT NULL";
+    IndexInfo_t index_info = {{"user", {idx_age, idx_name}}};
+    str = sql_fetch.genQueryCreateIndex(index_info, err_msg);
+    res = sql_fetch.exec(str, err_msg);
+    //Tables and indexes are generated from the existing database
+    str = sql_fetch.genQueryCreate(sql_fetch.getTableInfo(err_msg),
+	    sql_fetch.getIndexInfo(err_msg), err_msg);
+    std::cout << str << std::endl;
+
+    //###############################################################
+    //  Fetch columns into an arena
+    //
+    std::cout << "--- 13. Fetch columns into an arena ---" << std::endl;
+    Arena arena;
+    {
+	ArenaColumnList arena_user(arena);
+	sql_fetch.fetchColumn("SELECT name, height_cm FROM user", arena_user, err_msg);
+	for(size_t k=0u; k<arena_user.size(); ++k){
+	    std::string name;
+	    float height_cm = 0.0f;
+	    arena_user.at(k, "name").get(name);
+	    arena_user.at(k, "height_cm").get(height_cm);
+	    std::cout << name << ": height_cm = " << height_cm << std::endl;
+	}
+    }
+    std::cout << "arena used " << arena.used() << " bytes" << std::endl;
+    //all rows are released in one shot
+    arena.release();
+
+    //###############################################################
+    //  Sharded databases
+    //
+    std::cout << "--- 14. Fetch columns from shards ---" << std::endl;
+    std::vector<std::string> shard_names = {"test_shard0.db", "test_shard1.db"};
+    for(size_t k=0u; k<shard_names.size(); ++k){
+	Fetcher a_shard(shard_names[k]);
+	a_shard.exec("DROP TABLE IF EXISTS user;", err_msg);
+	//all shards have the same schema
+	str = a_shard.genQueryCreate(TableInfo_t{{"user", user_col_1}}, err_msg);
+	str += a_shard.genQueryInsert("user", ColumnList_t{user_col_list[k+1u], column_list2[k]}, err_msg);
+	a_shard.exec(str, err_msg);
+    }
+    ShardedFetcher shards(shard_names);
+    MergeOption_t merge_opt;
+    merge_opt.order_by = "height_cm";
+    merge_opt.descending = true;
+    merge_opt.limit = 3;
+    ColumnList_t tallest = shards.fetchColumn(
+	    "SELECT name, height_cm FROM user ORDER BY height_cm DESC", err_msg, merge_opt);
+    for(auto i_user = tallest.begin(); i_user != tallest.end(); ++i_user){
+	std::string name;
+	float height_cm = 0.0f;
+	i_user->at("name").get(name);
+	i_user->at("height_cm").get(height_cm);
+	std::cout << name << ": height_cm = " << height_cm << std::endl;
+    }
+    check(err_msg.empty() && tallest.size() == 3u, "a limit is pushed to shards: " + err_msg);
+    for(size_t k=1u; k<tallest.size(); ++k){
+	float prev_cm = 0.0f, height_cm = 0.0f;
+	tallest[k - 1u].at("height_cm").get(prev_cm);
+	tallest[k].at("height_cm").get(height_cm);
+	check(prev_cm >= height_cm, "rows of shards are merged in order");
+    }
+    //a query with its own LIMIT is wrapped
+    ColumnList_t limited = shards.fetchColumn(
+	    "SELECT name, height_cm FROM user ORDER BY height_cm DESC LIMIT 1", err_msg, merge_opt);
+    check(err_msg.empty() && limited.size() == shard_names.size(), "a query with LIMIT is fetched from shards: " + err_msg);
+
+    //###############################################################
+    //  Columnar fetch and kernels
+    //
+    std::cout << "--- 15. Columnar fetch and kernels ---" << std::endl;
+    ColumnarResult columnar;
+    sql_fetch.fetchColumnar("SELECT height_cm FROM user", columnar, err_msg);
+    const ColumnVector& height = columnar.column("height_cm");
+    double min_height = 0.0;
+    double max_height = 0.0;
+    kernel::minMax(height, min_height, max_height);
+    std::cout << "height_cm: mean = " << kernel::mean(height)
+	<< ", min = " << min_height << ", max = " << max_height << std::endl;
+    std::cout << "taller than 170cm: " << kernel::countIf(height.reals(), height.validity(), height.size(),
+	    [](const double& v){ return v > 170.0; }) << std::endl;
+
+    //###############################################################
+    //  Transactions
+    //
+    std::cout << "--- 16. Transactions ---" << std::endl;
+    sql_fetch.exec("DROP TABLE IF EXISTS tx_log; CREATE TABLE tx_log(ID INTEGER PRIMARY KEY, note TEXT);", err_msg);
+    auto countRows = [&sql_fetch, &err_msg](const std::string& table){
+	ExecResult_t count_res = sql_fetch.exec("SELECT count(*) AS n FROM " + table + ";", err_msg);
+	return count_res.result.empty() ? -1 : std::stoi(count_res.result.front().at("n"));
+    };
+    {
+	Transaction tx(sql_fetch, TX_IMMEDIATE);
+	check(tx.isActive(), "a transaction begins");
+	tx.insert("tx_log", Column_t{{"note", Data("committed")}}, err_msg);
+	{
+	    Savepoint sp(tx, "undo \"this\"");
+	    tx.insert("tx_log", Column_t{{"note", Data("rolled back to a savepoint")}}, err_msg);
+	    sp.rollback(err_msg);
+	    check(err_msg.empty(), "a savepoint with a quoted name is rolled back: " + err_msg);
+	}
+	int32_t commit_ret = tx.commit(err_msg);
+	check(commit_ret == SQLITE_OK, "a transaction is committed: " + err_msg);
+	check(tx.insert("tx_log", Column_t{{"note", Data("after commit")}}, err_msg) == SQLITE_MISUSE,
+		"rows are refused after commit");
+    }
+    try{
+	Transaction tx(sql_fetch);
+	tx.insert("tx_log", Column_t{{"note", Data("thrown")}}, err_msg);
+	throw std::runtime_error("abort the transaction");
+    }
+    catch(const std::runtime_error& e){
+	std::cout << "rolled back by an exception: " << e.what() << std::endl;
+    }
+    {
+	//a transaction can't begin in another one
+	Transaction outer(sql_fetch);
+	Transaction inner(sql_fetch);
+	check(!inner.isActive(), "BEGIN in a transaction fails");
+	check(inner.insert("tx_log", Column_t{{"note", Data("lost")}}, err_msg) == SQLITE_MISUSE
+		&& !err_msg.empty(), "rows are refused after BEGIN failed");
+	outer.rollback(err_msg);
+    }
+    int n_tx_rows = countRows("tx_log");
+    std::cout << "rows in tx_log: " << n_tx_rows << std::endl;
+    check(n_tx_rows == 1, "only the committed row is in the table");
+
+    //###############################################################
+    //  Result cache
+    //
+    std::cout << "--- 17. Result cache ---" << std::endl;
+    sql_fetch.enableResultCache(1u << 20);
+    ColumnList_t cached = sql_fetch.fetchColumn("SELECT * FROM tx_log", err_msg);
+    cached = sql_fetch.fetchColumn("SELECT * FROM tx_log", err_msg);
+    check(sql_fetch.cacheStats().hits == 1u, "a result is read from the cache");
+    sql_fetch.exec("BEGIN; INSERT INTO tx_log(note) VALUES('rolled back');", err_msg);
+    cached = sql_fetch.fetchColumn("SELECT * FROM tx_log", err_msg);
+    check(cached.size() == 2u, "a row inserted in a transaction is read");
+    sql_fetch.exec("ROLLBACK;", err_msg);
+    cached = sql_fetch.fetchColumn("SELECT * FROM tx_log", err_msg);
+    check(cached.size() == 1u, "a rolled back row is not read from the cache");
+    //WITHOUT ROWID tables don't call the update hook
+    sql_fetch.exec("DROP TABLE IF EXISTS tag; CREATE TABLE tag(name TEXT, n INTEGER, PRIMARY KEY(name)) WITHOUT ROWID;", err_msg);
+    cached = sql_fetch.fetchColumn("SELECT n FROM tag", err_msg);
+    sql_fetch.exec("INSERT INTO tag VALUES('new', 1);", err_msg);
+    cached = sql_fetch.fetchColumn("SELECT n FROM tag", err_msg);
+    check(cached.size() == 1u, "an insert into a WITHOUT ROWID table invalidates the cache");
+    sql_fetch.disableResultCache();
+
+    //###############################################################
+    //  Change feed
+    //
+    std::cout << "--- 18. Change feed ---" << std::endl;
+    size_t n_events = 0u;
+    size_t n_once = 0u;
+    int32_t feed_id = sql_fetch.subscribeChanges([&n_events](const ChangeBatch_t& batch){
+	n_events += batch.size();
+    });
+    //a handler can unsubscribe itself
+    int32_t once_id = -1;
+    once_id = sql_fetch.subscribeChanges([&sql_fetch, &n_once, &once_id](const ChangeBatch_t& batch){
+	n_once += batch.size();
+	sql_fetch.unsubscribeChanges(once_id);
+    });
+    sql_fetch.exec("BEGIN; INSERT INTO tx_log(note) VALUES('kept');"
+	    " SAVEPOINT s; INSERT INTO tx_log(note) VALUES('undone');"
+	    " ROLLBACK TO s; RELEASE s; COMMIT;", err_msg);
+    check(n_events == 1u, "rows undone by ROLLBACK TO are not delivered");
+    sql_fetch.exec("INSERT INTO tx_log(note) VALUES('once');", err_msg);
+    check(n_events == 2u && n_once == 1u, "an unsubscribed handler isn't called");
+    sql_fetch.unsubscribeChanges(feed_id);
+    {
+	//a COMMIT failed by a lock of a reader delivers nothing
+	Fetcher feed_writer("test_feed.db");
+	Fetcher feed_reader("test_feed.db");
+	feed_writer.exec("CREATE TABLE IF NOT EXISTS item(ID INTEGER PRIMARY KEY);", err_msg);
+	size_t n_items = 0u;
+	feed_writer.subscribeChanges([&n_items](const ChangeBatch_t& batch){
+	    n_items += batch.size();
+	});
+	ExecResult_t feed_res;
+	feed_reader.exec("BEGIN; SELECT count(*) AS n FROM item;", feed_res, err_msg);
+	feed_writer.exec("BEGIN; INSERT INTO item DEFAULT VALUES;", feed_res, err_msg);
+	int32_t busy_ret = feed_writer.exec("COMMIT;", feed_res, err_msg);
+	check(busy_ret == SQLITE_BUSY && n_items == 0u, "changes of a busy COMMIT are not delivered");
+	feed_writer.exec("ROLLBACK;", feed_res, err_msg);
+	check(n_items == 0u, "changes rolled back after a busy COMMIT are not delivered");
+	feed_reader.exec("COMMIT;", feed_res, err_msg);
+	feed_writer.exec("INSERT INTO item DEFAULT VALUES;", feed_res, err_msg);
+	check(n_items == 1u, "changes are delivered after the commit");
+    }
+
+    //###############################################################
+    //  Compressed columns
+    //
+    std::cout << "--- 19. Compressed columns ---" << std::endl;
+    sql_fetch.exec("DROP TABLE IF EXISTS doc; CREATE TABLE doc(ID INTEGER PRIMARY KEY, body TEXT COMPRESSED);", err_msg);
+    std::string long_body(1000u, 'a');
+    Column_t doc_row{{"body", Data(long_body.c_str())}};
+    sql_fetch.exec(sql_fetch.genQueryInsert("doc", doc_row, err_msg), err_msg);
+    ExecResult_t packed = sql_fetch.exec("SELECT length(CAST(body AS BLOB)) AS n FROM doc;", err_msg);
+    check(!packed.result.empty() && std::stoul(packed.result.front().at("n")) < long_body.size(),
+	    "a table created by exec() is written compressed");
+    ColumnList_t docs = sql_fetch.fetchColumn("SELECT * FROM doc", err_msg);
+    std::string doc_body;
+    check(docs.size() == 1u && docs.front().at("body").get(doc_body) && doc_body == long_body,
+	    "a compressed value is read back");
+    ColumnarResult doc_columns;
+    sql_fetch.fetchColumnar("SELECT body FROM doc", doc_columns, err_msg);
+    size_t n_stored = 0u;
+    const char* stored = doc_columns.column("body").bytes(0u, n_stored);
+    check(stored != nullptr && n_stored >= codec::HEADER_BYTES && stored[0] == '\0' && stored[1] == 'S',
+	    "a columnar result holds compressed values as stored");
+    //values which only look compressed are not decompressed
+    Binary_t forged = {0x00, 'S', 'F', 'Z', 0xff, 0xff, 0xff, 0xff, 0x78, 0x9c};
+    Binary_t forged_out;
+    check(Data(Binary_t(forged)).get(forged_out) && forged_out == forged, "a BLOB without COMPRESSED is got as it is");
+    check(!codec::decompress(forged.data(), forged.size(), forged_out), "a forged raw size is refused");
+
+    //###############################################################
+    //  Ingest pipeline
+    //
+    std::cout << "--- 20. Ingest pipeline ---" << std::endl;
+    sql_fetch.exec("DROP TABLE IF EXISTS ingest; CREATE TABLE ingest(ID INTEGER PRIMARY KEY, body TEXT COMPRESSED);", err_msg);
+    std::vector<int64_t> records(1000u);
+    for(size_t k=0u; k<records.size(); ++k){
+	records[k] = static_cast<int64_t>(k);
+    }
+    IngestOption_t ingest_option;
+    ingest_option.n_producers = 2u;
+    ingest_option.batch_rows = 64u;
+    IngestPipeline pipeline(sql_fetch, "ingest", {"ID", "body"}, ingest_option);
+    int32_t ingest_ret = pipeline.run(records, [](const int64_t& record, Data* row){
+	row[0].set(record);
+	row[1].set(std::string(300u, static_cast<char>('a' + record % 26)));
+    }, err_msg);
+    std::cout << "ingested " << pipeline.stats().rows << " rows in "
+	<< pipeline.stats().transactions << " transactions" << std::endl;
+    check(ingest_ret == SQLITE_OK && pipeline.stats().rows == records.size(), "all records are ingested: " + err_msg);
+    check(countRows("ingest") == static_cast<int32_t>(records.size()), "ingested rows are in the table");
+    ExecResult_t ingest_packed = sql_fetch.exec("SELECT max(length(CAST(body AS BLOB))) AS n FROM ingest;", err_msg);
+    check(!ingest_packed.result.empty() && std::stoul(ingest_packed.result.front().at("n")) < 300u,
+	    "ingested values of a COMPRESSED column are compressed");
+    ColumnList_t ingested = sql_fetch.fetchColumn("SELECT * FROM ingest WHERE ID = 27", err_msg);
+    std::string ingested_body;
+    check(ingested.size() == 1u && ingested.front().at("body").get(ingested_body)
+	    && ingested_body == std::string(300u, 'b'), "an ingested value is read back");
+    {
+	//a failed run in a transaction of the caller undoes only its rows
+	std::vector<int64_t> clashing(1000u);
+	for(size_t k=0u; k<clashing.size(); ++k){
+	    clashing[k] = static_cast<int64_t>(records.size() + k);
+	}
+	clashing.back() = 0;
+	Transaction tx(sql_fetch);
+	IngestPipeline clash_pipeline(sql_fetch, "ingest", {"ID", "body"}, ingest_option);
+	ingest_ret = clash_pipeline.run(clashing, [](const int64_t& record, Data* row){
+	    row[0].set(record);
+	    row[1].set(std::string("clash"));
+	}, err_msg);
+	check(ingest_ret != SQLITE_OK && tx.isActive(), "a failed run keeps the transaction of the caller");
+	tx.commit(err_msg);
+    }
+    check(countRows("ingest") == static_cast<int32_t>(records.size()), "rows of a failed run are rolled back");
+
+    //###############################################################
+    //  BLOB streams
+    //
+    std::cout << "--- 21. BLOB streams ---" << std::endl;
+    sql_fetch.exec("DROP TABLE IF EXISTS artifact; CREATE TABLE artifact(ID INTEGER PRIMARY KEY, name TEXT, body BLOB);", err_msg);
+    int64_t blob_rowid = 0;
+    sql_fetch.insertZeroBlob("artifact", Column_t{{"name", Data("model")}}, "body", 8u, blob_rowid, err_msg);
+    sql_fetch.enableResultCache(1u << 20);
+    ColumnList_t artifacts = sql_fetch.fetchColumn("SELECT body FROM artifact", err_msg);
+    ChangeBatch_t blob_changes;
+    int32_t blob_feed_id = sql_fetch.subscribeChanges([&blob_changes](const ChangeBatch_t& batch){
+	blob_changes.insert(blob_changes.end(), batch.begin(), batch.end());
+    });
+    {
+	BlobStream blob;
+	sql_fetch.openBlob("artifact", "body", blob_rowid, true, blob, err_msg);
+	const uint8_t chunk[4] = {1u, 2u, 3u, 4u};
+	blob.write(0u, chunk, 4u, err_msg);
+	blob.write(4u, chunk, 4u, err_msg);
+    }
+    check(blob_changes.size() == 1u && blob_changes.front().op == OP_UPDATE
+	    && blob_changes.front().rowid == blob_rowid, "a BLOB write is told as an update");
+    artifacts = sql_fetch.fetchColumn("SELECT body FROM artifact", err_msg);
+    Binary_t blob_body;
+    check(artifacts.size() == 1u && artifacts.front().at("body").get(blob_body)
+	    && blob_body == Binary_t({1u, 2u, 3u, 4u, 1u, 2u, 3u, 4u}), "a BLOB write invalidates the cache");
+    sql_fetch.unsubscribeChanges(blob_feed_id);
+    sql_fetch.disableResultCache();
+    {
+	//a stream outliving its Fetcher is closed with it
+	BlobStream outliving;
+	{
+	    Fetcher blob_owner("test.db");
+	    BlobStream moved;
+	    blob_owner.openBlob("artifact", "body", blob_rowid, false, moved, err_msg);
+	    outliving = std::move(moved);
+	    check(outliving.isOpened(), "a moved stream is opened");
+	}
+	check(!outliving.isOpened() && outliving.close() == SQLITE_OK, "closing a Fetcher closes its streams");
+    }
+
+    //###############################################################
+    //  Tables in memory
+    //
+    std::cout << "--- 22. Tables in memory ---" << std::endl;
+    ColumnList_t visits;
+    for(int64_t k=0; k<3; ++k){
+	Column_t visit;
+	visit["note_id"] = Data(INT64);
+	visit["note_id"].set(static_cast<int64_t>(1 + k % 2));
+	visit["page"] = Data("top");
+	visits.push_back(visit);
+    }
+    int32_t attach_ret = sql_fetch.attachTable("visit", {{"note_id", Data(INT64)}, {"page", Data(TEXT)}}, visits, err_msg);
+    check(attach_ret == SQLITE_OK, "rows in memory are attached: " + err_msg);
+    ExecResult_t joined = sql_fetch.exec("SELECT t.note, v.page FROM tx_log t JOIN visit v ON v.note_id = t.ID;", err_msg);
+    check(err_msg.empty() && joined.result.size() == visits.size(), "an attached table is joined: " + err_msg);
+    sql_fetch.detachTable("visit", err_msg);
+
+    //###############################################################
+    //  SQL functions
+    //
+    std::cout << "--- 23. SQL functions ---" << std::endl;
+    sql_fetch.registerFunction("to_inch", [](double cm){ return cm / 2.54; }, err_msg, true);
+    ExecResult_t inch = sql_fetch.exec("SELECT to_inch(254.0) AS v;", err_msg);
+    check(!inch.result.empty() && std::stod(inch.result.front().at("v")) == 100.0, "a function is called: " + err_msg);
+    //functions are not deterministic by default, so each row calls it
+    int64_t n_called = 0;
+    sql_fetch.registerFunction("next_serial", [&n_called](){ return ++n_called; }, err_msg);
+    ExecResult_t serials = sql_fetch.exec("SELECT DISTINCT next_serial() AS v FROM tx_log;", err_msg);
+    check(serials.result.size() == static_cast<size_t>(countRows("tx_log")), "a function with state is called for each row");
+    sql_fetch.registerFunction("throw_int", [](int64_t v){ throw static_cast<int>(v); return v; }, err_msg);
+    sql_fetch.exec("SELECT throw_int(1);", err_msg);
+    check(err_msg == "unknown exception", "an exception of any type becomes an error: " + err_msg);
+    struct Sum_t{ double sum{0.0}; };
+    sql_fetch.registerAggregate<Sum_t>("sum_id",
+	    [](Sum_t& s, double v){ s.sum += v; }, [](const Sum_t& s){ return s.sum; }, err_msg);
+    ExecResult_t id_sum = sql_fetch.exec("SELECT sum_id(ID) AS v FROM tx_log;", err_msg);
+    check(!id_sum.result.empty() && std::stod(id_sum.result.front().at("v")) == 6.0, "an aggregate is called: " + err_msg);
+
+    //###############################################################
+    //  Parallel scan
+    //
+    std::cout << "--- 24. Parallel scan ---" << std::endl;
+    sql_fetch.exec("DROP TABLE IF EXISTS wide; CREATE TABLE wide(ID INTEGER PRIMARY KEY, v INTEGER);"
+	    " INSERT INTO wide VALUES(-9223372036854775808, 1), (0, 2), (9223372036854775807, 3);", err_msg);
+    for(size_t n_part=1u; n_part<=4u; ++n_part){
+	ScanOption_t scan_option;
+	scan_option.key_column = "ID";
+	scan_option.n_partitions = n_part;
+	ColumnList_t scanned;
+	sql_fetch.fetchColumnParallel("wide", scanned, err_msg, scan_option);
+	bool is_ordered = scanned.size() == 3u;
+	for(size_t k=0u; k<scanned.size() && is_ordered; ++k){
+	    int64_t v = 0;
+	    scanned[k].at("v").get(v);
+	    is_ordered = (v == static_cast<int64_t>(k) + 1);
+	}
+	check(err_msg.empty() && is_ordered, "keys of the full int64 range are scanned in "
+		+ std::to_string(n_part) + " partitions: " + err_msg);
+    }
+
+    //###############################################################
+    //  Copy tables
+    //
+    std::cout << "--- 25. Copy tables ---" << std::endl;
+    sql_fetch.exec("DROP TABLE IF EXISTS tx_log_copy;", err_msg);
+    Fetcher other_db("test_copy.db");
+    int32_t copy_ret = sql_fetch.copyTable("tx_log", other_db, "tx_log", err_msg);
+    check(copy_ret == SQLITE_OK, "a table is copied to another database: " + err_msg);
+    {
+	Transaction tx(sql_fetch);
+	copy_ret = sql_fetch.copyTable("tx_log", sql_fetch, "tx_log_copy", err_msg);
+	check(copy_ret == SQLITE_OK, "a table is copied in a transaction: " + err_msg);
+	tx.rollback(err_msg);
+    }
+    check(countRows("tx_log_copy") < 0, "a copy is rolled back with the transaction");
+    {
+	Transaction tx(sql_fetch);
+	sql_fetch.copyTable("tx_log", sql_fetch, "tx_log_copy", err_msg);
+	copy_ret = other_db.copyTable("tx_log", sql_fetch, "tx_log_other", err_msg);
+	check(copy_ret == SQLITE_MISUSE, "another database isn't attached in a transaction");
+	tx.commit(err_msg);
+    }
+    check(countRows("tx_log_copy") == countRows("tx_log"), "a copy is committed with the transaction");
+    //rowids over the whole range of int64_t copied in chunks
+    sql_fetch.exec("DROP TABLE IF EXISTS spread; DROP TABLE IF EXISTS spread_copy;"
+	    " CREATE TABLE spread(ID INTEGER PRIMARY KEY, v INTEGER);"
+	    " WITH RECURSIVE k(x) AS (SELECT 0 UNION ALL SELECT x + 1 FROM k WHERE x < 131070)"
+	    " INSERT INTO spread SELECT -9223372036854775807 - 1 + x * 140737488355328, x FROM k;"
+	    " INSERT INTO spread VALUES(9223372036854775807, -1);", err_msg);
+    copy_ret = sql_fetch.copyTable("spread", sql_fetch, "spread_copy", err_msg);
+    check(copy_ret == SQLITE_OK && countRows("spread_copy") == 131072,
+	    "rowids from the minimum to the maximum are copied: " + err_msg);
+
+    //###############################################################
+    //  Results without copies
+    //
+    std::cout << "--- 26. Results without copies ---" << std::endl;
+    ExecResult_t reused;
+    sql_fetch.exec("SELECT * FROM tx_log;", reused, err_msg);
+    sql_fetch.exec("SELECT * FROM tx_log;", reused, err_msg);
+    check(reused.result.size() == static_cast<size_t>(countRows("tx_log")), "rows of a given container are replaced");
+    ColumnList_t reused_col;
+    sql_fetch.fetchColumn("SELECT * FROM tx_log", reused_col, err_msg);
+    check(err_msg.empty() && reused_col.size() == reused.result.size(), "columns are fetched into a given list: " + err_msg);
+    Data moved_blob(Binary_t{1u, 2u, 3u});
+    Binary_t taken;
+    check(moved_blob.take(taken) && taken.size() == 3u && moved_blob.size() == 0u, "a BLOB is moved out of Data");
+
+    //###############################################################
+    //  Keyset pagination
+    //
+    std::cout << "--- 27. Keyset pagination ---" << std::endl;
+    Page_t page;
+    size_t n_pages = 0u;
+    size_t n_paged = 0u;
+    int64_t last_id = -1;
+    bool is_paged_in_order = true;
+    do{
+	page = sql_fetch.fetchPage("ingest", "ID", 300u, page.token, err_msg);
+	for(auto i_row = page.rows.begin(); i_row != page.rows.end(); ++i_row){
+	    int64_t id = 0;
+	    i_row->at("ID").get(id);
+	    is_paged_in_order = is_paged_in_order && id > last_id;
+	    last_id = id;
+	}
+	n_paged += page.rows.size();
+	++n_pages;
+    }while(!page.token.empty() && err_msg.empty());
+    std::cout << n_paged << " rows in " << n_pages << " pages" << std::endl;
+    check(err_msg.empty() && n_pages == 4u && n_paged == records.size() && is_paged_in_order,
+	    "all rows are read by pages in order: " + err_msg);
+
+    //###############################################################
+    //  Literals of generated queries
+    //
+    std::cout << "--- 28. Literals of generated queries ---" << std::endl;
+    sql_fetch.exec("DROP TABLE IF EXISTS lit; CREATE TABLE lit(ID INTEGER PRIMARY KEY, s TEXT, d DOUBLE);", err_msg);
+    Column_t lit_row{{"s", Data("it's \"quoted\"")}, {"d", Data(DOUBLE)}};
+    lit_row["d"].set(0.1);
+    sql_fetch.exec(sql_fetch.genQueryInsert("lit", lit_row, err_msg), err_msg);
+    ColumnList_t lits = sql_fetch.fetchColumn("SELECT * FROM lit", err_msg);
+    std::string lit_s;
+    double lit_d = 0.0;
+    check(lits.size() == 1u && lits.front().at("s").get(lit_s) && lit_s == "it's \"quoted\"",
+	    "a quote in TEXT is escaped");
+    check(lits.size() == 1u && lits.front().at("d").get(lit_d) && lit_d == 0.1, "a DOUBLE is written without loss");
+
+    //###############################################################
+    //  Read replica in memory
+    //
+    std::cout << "--- 29. Read replica in memory ---" << std::endl;
+    {
+	Fetcher replica;
+	int32_t replica_ret = replica.openReplica("test.db", err_msg, 0);
+	check(replica_ret == SQLITE_OK, "a replica is opened: " + err_msg);
+	ExecResult_t replica_res = replica.exec("SELECT count(*) AS n FROM lit;", err_msg);
+	check(!replica_res.result.empty() && replica_res.result.front().at("n") == "1", "a replica reads the file");
+	sql_fetch.exec("INSERT INTO lit(s) VALUES('new');", err_msg);
+	replica_res = replica.exec("SELECT count(*) AS n FROM lit;", err_msg);
+	check(!replica_res.result.empty() && replica_res.result.front().at("n") == "2", "a replica is reloaded after a commit");
+    }
+
+    //###############################################################
+    //  Online backup
+    //
+    std::cout << "--- 30. Online backup ---" << std::endl;
+    size_t n_steps = 0u;
+    int32_t backup_ret = sql_fetch.backupTo("test_backup.db", err_msg, 1, 0,
+	    [&n_steps](const int64_t&, const int64_t&){ ++n_steps; });
+    check(backup_ret == SQLITE_OK, "a backup starts: " + err_msg);
+    backup_ret = sql_fetch.waitBackup(err_msg);
+    check(backup_ret == SQLITE_OK && n_steps > 1u, "a backup is copied in steps: " + err_msg);
+    {
+	Fetcher backup_db("test_backup.db");
+	ExecResult_t backup_res = backup_db.exec("SELECT count(*) AS n FROM tx_log;", err_msg);
+	check(!backup_res.result.empty() && std::stoi(backup_res.result.front().at("n")) == countRows("tx_log"),
+		"the backup has the rows");
+    }
+    {
+	Fetcher unserialized;
+	unserialized.open("test.db", err_msg, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_NOMUTEX);
+	backup_ret = unserialized.backupTo("test_backup.db", err_msg);
+	check(backup_ret == SQLITE_MISUSE, "a connection without its mutex isn't backed up");
+    }
+
+    //###############################################################
+    //  Busy handling
+    //
+    std::cout << "--- 31. Busy handling ---" << std::endl;
+    {
+	Fetcher writer("test_busy.db");
+	writer.exec("CREATE TABLE IF NOT EXISTS job(ID INTEGER PRIMARY KEY);", err_msg);
+	Fetcher waiter("test_busy.db");
+	BusyPolicy_t policy;
+	policy.timeout_ms = 50;
+	policy.max_backoff_ms = 5.0;
+	waiter.setBusyPolicy(policy);
+	writer.exec("BEGIN IMMEDIATE; INSERT INTO job DEFAULT VALUES;", err_msg);
+	waiter.exec("INSERT INTO job DEFAULT VALUES;", err_msg);
+	BusyStats_t busy_stats = waiter.busyStats();
+	std::cout << busy_stats.waits << " waits for " << busy_stats.wait_us << " us" << std::endl;
+	check(!err_msg.empty() && busy_stats.waits > 0u && busy_stats.giveups == 1u, "a locked write gives up after retries");
+	writer.exec("COMMIT;", err_msg);
+	waiter.exec("INSERT INTO job DEFAULT VALUES;", err_msg);
+	check(err_msg.empty(), "a write succeeds after the lock is released: " + err_msg);
+    }
+
+    //###############################################################
+    //  Shared schema snapshots
+    //
+    std::cout << "--- 32. Shared schema snapshots ---" << std::endl;
+    {
+	Fetcher another("test.db");
+	sql_fetch.exec("DROP TABLE IF EXISTS shared; CREATE TABLE shared(ID INTEGER PRIMARY KEY, v TEXT);", err_msg);
+	Column_t shared_info = another.getTableInfo("shared", err_msg);
+	check(err_msg.empty() && shared_info.count("v") == 1u, "a table made by another Fetcher is seen: " + err_msg);
+	check(SchemaRegistry::instance().size() > 0u, "snapshots of files are in the registry");
+    }
+
+    //###############################################################
+    //  Memory limits
+    //
+    std::cout << "--- 33. Memory limits ---" << std::endl;
+    MemoryLimit_t memory_limit;
+    size_t n_warnings = 0u;
+    memory_limit.soft_bytes = 4096u;
+    memory_limit.hard_bytes = 65536u;
+    memory_limit.handler = [&n_warnings](const std::string&){ ++n_warnings; };
+    sql_fetch.setMemoryLimit(memory_limit);
+    ColumnList_t limited_rows = sql_fetch.fetchColumn("SELECT ID FROM ingest WHERE ID < 100", err_msg);
+    check(err_msg.empty() && limited_rows.size() == 100u && n_warnings == 1u, "a large result is warned: " + err_msg);
+    limited_rows = sql_fetch.fetchColumn("SELECT * FROM ingest", err_msg);
+    check(!err_msg.empty() && limited_rows.empty() && sql_fetch.memoryStats().hard_aborted == 1u,
+	    "a result beyond the hard limit fails");
+    sql_fetch.setMemoryLimit(MemoryLimit_t());
+
+    //###############################################################
+    //  Spill to disk
+    //
+    std::cout << "--- 34. Spill to disk ---" << std::endl;
+    SpilledResult spilled;
+    sql_fetch.fetchColumn("SELECT ID FROM ingest ORDER BY ID", spilled, err_msg, 4096u);
+    std::cout << spilled.size() << " rows in a file of " << spilled.fileBytes() << " bytes" << std::endl;
+    check(err_msg.empty() && spilled.isSpilled() && spilled.size() == records.size(), "rows move to a file: " + err_msg);
+    int64_t n_spilled = 0;
+    bool is_spilled_in_order = true;
+    for(auto i_row = spilled.begin(); i_row != spilled.end(); ++i_row){
+	int64_t id = -1;
+	(*i_row).at("ID").get(id);
+	is_spilled_in_order = is_spilled_in_order && id == n_spilled;
+	++n_spilled;
+    }
+    check(is_spilled_in_order && n_spilled == static_cast<int64_t>(records.size()), "spilled rows are read back in order");
+
+    //###############################################################
+    //  Dictionary encoded TEXT
+    //
+    std::cout << "--- 35. Dictionary encoded TEXT ---" << std::endl;
+    ColumnarResult notes;
+    sql_fetch.fetchColumnar("SELECT page FROM (SELECT 'top' AS page UNION ALL SELECT 'help' UNION ALL SELECT 'top')",
+	    notes, err_msg, true);
+    const ColumnVector& pages = notes.column("page");
+    int64_t top_code = pages.findCode("top");
+    size_t n_top = 0u;
+    for(size_t k=0u; pages.isDictionary() && k<pages.size(); ++k){
+	n_top += (pages.codes()[k] == top_code) ? 1u : 0u;
+    }
+    check(err_msg.empty() && pages.isDictionary() && pages.dictionarySize() == 2u && n_top == 2u,
+	    "TEXT values are encoded by a dictionary: " + err_msg);
+    check(pages.findCode("missing") == -1 && pages.dictionary(static_cast<size_t>(top_code)) == "top",
+	    "codes are looked up in the dictionary");
+
+    return (n_failed == 0) ? 0 : 1;
 }
 
 